@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string_view>
+#include <fmt/format.h>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "Game.hpp"
+#include "JobSystem.hpp"
+#include "NullGraphicsProvider.hpp"
+#include "ParticlePool.hpp"
+#include "SessionRecorder.hpp"
+#include "TargetStore.hpp"
+#include "TransformBatch.hpp"
+#include "utils.hpp"
+
+namespace {
+    // A player standing at the origin of the stage. The left gun stays on the start button, which also keeps it
+    // in the middle of the target field, and the right gun sweeps the field. Each fires twice a second, so that
+    // the game starts again soon after every score result.
+    Game::GameData syntheticFrame(uint32_t frame, double dt) {
+        const double t = frame * dt;
+        Game::GameData dat{};
+        dat.dt = dt;
+        dat.stagePose = Game::Pose{ glm::vec3(0.0f), glm::identity<glm::quat>() };
+        dat.viewPose = Game::Pose{ glm::vec3(0.0f, 1.6f, 0.0f), glm::identity<glm::quat>() };
+        dat.handPoses[0] = Game::Pose{ glm::vec3(-0.2f, 1.2f, -0.3f), glm::identity<glm::quat>() };
+        auto yaw = glm::angleAxis(float(0.8 * std::sin(0.7 * t)), glm::vec3(0, 1, 0));
+        auto pitch = glm::angleAxis(float(0.5 * std::sin(1.1 * t)), glm::vec3(1, 0, 0));
+        dat.handPoses[1] = Game::Pose{ glm::vec3(0.2f, 1.2f, -0.3f), yaw * pitch };
+
+        // presses, as main.cpp reports them: only on the frame the trigger goes down
+        const uint32_t firePeriod = std::max(uint32_t(0.5 / dt), 2u);
+        dat.trigger[0] = frame % firePeriod == 0;
+        dat.trigger[1] = frame % firePeriod == firePeriod / 2;
+        return dat;
+    }
+}
+
+// hello_xr_bench [times.csv]
+//   plays a synthetic session through Title, MainGame and ScoreResult, then replays it timed
+// hello_xr_bench --replay <session.rec> [times.csv]
+//   replays a recording from the headset (debug.hello_xr.record)
+// The settings are read from HELLO_XR_<NAME> instead of debug.hello_xr.<name>, e.g. HELLO_XR_TARGET_STRESS=1.
+// HELLO_XR_BENCH_FRAMES and HELLO_XR_BENCH_HZ set the length and frame rate of the synthetic session.
+// These first run a benchmark of one part, when set to 1:
+//   HELLO_XR_TRANSFORM_BENCH      the batched SIMD draw MVPs against glm
+//   HELLO_XR_DRAW_BENCH           inline draw recording against a virtual call per draw
+//   HELLO_XR_TARGET_BENCH         the SoA target animation and ray casts against the old per-target loops
+//   HELLO_XR_TARGET_QUERY_BENCH   the tree queries against a scan of every target, 10 to 100k targets
+//   HELLO_XR_PARTICLE_BENCH       the pooled hit effects against a vector compacted with remove_if
+//   HELLO_XR_JOB_BENCH            the job system scaling
+int main(int argc, char** argv) {
+    std::filesystem::path recordingPath, timesPath;
+    for (int i = 1; i < argc; i++) {
+        if (std::string_view(argv[i]) == "--replay" && i + 1 < argc)
+            recordingPath = std::filesystem::absolute(argv[++i]);
+        else
+            timesPath = std::filesystem::absolute(argv[i]);
+    }
+
+    try {
+        // the sounds are loaded relative to the assets; no audio device is needed, OpenAL Soft mixes into nothing
+        std::filesystem::current_path(HELLO_XR_ASSET_DIR);
+        setenv("ALSOFT_DRIVERS", "null", 0);
+
+        if (get_setting_int("transform_bench", 0) != 0)
+            benchmarkTransformBatch();
+        if (get_setting_int("draw_bench", 0) != 0)
+            benchmarkDrawSubmission();
+        if (get_setting_int("target_bench", 0) != 0)
+            benchmarkTargetStore();
+        if (get_setting_int("target_query_bench", 0) != 0)
+            benchmarkTargetQueries();
+        if (get_setting_int("particle_bench", 0) != 0)
+            benchmarkParticlePool();
+        if (get_setting_int("job_bench", 0) != 0)
+            benchmarkJobSystem();
+
+        NullGraphicsProvider provider;
+        Game::init(provider);
+
+        SessionRecording recording;
+        if (!recordingPath.empty()) {
+            recording = SessionRecording::load(recordingPath);
+        }
+        else {
+            // two minutes at 72 Hz, three rounds
+            const uint32_t frameCount = uint32_t(std::max(get_setting_int("bench_frames", 8640), 1));
+            const double dt = 1.0 / std::max(get_setting_int("bench_hz", 72), 1);
+
+            // a first run records the state hashes, which the timed replay has to match
+            recording.config = Game::getSessionConfig();
+            recording.frames.reserve(frameCount);
+            for (uint32_t i = 0; i < frameCount; i++) {
+                auto dat = syntheticFrame(i, dt);
+                Game::proc(dat);
+                provider.drawList.clear();
+                Game::draw(provider);
+                recording.frames.push_back({ dat, Game::stateHash() });
+            }
+        }
+
+        auto result = replaySession(recording, provider, timesPath);
+        return result.firstMismatch ? 1 : 0;
+    }
+    catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 2;
+    }
+}
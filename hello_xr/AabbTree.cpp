@@ -0,0 +1,212 @@
+#include "AabbTree.hpp"
+
+int32_t AabbTree::allocateNode() {
+    if (freeList == nullNode) {
+        nodes.emplace_back();
+        return int32_t(nodes.size()) - 1;
+    }
+    int32_t node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = Node{};
+    return node;
+}
+
+void AabbTree::freeNode(int32_t node) {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+int32_t AabbTree::createProxy(const Aabb& aabb, uint32_t userData) {
+    int32_t proxy = allocateNode();
+    nodes[proxy].aabb = { aabb.min - glm::vec3(margin), aabb.max + glm::vec3(margin) };
+    nodes[proxy].userData = userData;
+    insertLeaf(proxy);
+    proxyCount++;
+    return proxy;
+}
+
+void AabbTree::destroyProxy(int32_t proxy) {
+    assert(nodes[proxy].isLeaf());
+    removeLeaf(proxy);
+    freeNode(proxy);
+    proxyCount--;
+}
+
+bool AabbTree::moveProxy(int32_t proxy, const Aabb& aabb, const glm::vec3& displacement) {
+    assert(nodes[proxy].isLeaf());
+    if (nodes[proxy].aabb.contains(aabb))
+        return false;
+
+    removeLeaf(proxy);
+    Aabb fat{ aabb.min - glm::vec3(margin), aabb.max + glm::vec3(margin) };
+    fat.min += glm::min(displacement, glm::vec3(0.0f));
+    fat.max += glm::max(displacement, glm::vec3(0.0f));
+    nodes[proxy].aabb = fat;
+    insertLeaf(proxy);
+    return true;
+}
+
+void AabbTree::clear() {
+    nodes.clear();
+    root = nullNode;
+    freeList = nullNode;
+    proxyCount = 0;
+}
+
+void AabbTree::insertLeaf(int32_t leaf) {
+    if (root == nullNode) {
+        root = leaf;
+        nodes[root].parent = nullNode;
+        return;
+    }
+
+    // the sibling where the new parent costs the least area, counting what it adds to the ancestors
+    const Aabb leafAabb = nodes[leaf].aabb;
+    int32_t index = root;
+    while (!nodes[index].isLeaf()) {
+        const int32_t child1 = nodes[index].child1;
+        const int32_t child2 = nodes[index].child2;
+
+        const float area = nodes[index].aabb.area();
+        const float combinedArea = Aabb::merge(nodes[index].aabb, leafAabb).area();
+
+        // a new parent for this node and the leaf
+        const float cost = 2.0f * combinedArea;
+        // the least the leaf adds to this node, when it goes further down
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](int32_t child) {
+            const float mergedArea = Aabb::merge(leafAabb, nodes[child].aabb).area();
+            if (nodes[child].isLeaf())
+                return mergedArea + inheritanceCost;
+            return mergedArea - nodes[child].aabb.area() + inheritanceCost;
+        };
+        const float cost1 = descendCost(child1);
+        const float cost2 = descendCost(child2);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+        index = cost1 < cost2 ? child1 : child2;
+    }
+    const int32_t sibling = index;
+
+    const int32_t oldParent = nodes[sibling].parent;
+    const int32_t newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].aabb = Aabb::merge(leafAabb, nodes[sibling].aabb);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    if (oldParent != nullNode) {
+        if (nodes[oldParent].child1 == sibling)
+            nodes[oldParent].child1 = newParent;
+        else
+            nodes[oldParent].child2 = newParent;
+    }
+    else {
+        root = newParent;
+    }
+
+    // refit and rebalance the ancestors
+    index = nodes[leaf].parent;
+    while (index != nullNode) {
+        index = balance(index);
+        const Node& node = nodes[index];
+        nodes[index].height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+        nodes[index].aabb = Aabb::merge(nodes[node.child1].aabb, nodes[node.child2].aabb);
+        index = nodes[index].parent;
+    }
+}
+
+void AabbTree::removeLeaf(int32_t leaf) {
+    if (leaf == root) {
+        root = nullNode;
+        return;
+    }
+
+    // the sibling takes the place of the parent
+    const int32_t parent = nodes[leaf].parent;
+    const int32_t grandParent = nodes[parent].parent;
+    const int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent == nullNode) {
+        root = sibling;
+        nodes[sibling].parent = nullNode;
+        freeNode(parent);
+        return;
+    }
+
+    if (nodes[grandParent].child1 == parent)
+        nodes[grandParent].child1 = sibling;
+    else
+        nodes[grandParent].child2 = sibling;
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    int32_t index = grandParent;
+    while (index != nullNode) {
+        index = balance(index);
+        const Node& node = nodes[index];
+        nodes[index].height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+        nodes[index].aabb = Aabb::merge(nodes[node.child1].aabb, nodes[node.child2].aabb);
+        index = nodes[index].parent;
+    }
+}
+
+// Rotates the taller child of a up when the children of a differ in height by more than one.
+// Returns the node now at the place of a.
+int32_t AabbTree::balance(int32_t iA) {
+    Node& A = nodes[iA];
+    if (A.isLeaf() || A.height < 2)
+        return iA;
+
+    const int32_t iB = A.child1;
+    const int32_t iC = A.child2;
+    const int32_t heightDiff = nodes[iC].height - nodes[iB].height;
+    if (heightDiff >= -1 && heightDiff <= 1)
+        return iA;
+
+    // rotates iUp above iA, which keeps the other child of iUp
+    auto rotate = [&](int32_t iUp, int32_t iStay) {
+        Node& up = nodes[iUp];
+        const int32_t iF = up.child1;
+        const int32_t iG = up.child2;
+
+        up.child1 = iA;
+        up.parent = A.parent;
+        A.parent = iUp;
+        if (up.parent != nullNode) {
+            if (nodes[up.parent].child1 == iA)
+                nodes[up.parent].child1 = iUp;
+            else
+                nodes[up.parent].child2 = iUp;
+        }
+        else {
+            root = iUp;
+        }
+
+        // the taller grandchild stays with iUp, the other replaces iUp under iA
+        const bool keepF = nodes[iF].height > nodes[iG].height;
+        const int32_t iKeep = keepF ? iF : iG;
+        const int32_t iMove = keepF ? iG : iF;
+        up.child2 = iKeep;
+        if (A.child1 == iUp)
+            A.child1 = iMove;
+        else
+            A.child2 = iMove;
+        nodes[iMove].parent = iA;
+
+        A.aabb = Aabb::merge(nodes[iStay].aabb, nodes[iMove].aabb);
+        up.aabb = Aabb::merge(A.aabb, nodes[iKeep].aabb);
+        A.height = 1 + std::max(nodes[iStay].height, nodes[iMove].height);
+        up.height = 1 + std::max(A.height, nodes[iKeep].height);
+        return iUp;
+    };
+
+    if (heightDiff > 1)
+        return rotate(iC, iB);
+    return rotate(iB, iC);
+}
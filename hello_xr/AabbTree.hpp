@@ -0,0 +1,160 @@
+#ifndef AABB_TREE_HPP
+#define AABB_TREE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct Aabb {
+    glm::vec3 min, max;
+
+    bool contains(const Aabb& other) const {
+        return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::lessThanEqual(other.max, max));
+    }
+    bool overlaps(const Aabb& other) const {
+        return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::lessThanEqual(other.min, max));
+    }
+    // half of the surface area, the insertion cost
+    float area() const {
+        glm::vec3 d = max - min;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+    static Aabb merge(const Aabb& a, const Aabb& b) {
+        return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+    }
+};
+
+// Dynamic bounding volume tree over moving proxies, after Box2D's b2DynamicTree.
+// Leaves hold fat boxes: the box passed in, grown by a margin and by the motion the caller predicts,
+// so a proxy is only reinserted once it leaves them. Inner nodes are kept balanced by rotations.
+// The queries report every proxy whose fat box passes the test; the caller does the exact test.
+class AabbTree {
+public:
+    static constexpr int32_t nullNode = -1;
+    static constexpr float margin = 0.1f;
+
+    int32_t createProxy(const Aabb& aabb, uint32_t userData);
+    void destroyProxy(int32_t proxy);
+    // false while aabb is still inside the fat box; otherwise the proxy is reinserted with a new one,
+    // stretched by displacement, the motion expected before the next reinsert
+    bool moveProxy(int32_t proxy, const Aabb& aabb, const glm::vec3& displacement);
+    void clear();
+
+    const Aabb& getFatAabb(int32_t proxy) const { return nodes[proxy].aabb; }
+    uint32_t getUserData(int32_t proxy) const { return nodes[proxy].userData; }
+    void setUserData(int32_t proxy, uint32_t userData) { nodes[proxy].userData = userData; }
+    uint32_t getProxyCount() const { return proxyCount; }
+    int32_t getHeight() const { return root == nullNode ? 0 : nodes[root].height; }
+
+    template<typename F>
+    void queryAabb(const Aabb& aabb, F&& func) const {
+        query([&](const Aabb& box) { return box.overlaps(aabb); }, func);
+    }
+
+    template<typename F>
+    void querySphere(const glm::vec3& center, float radius, F&& func) const {
+        query([&](const Aabb& box) {
+            glm::vec3 d = center - glm::clamp(center, box.min, box.max);
+            return glm::dot(d, d) <= radius * radius;
+        }, func);
+    }
+
+    // the ray from origin along dir (not necessarily normalized) up to origin + dir * maxLen
+    template<typename F>
+    void queryRay(const glm::vec3& origin, const glm::vec3& dir, float maxLen, F&& func) const {
+        query([&](const Aabb& box) {
+            float tMin = 0.0f, tMax = maxLen;
+            for (int a = 0; a < 3; a++) {
+                if (std::abs(dir[a]) < 1e-12f) {
+                    if (origin[a] < box.min[a] || origin[a] > box.max[a])
+                        return false;
+                    continue;
+                }
+                float inv = 1.0f / dir[a];
+                float t1 = (box.min[a] - origin[a]) * inv;
+                float t2 = (box.max[a] - origin[a]) * inv;
+                tMin = std::max(tMin, std::min(t1, t2));
+                tMax = std::min(tMax, std::max(t1, t2));
+                if (tMin > tMax)
+                    return false;
+            }
+            return true;
+        }, func);
+    }
+
+    // the cone from apex around the normalized axis, up to range from the apex.
+    // Conservative: the bounding sphere of each box is tested.
+    template<typename F>
+    void queryCone(const glm::vec3& apex, const glm::vec3& axis, float halfAngle, float range, F&& func) const {
+        const float sinAngle = std::sin(halfAngle), cosAngle = std::cos(halfAngle);
+        query([&](const Aabb& box) {
+            return sphereInCone((box.min + box.max) * 0.5f, glm::length(box.max - box.min) * 0.5f, apex, axis, sinAngle, cosAngle, range);
+        }, func);
+    }
+
+    static bool sphereInCone(const glm::vec3& center, float radius, const glm::vec3& apex, const glm::vec3& axis, float sinAngle, float cosAngle, float range) {
+        glm::vec3 v = center - apex;
+        float dist2 = glm::dot(v, v);
+        if (dist2 > (range + radius) * (range + radius))
+            return false;
+        float along = glm::dot(v, axis);
+        float across = std::sqrt(std::max(dist2 - along * along, 0.0f));
+        // behind the apex, where the apex is the nearest point of the cone
+        if (along * cosAngle + across * sinAngle < 0.0f)
+            return dist2 <= radius * radius;
+        // signed distance to the side of the cone
+        return across * cosAngle - along * sinAngle <= radius;
+    }
+
+private:
+    struct Node {
+        Aabb aabb;
+        uint32_t userData = 0;
+        int32_t parent = nullNode;  // next free node while free
+        int32_t child1 = nullNode, child2 = nullNode;
+        int32_t height = 0;     // 0 for a leaf, -1 while free
+
+        bool isLeaf() const { return child1 == nullNode; }
+    };
+
+    template<typename Test, typename F>
+    void query(Test&& test, F&& func) const {
+        if (root == nullNode)
+            return;
+        // the tree stays balanced, so its height is ~1.44 log2(proxies)
+        std::array<int32_t, 256> stack;
+        int count = 0;
+        stack[count++] = root;
+        while (count > 0) {
+            const Node& node = nodes[stack[--count]];
+            if (!test(node.aabb))
+                continue;
+            if (node.isLeaf()) {
+                func(node.userData);
+            }
+            else {
+                assert(count + 2 <= int(stack.size()));
+                stack[count++] = node.child1;
+                stack[count++] = node.child2;
+            }
+        }
+    }
+
+    int32_t allocateNode();
+    void freeNode(int32_t node);
+    void insertLeaf(int32_t leaf);
+    void removeLeaf(int32_t leaf);
+    int32_t balance(int32_t node);
+
+    std::vector<Node> nodes;
+    int32_t root = nullNode;
+    int32_t freeList = nullNode;
+    uint32_t proxyCount = 0;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef ENTITY_STORE_HPP
+#define ENTITY_STORE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// A component of N floats, kept as N arrays of one float each rather than one array of structs, so that a
+// system can load four entities at a time. Tag tells apart components of the same size.
+// The arrays are padded to whole lane groups of four.
+template<typename Tag, int N>
+struct FloatColumns {
+    using Value = std::array<float, N>;
+};
+
+// The entities of one archetype: a fixed set of component types, each kept in its own array (or arrays, for
+// FloatColumns) with the live entities packed at the front in the order they were created, so that a
+// system walks plain arrays.
+// Entities are named by generational handles. Destroying one moves the entities after it down, keeping
+// their order, and bumps the generation of its slot, so a stale handle is caught instead of naming whatever
+// came next. All storage is allocated by the constructor; create() fails once the store is full.
+// The hands, the targets (in TargetStore) and the effects (in ParticlePool) of Game.cpp each live in one.
+template<typename... Components>
+class EntityStore {
+    template<typename C>
+    struct Storage {
+        using Value = C;
+        using Type = std::vector<C>;
+        static constexpr bool columns = false;
+    };
+    template<typename Tag, int N>
+    struct Storage<FloatColumns<Tag, N>> {
+        using Value = typename FloatColumns<Tag, N>::Value;
+        using Type = std::array<std::vector<float>, N>;
+        static constexpr bool columns = true;
+    };
+    // the position of C in Components, as two components may be stored in the same type
+    template<typename C>
+    static constexpr size_t componentIndex() {
+        size_t i = 0;
+        (void)((std::is_same_v<C, Components> ? false : (i++, true)) && ...);
+        return i;
+    }
+
+public:
+    struct Entity {
+        uint32_t slot = ~0u;
+        uint32_t generation = 0;
+
+        bool operator==(const Entity& other) const { return slot == other.slot && generation == other.generation; }
+        bool operator!=(const Entity& other) const { return !(*this == other); }
+    };
+
+    explicit EntityStore(uint32_t capacity)
+        : denseSlots(capacity), slotDense(capacity), generations(capacity, 0) {
+        const uint32_t padded = (capacity + 3) / 4 * 4;
+        std::apply([&](auto&... storages) { (resize(storages, capacity, padded), ...); }, components);
+        freeSlots.reserve(capacity);
+        clear();
+    }
+
+    std::optional<Entity> create(typename Storage<Components>::Value... values) {
+        if (freeSlots.empty())
+            return std::nullopt;
+        const uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        slotDense[slot] = count;
+        denseSlots[count] = slot;
+        std::apply([&](auto&... storages) { (assign(storages, count, std::move(values)), ...); }, components);
+        count++;
+        return Entity{ slot, generations[slot] };
+    }
+
+    void destroy(Entity entity) {
+        assert(alive(entity));
+        const uint32_t dense = slotDense[entity.slot];
+        removeDense(&dense, 1);
+    }
+
+    // destroys the entities at the packed indices, which are ascending
+    void removeDense(const uint32_t* dense, uint32_t removeCount) {
+        if (removeCount == 0)
+            return;
+        for (uint32_t r = 0; r < removeCount; r++) {
+            const uint32_t slot = denseSlots[dense[r]];
+            generations[slot]++;
+            freeSlots.push_back(slot);
+        }
+        // the runs between removed entities move down, one array at a time
+        auto moveDown = [&](auto& array) {
+            uint32_t to = dense[0];
+            for (uint32_t r = 0; r < removeCount; r++) {
+                const uint32_t runBegin = dense[r] + 1, runEnd = r + 1 < removeCount ? dense[r + 1] : count;
+                std::move(array.begin() + runBegin, array.begin() + runEnd, array.begin() + to);
+                to += runEnd - runBegin;
+            }
+        };
+        std::apply([&](auto&... storages) { (forEachArray(storages, moveDown), ...); }, components);
+        moveDown(denseSlots);
+        count -= removeCount;
+        for (uint32_t i = dense[0]; i < count; i++)
+            slotDense[denseSlots[i]] = i;
+    }
+
+    void clear() {
+        count = 0;
+        freeSlots.clear();
+        for (uint32_t slot = uint32_t(generations.size()); slot-- > 0;) {
+            generations[slot]++;
+            freeSlots.push_back(slot);
+        }
+    }
+
+    bool alive(Entity entity) const {
+        // freeing a slot bumps its generation
+        return entity.slot < generations.size() && generations[entity.slot] == entity.generation;
+    }
+    // where the entity is packed, which changes as entities before it are destroyed
+    uint32_t indexOf(Entity entity) const {
+        assert(alive(entity));
+        return slotDense[entity.slot];
+    }
+    Entity entityAt(uint32_t dense) const { return Entity{ denseSlots[dense], generations[denseSlots[dense]] }; }
+
+    template<typename C>
+    C& get(Entity entity) { return array<C>()[indexOf(entity)]; }
+    template<typename C>
+    const C& get(Entity entity) const { return array<C>()[indexOf(entity)]; }
+
+    // the packed array of a component stored whole / one array of a FloatColumns component, padded to whole lane groups
+    template<typename C>
+    C* array() {
+        static_assert(!Storage<C>::columns, "FloatColumns are reached through column()");
+        return std::get<componentIndex<C>()>(components).data();
+    }
+    template<typename C>
+    const C* array() const {
+        static_assert(!Storage<C>::columns, "FloatColumns are reached through column()");
+        return std::get<componentIndex<C>()>(components).data();
+    }
+    template<typename C>
+    float* column(int c) {
+        static_assert(Storage<C>::columns, "only FloatColumns are stored as columns");
+        return std::get<componentIndex<C>()>(components)[c].data();
+    }
+    template<typename C>
+    const float* column(int c) const {
+        static_assert(Storage<C>::columns, "only FloatColumns are stored as columns");
+        return std::get<componentIndex<C>()>(components)[c].data();
+    }
+
+    // func(Entity, Components&...) for every entity, in storage order. Only for stores without FloatColumns.
+    template<typename F>
+    void forEach(F&& func) {
+        static_assert((!Storage<Components>::columns && ...), "forEach() passes whole components");
+        for (uint32_t i = 0; i < count; i++)
+            std::apply([&](auto&... arrays) { func(entityAt(i), arrays[i]...); }, components);
+    }
+    template<typename F>
+    void forEach(F&& func) const {
+        static_assert((!Storage<Components>::columns && ...), "forEach() passes whole components");
+        for (uint32_t i = 0; i < count; i++)
+            std::apply([&](const auto&... arrays) { func(entityAt(i), arrays[i]...); }, components);
+    }
+
+    uint32_t size() const { return count; }
+    uint32_t capacity() const { return uint32_t(generations.size()); }
+
+private:
+    template<typename T>
+    static void resize(std::vector<T>& array, uint32_t capacity, uint32_t) { array.resize(capacity); }
+    template<size_t N>
+    static void resize(std::array<std::vector<float>, N>& arrays, uint32_t, uint32_t padded) {
+        for (auto& array : arrays)
+            array.resize(padded);
+    }
+    template<typename T>
+    static void assign(std::vector<T>& array, uint32_t i, T value) { array[i] = std::move(value); }
+    template<size_t N>
+    static void assign(std::array<std::vector<float>, N>& arrays, uint32_t i, const std::array<float, N>& value) {
+        for (size_t c = 0; c < N; c++)
+            arrays[c][i] = value[c];
+    }
+    template<typename T, typename F>
+    static void forEachArray(std::vector<T>& array, F& func) { func(array); }
+    template<size_t N, typename F>
+    static void forEachArray(std::array<std::vector<float>, N>& arrays, F& func) {
+        for (auto& array : arrays)
+            func(array);
+    }
+
+    std::tuple<typename Storage<Components>::Type...> components;
+    std::vector<uint32_t> denseSlots;   // slot of each packed entity
+    std::vector<uint32_t> slotDense;    // where the entity of each slot is packed, while it lives
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> freeSlots;
+    uint32_t count = 0;
+};
+
+#endif
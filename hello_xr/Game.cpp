@@ -1,6 +1,7 @@
 #include <iostream>
 #include <queue>
 #include <cmath>
+#include <random>
 #include <fmt/format.h>
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -9,7 +10,12 @@
 
 #include "AudioManager.h"
 
+#include "EntityStore.hpp"
 #include "Game.hpp"
+#include "JobSystem.hpp"
+#include "ParticlePool.hpp"
+#include "Random.hpp"
+#include "TargetStore.hpp"
 #include "utils.hpp"
 
 namespace Game {
@@ -18,40 +24,85 @@ namespace Game {
 
     std::optional<OpenALManager> alManager;
 
-    ModelHandle testModel, gunModel, beamModel, tgtModel, gamestartModel, gamestartSelectedModel, sphereModel, scoreModel[4], numberModel[10], timeModel, scoreStrModel;
+    ModelHandle testModel, gunModel, beamModel, tgtModel, gamestartModel, gamestartSelectedModel, sphereModel;
+    PanelHandle titlePanel, timerPanel, scorePanel;
+
+    // text colors of the HUD and score labels
+    const glm::vec3 digitColor{ 0.985f, 0.826f, 0.551f };
+    const glm::vec3 timeLabelColor{ 0.8f, 0.295f, 0.0f };
+    const glm::vec3 scoreLabelColor{ 0.8f, 0.796f, 0.404f };
+    const char* const scoreEffectText[4] = { "+100", "+50", "+30", "+10" };
+    const glm::vec3 scoreEffectColor[4] = { { 0.8f, 0.0f, 0.018f }, { 1.0f, 0.28f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
     std::optional<AudioSource> gunAudioSrc[2];
     std::optional<SoundEffect> gunSe, tgtSe, cntSe, buzzerSe;
     std::optional<OneShotAudioManager> seManager;
 
     bool initialized = false;
 
-    constexpr int handPoseBufSize = 3;
-    int handPoseBufIndex[2] = {};
-    std::optional<Game::Pose> handPoseBuf[2][handPoseBufSize];
-    std::optional<Game::Pose> handPose[2];
-
-    Pose stagePose;
-    glm::vec3 fwdVec, upperVec, rightVec;
-    Pose sightBase;
-
-    Pose gameStartStrPose;
+    // hit effects are simulated on the GPU when the graphics provider supports it
+    IGraphicsProvider* graphics = nullptr;
+    bool gpuParticles = false;
 
-    double stageRotate = 0.0;
-    double gameTimer = 0.0;
-    double tgtTimer = 0.0;
-    int score;
+    // the hands, one entity each, in the order of the GameData arrays
+    constexpr int handPoseBufSize = 3;
+    struct HandId {
+        int index;      // into the GameData arrays and gunAudioSrc
+    };
+    struct HandTracking {
+        std::optional<Pose> poseBuf[handPoseBufSize];
+        int poseBufIndex = 0;
+        std::optional<Pose> pose;   // smoothed over poseBuf, once it is full
+    };
+    struct HandAim {
+        std::optional<double> rayD;     // how far the beam reaches, when it hits something
+        bool onGameStart = false;
+    };
+    struct HandTrigger {
+        bool old = false;       // in the step before
+        bool pending = false;   // a press waits for the next step, which a short frame may not run
+    };
+    using HandStore = EntityStore<HandId, HandTracking, HandAim, HandTrigger>;
+    HandStore hands(2);
 
-    bool gsSelected = false;
-    bool gsSelectedHands[2] = {false, false};
-    std::optional<double> rayD[2];
+    // where the game is played, set from the stage pose once it is known
+    struct Stage {
+        Pose pose;
+        glm::vec3 fwdVec, upperVec, rightVec;
+        Pose sightBase;
+        Pose gameStartStrPose;
+        double rotate = 0.0, prevRotate = 0.0;
+    };
+    Stage stage;
 
     enum class Scene {
         Title, MainGame, ScoreResult,
     };
-    Scene scene = Scene::Title;
+    // the scene and the timers and score of the round being played
+    struct Round {
+        Scene scene = Scene::Title;
+        double gameTimer = 0.0;
+        double tgtTimer = 0.0;
+        int score = 0;
+        bool gsSelected = false;
+    };
+    Round round;
 
     GameData gameDat;
-    bool trigger_old[2];
+
+    // the game runs in fixed steps of tickTime, and draw() interpolates between the last two by tickAlpha.
+    // A longer frame than maxFrameTime slows the game down rather than running a burst of steps.
+    constexpr double maxFrameTime = 0.1;
+    double tickTime = 1.0 / 120;
+    double tickAccumulator = 0.0;
+    float tickAlpha = 1.0f;
+
+    SessionConfig sessionConfig{};
+    // one stream of the session seed each, so that the CPU hit effects, which only run without GPU particles,
+    // do not change where the targets spawn
+    enum RandomStream : uint64_t {
+        spawnStream, effectStream,
+    };
+    Random spawnRandom, effectRandom;
 
     template<typename V, typename T>
     auto vLerp(V v1, V v2, T t) {
@@ -85,139 +136,40 @@ namespace Game {
         }
     };
 
-    struct Target {
-        Pose pose;
-        Pose tgtPose;
-        Pose endPose;
-        Pose hidPose;
-        double timer = 0.0;
-        bool alive = true;
-
-        float angleA, angleB, dist;
-
-        Target() {
-            angleA = rand() % 1000 * 0.002 - 1;
-            angleB = rand() % 1000 * 0.002 - 1;
-            dist = rand() % 1000 * 0.007 + 1;
-
-            tgtPose.pos = sightBase.pos + dist * (upperVec * std::sin(angleA) + rightVec * std::cos(angleA) * std::sin(angleB) + fwdVec * std::cos(angleA) * std::cos(angleB));
-            tgtPose.ori = glm::rotate(glm::identity<glm::quat>(), float(angleA), rightVec)
-                          * glm::rotate(glm::identity<glm::quat>(), float(-angleB), upperVec) * stagePose.ori
-                          * glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{0, 1, 0})
-                    ;
-            tgtPose.ori = glm::normalize(tgtPose.ori);
-
-            endPose = tgtPose;
-            endPose.ori = glm::rotate(glm::identity<glm::quat>(), float(angleA), rightVec)
-                          * glm::rotate(glm::identity<glm::quat>(), float(-angleB), upperVec) * stagePose.ori;
-            endPose.ori = glm::normalize(endPose.ori);
-
-            hidPose = tgtPose;
-            hidPose.pos -= 10.0f * upperVec;
-
-            pose = hidPose;
-        }
-
-        void proc(double dt) {
-            if (timer < 2.0f) {
-                double t = timer / 2.0;
-                pose.pos = vLerp(hidPose.pos, tgtPose.pos, float(1.0 - (1.0 - t) * (1.0 - t)));
-            }
-            else if (timer < 4.0f) {
-                pose = tgtPose;
-            }
-            else if (timer < 5.0f) {
-                double t = timer - 4.0f;
-                pose = tgtPose;
-                pose.ori = glm::slerp(tgtPose.ori, endPose.ori, float(t));
-                pose.ori = glm::normalize(pose.ori);
-            }
-            else if (timer < 7.0f) {
-                double t = (timer - 5.0f) / 2.0;
-                pose.pos = vLerp(tgtPose.pos, hidPose.pos, float(t * t));
-            }
-            else {
-                alive = false;
-            }
-
-            timer += dt;
-        }
-
-        struct Hit {
-            bool enable;
-            glm::vec3 colPos;
-            float rayLen;
-            float dCenter;
-        };
-
-        std::optional<Hit> RayCast(glm::vec3 rayfrom, glm::vec3 rayDir) {
-            float rayLen;
-            auto norm = pose.ori * glm::vec3{ 0,0,1 };
-            if (glm::intersectRayPlane(rayfrom, rayDir, pose.pos, norm, rayLen)) {
-                auto p = rayfrom + rayLen * rayDir;
-
-                auto pPlane = p - pose.pos;
-
-                auto dCenter = glm::length(pPlane);
+    // the score labels rise from where a target was hit, tagged with their index in scoreEffectText.
+    // The hit effects fly apart on the CPU when the graphics provider has no particles.
+    constexpr uint32_t scoreEffectCapacity = 64;
+    constexpr uint32_t boomEffectCapacity = 512;
+    std::optional<ParticlePool> scoreEffects, boomEffects;
+
+    void drawEffects(IGraphicsProvider& g) {
+        scoreEffects->forEach(tickAlpha, [&](const glm::vec3& pos, float, uint32_t type) {
+            g.DrawString(scoreEffectText[type], pos, stage.pose.ori, 0.14f, scoreEffectColor[type]);
+        });
+        boomEffects->forEach(tickAlpha, [&](const glm::vec3& pos, float left, uint32_t) {
+            g.DrawModel(sphereModel, pos, glm::quat(0,0,0,1), left * glm::vec3{0.2, 0.2, 0.2});
+        });
+    }
 
-                if (dCenter <= 0.2) {
-                    return Hit{ glm::dot(rayDir, norm) >= 0, p, rayLen, dCenter };
-                }
-                else {
-                    return std::nullopt;
-                }
-            }
-            else
-                return std::nullopt;
-        }
-    };
+    // stress mode keeps the store full, to measure the target update and draw cost with many targets
+    constexpr uint32_t targetCapacity = 64;
+    constexpr uint32_t stressTargetCount = 10000;
+    std::optional<TargetStore> targets;
 
-    struct scoreEffect {
-        int type;
-        Pose pose;
-        bool alive = true;
-        double timer = 0;
+    // timer > 0 starts the rise / hold / turn / sink animation part way through
+    void SpawnTarget(float timer = 0.0f) {
+        float angleA = spawnRandom.uniform(-1.0f, 1.0f);
+        float angleB = spawnRandom.uniform(-1.0f, 1.0f);
+        float dist = spawnRandom.uniform(1.0f, 8.0f);
 
-        scoreEffect(glm::vec3 pos, int ty) {
-            type = ty;
-            pose.pos = pos;
-            pose.ori = stagePose.ori * glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0, 1, 0 });
-        }
-        void proc(double dt) {
-            timer += dt;
-            pose.pos += float(dt * 0.3) * upperVec;
-            if (timer > 2.0) {
-                alive = false;
-            }
-        }
-        void draw(IGraphicsProvider& g) const {
-            g.DrawModel(scoreModel[type], pose.pos, pose.ori, glm::vec3{ 0.2, 0.2, 0.2 });
-        }
-    };
-
-    struct boomEffect {
-        glm::vec3 pos, vel;
-        double timer = 0;
-        bool alive = true;
-        boomEffect(glm::vec3 pos) : pos(pos) {
-            float angle = float(rand() % 10000) / 5000 * pi;
-            vel = 3.0f * (upperVec * sin(angle) + rightVec * cos(angle));
-        }
-        void proc(double dt) {
-            timer += dt;
-            pos += float(dt) * vel;
-            if (timer > 0.2) {
-                alive = false;
-            }
-        }
-        void draw(IGraphicsProvider& g) const {
-            g.DrawModel(sphereModel, pos, glm::quat(0,0,0,1), float(0.2 - timer) * glm::vec3{0.2, 0.2, 0.2});
-        }
-    };
+        auto tgtPos = stage.sightBase.pos + dist * (stage.upperVec * std::sin(angleA) + stage.rightVec * std::cos(angleA) * std::sin(angleB) + stage.fwdVec * std::cos(angleA) * std::cos(angleB));
+        auto endOri = glm::rotate(glm::identity<glm::quat>(), float(angleA), stage.rightVec)
+                      * glm::rotate(glm::identity<glm::quat>(), float(-angleB), stage.upperVec) * stage.pose.ori;
+        endOri = glm::normalize(endOri);
+        auto tgtOri = glm::normalize(endOri * glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0, 1, 0 }));
 
-    std::vector<Target> targets;
-    std::vector<scoreEffect> scoreEffects;
-    std::vector<boomEffect> boomEffects;
+        targets->spawn(tgtPos - 10.0f * stage.upperVec, tgtPos, tgtOri, endOri, timer);
+    }
 
     void init(IGraphicsProvider& g) {
         testModel = g.LoadModel("testcube.glb");
@@ -226,17 +178,17 @@ namespace Game {
         tgtModel = g.LoadModel("target.glb");
         gamestartModel = g.LoadModel("GameStart.glb");
         gamestartSelectedModel = g.LoadModel("GameStart_selected.glb");
-        timeModel = g.LoadModel("time.glb");
-        scoreStrModel = g.LoadModel("score.glb");
         sphereModel = g.LoadModel("sphere.glb");
-        scoreModel[0] = g.LoadModel("score100.glb");
-        scoreModel[1] = g.LoadModel("score50.glb");
-        scoreModel[2] = g.LoadModel("score30.glb");
-        scoreModel[3] = g.LoadModel("score10.glb");
-        for (int i = 0; i < 10; i++) {
-            auto tmp = fmt::format("{}.glb", i);
-            numberModel[i] = g.LoadModel(tmp.c_str());
-        }
+
+        titlePanel = g.CreatePanel(1280, 256, glm::vec2(2.5, 0.5));
+        timerPanel = g.CreatePanel(512, 512, glm::vec2(12.0, 12.0));
+        scorePanel = g.CreatePanel(1024, 512, glm::vec2(24.0, 12.0));
+
+        g.SetOccluder(testModel, true);
+        g.SetOccluder(tgtModel, true);
+
+        graphics = &g;
+        gpuParticles = g.InitParticles("sphere.glb", 16384);
 
         alManager.emplace();
         gunSe.emplace("gun.wav");
@@ -248,253 +200,306 @@ namespace Game {
             gunAudioSrc[i].emplace(glm::vec3{});
 
         seManager.emplace(128);
+
+        scoreEffects.emplace(scoreEffectCapacity);
+        boomEffects.emplace(boomEffectCapacity);
+
+        SessionConfig config;
+        int seed = get_setting_int("seed", 0);
+        config.seed = seed != 0 ? uint64_t(seed) : std::random_device{}();
+        config.simHz = std::max(get_setting_int("sim_hz", 120), 1);
+        config.targetStress = get_setting_int("target_stress", 0) != 0;
+        config.targetTree = get_setting_int("target_tree", 0) != 0;
+        std::cout << fmt::format("Game seed: {}", config.seed) << std::endl;
+        reset(config);
+    }
+
+    void reset(const SessionConfig& config) {
+        sessionConfig = config;
+        tickTime = 1.0 / config.simHz;
+        spawnRandom = Random(config.seed, spawnStream);
+        effectRandom = Random(config.seed, effectStream);
+        targets.emplace(config.targetStress ? stressTargetCount : targetCapacity, config.targetTree);
+        scoreEffects->clear();
+        boomEffects->clear();
+
+        initialized = false;
+        hands.clear();
+        for (int i = 0; i < 2; i++)
+            hands.create(HandId{ i }, HandTracking{}, HandAim{}, HandTrigger{});
+        stage.rotate = stage.prevRotate = 0.0;
+        round.gameTimer = 0.0;
+        round.score = 0;
+        round.gsSelected = false;
+        round.scene = Scene::Title;
+        gameDat = {};
+        tickAccumulator = 0.0;
+        tickAlpha = 1.0f;
+    }
+
+    const SessionConfig& getSessionConfig() {
+        return sessionConfig;
+    }
+
+    uint64_t stateHash() {
+        // FNV-1a over the bytes of the state that the next steps depend on or that is drawn
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        auto add = [&](const auto& value) {
+            auto bytes = reinterpret_cast<const unsigned char*>(&value);
+            for (size_t i = 0; i < sizeof(value); i++)
+                hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+        };
+        add(round.scene);
+        add(round.score);
+        add(round.gameTimer);
+        add(round.tgtTimer);
+        add(stage.rotate);
+        add(tickAccumulator);
+        hands.forEach([&](HandStore::Entity, const HandId&, const HandTracking& tracking, const HandAim& aim, const HandTrigger&) {
+            if (tracking.pose.has_value()) {
+                add(tracking.pose->pos);
+                add(tracking.pose->ori);
+            }
+            add(aim.rayD.value_or(-1.0));
+        });
+        targets->forEach([&](TargetStore::Target target) {
+            add(target);
+            add(targets->getPosition(target));
+            add(targets->getRotation(target));
+        });
+        scoreEffects->forEach(1.0f, [&](const glm::vec3& pos, float, uint32_t) { add(pos); });
+        // not the CPU hit effects, which a replay without GPU particles has and the recording may not
+        return hash;
     }
 
     void proc_init(const GameData& dat) {
         if (dat.stagePose.has_value()) {
-            stagePose = dat.stagePose.value();
-            fwdVec = dat.stagePose->ori * glm::vec3(0, 0, -1);
-            upperVec = dat.stagePose->ori * glm::vec3(0, 1, 0);
-            rightVec = dat.stagePose->ori * glm::vec3(1, 0, 0);
+            stage.pose = dat.stagePose.value();
+            stage.fwdVec = dat.stagePose->ori * glm::vec3(0, 0, -1);
+            stage.upperVec = dat.stagePose->ori * glm::vec3(0, 1, 0);
+            stage.rightVec = dat.stagePose->ori * glm::vec3(1, 0, 0);
 
-            sightBase = stagePose;
+            stage.sightBase = stage.pose;
             constexpr float sightHeight = 1.2;
-            sightBase.pos += sightHeight * upperVec;
+            stage.sightBase.pos += sightHeight * stage.upperVec;
 
-            gameStartStrPose = sightBase;
-            gameStartStrPose.ori = glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0, 1, 0 }) * gameStartStrPose.ori;
-            gameStartStrPose.pos += fwdVec * 3.0f;
+            stage.gameStartStrPose = stage.sightBase;
+            stage.gameStartStrPose.ori = glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0, 1, 0 }) * stage.gameStartStrPose.ori;
+            stage.gameStartStrPose.pos += stage.fwdVec * 3.0f;
 
-            tgtTimer = 1.0;
+            round.tgtTimer = 1.0;
 
             initialized = true;
         }
     }
 
-    void proc_main(const GameData& dat) {
-        stageRotate += dat.dt * 0.1;
-        if (stageRotate > 1.0f)
-            stageRotate -= 1.0f;
-        for (int i = 0; i < 2; i++)
-            rayD[i].reset();
-
-        for (int i = 0; i < 2; i++) {
-            if (dat.handPoses[i].has_value()) {
-                handPoseBuf[i][handPoseBufIndex[i]++] = dat.handPoses[i].value();
-                handPoseBufIndex[i] %= handPoseBufSize;
+    // once per displayed frame, with the poses predicted for it
+    void proc_frame(const GameData& dat) {
+        hands.forEach([&](HandStore::Entity, const HandId& id, HandTracking& tracking, HandAim&, HandTrigger&) {
+            if (dat.handPoses[id.index].has_value()) {
+                tracking.poseBuf[tracking.poseBufIndex++] = dat.handPoses[id.index].value();
+                tracking.poseBufIndex %= handPoseBufSize;
             }
 
             bool ok = true;
             for (int j = 0; j < handPoseBufSize; j++) {
-                if (!handPoseBuf[i][j].has_value())
+                if (!tracking.poseBuf[j].has_value())
                     ok = false;
             }
             if (ok) {
-                handPose[i].emplace();
+                tracking.pose.emplace();
                 for (int j = 0; j < handPoseBufSize; j++) {
-                    handPose[i]->pos += handPoseBuf[i][j]->pos;
+                    tracking.pose->pos += tracking.poseBuf[j]->pos;
                 }
-                handPose[i]->pos /= float(handPoseBufSize);
+                tracking.pose->pos /= float(handPoseBufSize);
 
-                handPose[i]->ori = handPoseBuf[i][handPoseBufIndex[i]]->ori;
+                tracking.pose->ori = tracking.poseBuf[tracking.poseBufIndex]->ori;
                 for (int j = 1; j < handPoseBufSize; j++) {
-                    handPose[i]->ori = glm::slerp(handPose[i]->ori, handPoseBuf[i][(handPoseBufIndex[i] + j) % handPoseBufSize]->ori, 1.0f / (j + 1));
+                    tracking.pose->ori = glm::slerp(tracking.pose->ori, tracking.poseBuf[(tracking.poseBufIndex + j) % handPoseBufSize]->ori, 1.0f / (j + 1));
                 }
             }
             else {
-                handPose[i] = std::nullopt;
+                tracking.pose = std::nullopt;
             }
-        }
+
+            if (tracking.pose.has_value())
+                gunAudioSrc[id.index]->setPos(tracking.pose->pos);
+        });
 
         if(dat.viewPose.has_value())
             alManager->setListenerPose(dat.viewPose.value());
-        for (int i = 0; i < 2; i++) {
-            if (handPose[i].has_value())
-                gunAudioSrc[i]->setPos(handPose[i]->pos);
-            if (!trigger_old[i] && dat.trigger[i]) {
+    }
+
+    // the targets and the effects, on the job workers. Each writes only its own store, so the results do
+    // not depend on the number of workers.
+    void procObjects(double dt) {
+        auto& jobs = JobSystem::shared();
+        auto procEffects = [&] {
+            scoreEffects->proc(float(dt));
+            boomEffects->proc(float(dt));
+        };
+        if (scoreEffects->size() + boomEffects->size() < ParticlePool::jobMin) {
+            procEffects();
+            targets->proc(dt, &jobs);
+            return;
+        }
+        JobSystem::Counter effectsDone;
+        jobs.run(procEffects, effectsDone);
+        targets->proc(dt, &jobs);
+        jobs.wait(effectsDone);
+    }
+
+    // once per step of tickTime
+    void proc_main(const GameData& dat) {
+        stage.prevRotate = stage.rotate;
+        stage.rotate += dat.dt * 0.1;
+        if (stage.rotate > 1.0f)
+            stage.rotate -= 1.0f;
+        hands.forEach([&](HandStore::Entity, const HandId& id, const HandTracking&, HandAim& aim, const HandTrigger& trigger) {
+            aim.rayD.reset();
+            const int i = id.index;
+            if (!trigger.old && dat.trigger[i]) {
                 gunAudioSrc[i]->play(gunSe.value());
                 if (dat.handVib[i].has_value()) {
                     dat.handVib[i]->get().vibrate(1.0);
                 }
             }
-        }
+        });
 
-        switch (scene)
+        switch (round.scene)
         {
             case Scene::Title: {
 
                 bool gameStart = false;
 
-                bool gsSelected_old = gsSelected;
-                gsSelected = false;
-                for (int i = 0; i < 2; i++) {
-                    bool gsSelectedHands_old = gsSelectedHands[i];
-                    gsSelectedHands[i] = false;
-                    if (handPose[i].has_value()) {
-                        auto col = Rect{ gameStartStrPose, 2.5, 0.5 }.RayCast(handPose[i]->pos, handPose[i]->ori * glm::vec3{ 0, 0, -1 });
+                bool gsSelected_old = round.gsSelected;
+                round.gsSelected = false;
+                hands.forEach([&](HandStore::Entity, const HandId& id, const HandTracking& tracking, HandAim& aim, const HandTrigger&) {
+                    const int i = id.index;
+                    bool onGameStart_old = aim.onGameStart;
+                    aim.onGameStart = false;
+                    if (tracking.pose.has_value()) {
+                        auto col = Rect{ stage.gameStartStrPose, 2.5, 0.5 }.RayCast(tracking.pose->pos, tracking.pose->ori * glm::vec3{ 0, 0, -1 });
                         if (col.has_value()) {
-                            rayD[i] = col.value().second;
-                            gsSelectedHands[i] = true;
-                            gsSelected = true;
+                            aim.rayD = col.value().second;
+                            aim.onGameStart = true;
+                            round.gsSelected = true;
                             if (gameDat.trigger[i])
                                 gameStart = true;
                         }
                     }
-                    if (gsSelectedHands_old != gsSelectedHands[i])
+                    if (onGameStart_old != aim.onGameStart && dat.handVib[i].has_value())
                         dat.handVib[i]->get().vibrate(0.1);
-                }
-                if (gsSelected != gsSelected_old) {
+                });
+                if (round.gsSelected != gsSelected_old) {
 
                 }
 
 
                 if (gameStart) {
-                    scene = Scene::MainGame;
-                    score = 0;
-                    gameTimer = 30.0;
+                    round.scene = Scene::MainGame;
+                    round.score = 0;
+                    round.gameTimer = 30.0;
                 }
 
                 break;
             }
             case Scene::MainGame: {
-                gameTimer -= dat.dt;
-
-                for (int i = 0; i < 2; i++) {
-                    if (!handPose[i].has_value())
-                        continue;
-
-                    std::optional<std::reference_wrapper<Target>> lockedon;
-                    Target::Hit hit;
-
-                    glm::vec3 colPos;
-                    for (auto& target : targets) {
-                        auto ray = handPose[i]->ori * glm::vec3{ 0, 0, -1 };
-                        auto res = target.RayCast(handPose[i]->pos, ray);
-                        if (!res.has_value())
-                            continue;
-                        auto d = res->rayLen;
-                        if (!rayD[i].has_value() || d < rayD[i].value()) {
-                            rayD[i] = d;
-                            colPos = handPose[i]->pos + d * ray;
-
-                            if (res->enable) {
-                                lockedon.emplace(target);
-                                hit = res.value();
-                            }
-                        }
-                    }
-                    if (lockedon.has_value() && gameDat.trigger[i]) {
-                        lockedon->get().alive = false;
+                round.gameTimer -= dat.dt;
+
+                glm::vec3 rayFrom[2], rayDir[2];
+                HandStore::Entity rayHand[2];
+                uint32_t rayCount = 0;
+                hands.forEach([&](HandStore::Entity hand, const HandId&, const HandTracking& tracking, const HandAim&, const HandTrigger&) {
+                    if (!tracking.pose.has_value())
+                        return;
+                    rayFrom[rayCount] = tracking.pose->pos;
+                    rayDir[rayCount] = tracking.pose->ori * glm::vec3{ 0, 0, -1 };
+                    rayHand[rayCount++] = hand;
+                });
+                // both rays see the targets as they were before either shot, like the old per-hand loop:
+                // both hands can score the same target in one step
+                TargetStore::RayResult rayRes[2];
+                targets->rayCast(rayFrom, rayDir, rayCount, rayRes, &JobSystem::shared());
+                TargetStore::Target killed[2];
+                uint32_t killCount = 0;
+
+                for (uint32_t r = 0; r < rayCount; r++) {
+                    const int i = hands.get<HandId>(rayHand[r]).index;
+                    if (rayRes[r].nearest.has_value())
+                        hands.get<HandAim>(rayHand[r]).rayD = rayRes[r].nearest->rayLen;
+
+                    if (rayRes[r].lockedOn.has_value() && gameDat.trigger[i]) {
+                        const auto& hit = rayRes[r].lockedOn.value();
+                        const auto colPos = rayRes[r].nearest->colPos;
+                        killed[killCount++] = hit.target;
 
                         seManager->play(tgtSe.value(), hit.colPos);
-                        for (int i = 0; i < 10; i++)
-                            boomEffects.emplace_back(hit.colPos);
+                        const ParticleBurst boom{ hit.colPos, stage.rightVec, stage.upperVec, 3.0f, 0.2f, 0.04f, 10 };
+                        if (gpuParticles)
+                            graphics->EmitParticles(boom);
+                        else
+                            boomEffects->emit(boom, effectRandom);
 
                         if (hit.dCenter < 0.04) {
-                            scoreEffects.emplace_back(colPos, 0);
-                            score += 100;
+                            scoreEffects->emit(colPos, 0.3f * stage.upperVec, 2.0f, 0);
+                            round.score += 100;
                         }
                         else if (hit.dCenter < 0.07) {
-                            scoreEffects.emplace_back(colPos, 1);
-                            score += 50;
+                            scoreEffects->emit(colPos, 0.3f * stage.upperVec, 2.0f, 1);
+                            round.score += 50;
                         }
                         else if (hit.dCenter < 0.13) {
-                            scoreEffects.emplace_back(colPos, 2);
-                            score += 30;
+                            scoreEffects->emit(colPos, 0.3f * stage.upperVec, 2.0f, 2);
+                            round.score += 30;
                         }
                         else {
-                            scoreEffects.emplace_back(colPos, 3);
-                            score += 10;
+                            scoreEffects->emit(colPos, 0.3f * stage.upperVec, 2.0f, 3);
+                            round.score += 10;
                         }
                     }
                 }
+                for (uint32_t k = 0; k < killCount; k++)
+                    targets->kill(killed[k]);
 
-
-                {
-                    tgtTimer -= gameDat.dt;
-                    if (tgtTimer <= 0) {
-                        tgtTimer = 0.5;
-                        targets.emplace_back();
+                if (sessionConfig.targetStress) {
+                    // staggered, so that they do not all rise and sink together
+                    while (targets->size() < targets->capacity())
+                        SpawnTarget(spawnRandom.uniform(0.0f, 7.0f));
+                }
+                else {
+                    round.tgtTimer -= gameDat.dt;
+                    if (round.tgtTimer <= 0) {
+                        round.tgtTimer = 0.5;
+                        SpawnTarget();
                     }
                 }
 
-                for (auto& target : targets) {
-                    target.proc(gameDat.dt);
-                }
-                {
-                    auto remove_it = std::remove_if(targets.begin(), targets.end(), [&](const auto& target) {
-                        return !target.alive;
-                    });
-                    targets.erase(remove_it, targets.end());
-                }
-                for (auto& effect : scoreEffects) {
-                    effect.proc(gameDat.dt);
-                }
-                {
-                    auto remove_it = std::remove_if(scoreEffects.begin(), scoreEffects.end(), [&](const auto& effect) {
-                        return !effect.alive;
-                    });
-                    scoreEffects.erase(remove_it, scoreEffects.end());
-                }
-                for (auto& effect : boomEffects) {
-                    effect.proc(gameDat.dt);
-                }
-                {
-                    auto remove_it = std::remove_if(boomEffects.begin(), boomEffects.end(), [&](const auto& effect) {
-                        return !effect.alive;
-                    });
-                    boomEffects.erase(remove_it, boomEffects.end());
-                }
+                procObjects(gameDat.dt);
 
-                if (gameTimer <= 0.0) {
-                    scene = Scene::ScoreResult;
-                    gameTimer = 8.0f;
-                    seManager->play(buzzerSe.value(), sightBase.pos + fwdVec * 2.0f + upperVec * 2.0f);
+                if (round.gameTimer <= 0.0) {
+                    round.scene = Scene::ScoreResult;
+                    round.gameTimer = 8.0f;
+                    seManager->play(buzzerSe.value(), stage.sightBase.pos + stage.fwdVec * 2.0f + stage.upperVec * 2.0f);
                 }
 
                 for (int i = 1; i <= 5; i++) {
-                    if (gameTimer >= i && gameTimer - dat.dt < i) {
-                        seManager->play(cntSe.value(), sightBase.pos + fwdVec * 1.0f + upperVec * 1.0f);
+                    if (round.gameTimer >= i && round.gameTimer - dat.dt < i) {
+                        seManager->play(cntSe.value(), stage.sightBase.pos + stage.fwdVec * 1.0f + stage.upperVec * 1.0f);
                     }
                 }
                 break;
             }
             case Scene::ScoreResult: {
-                gameTimer -= dat.dt;
-                for (auto& target : targets) {
-                    target.proc(gameDat.dt);
-                }
-                {
-                    auto remove_it = std::remove_if(targets.begin(), targets.end(), [&](const auto& target) {
-                        return !target.alive;
-                    });
-                    targets.erase(remove_it, targets.end());
-                }
-                for (auto& effect : scoreEffects) {
-                    effect.proc(gameDat.dt);
-                }
-                {
-                    auto remove_it = std::remove_if(scoreEffects.begin(), scoreEffects.end(), [&](const auto& effect) {
-                        return !effect.alive;
-                    });
-                    scoreEffects.erase(remove_it, scoreEffects.end());
-                }
-                for (auto& effect : boomEffects) {
-                    effect.proc(gameDat.dt);
-                }
-                {
-                    auto remove_it = std::remove_if(boomEffects.begin(), boomEffects.end(), [&](const auto& effect) {
-                        return !effect.alive;
-                    });
-                    boomEffects.erase(remove_it, boomEffects.end());
-                }
+                round.gameTimer -= dat.dt;
+                procObjects(gameDat.dt);
 
-                if (gameTimer >= 5.0f && gameTimer - dat.dt < 5.0f) {
-                    seManager->play(gunSe.value(), sightBase.pos + fwdVec * 1.0f + upperVec * 1.0f);
+                if (round.gameTimer >= 5.0f && round.gameTimer - dat.dt < 5.0f) {
+                    seManager->play(gunSe.value(), stage.sightBase.pos + stage.fwdVec * 1.0f + stage.upperVec * 1.0f);
                 }
 
-                if (gameTimer <= 0.0f) {
-                    scene = Scene::Title;
+                if (round.gameTimer <= 0.0f) {
+                    round.scene = Scene::Title;
                 }
 
                 break;
@@ -505,101 +510,101 @@ namespace Game {
     }
 
     void proc(const GameData& dat) {
-        for (int i = 0; i < 2; i++)
-            trigger_old[i] = gameDat.trigger[i];
-        gameDat = dat;
-
-
-        if (initialized) {
-            proc_main(dat);
-            seManager->update(dat.dt);
-        }
-        else {
+        if (!initialized) {
             proc_init(dat);
+            return;
         }
-    }
 
-    void draw(IGraphicsProvider& g) {
-        for (int i = 0; i < 2; i++) {
-            if (handPose[i].has_value()) {
-                g.DrawModel(gunModel, handPose[i]->pos, handPose[i]->ori, glm::vec3{ 0.05, 0.05, 0.05 });
-
-                g.DrawModel(beamModel, handPose[i]->pos, handPose[i]->ori, glm::vec3{ 0.02, 0.02, rayD[i].has_value() ? rayD[i].value() : 10 });
-                if(rayD[i].has_value())
-                    g.DrawModel(sphereModel, handPose[i]->pos + float(rayD[i].value()) * (handPose[i]->ori * glm::vec3{ 0, 0, -1 }), handPose[i]->ori, glm::vec3{ 0.01, 0.01, 0.01 });
-            }
+        proc_frame(dat);
+        hands.forEach([&](HandStore::Entity, const HandId& id, const HandTracking&, const HandAim&, HandTrigger& trigger) {
+            trigger.pending = trigger.pending || dat.trigger[id.index];
+        });
+
+        tickAccumulator += std::min(dat.dt, maxFrameTime);
+        while (tickAccumulator >= tickTime) {
+            tickAccumulator -= tickTime;
+            const GameData lastDat = gameDat;
+            gameDat = dat;
+            gameDat.dt = tickTime;
+            hands.forEach([&](HandStore::Entity, const HandId& id, const HandTracking&, const HandAim&, HandTrigger& trigger) {
+                trigger.old = lastDat.trigger[id.index];
+                gameDat.trigger[id.index] = trigger.pending;
+                trigger.pending = false;
+            });
+            proc_main(gameDat);
         }
+        tickAlpha = float(tickAccumulator / tickTime);
 
-        g.DrawModel(testModel, stagePose.pos, stagePose.ori, glm::vec3(0.5, 0.02, 0.5),
-                    glm::rotate(float(stageRotate * 2 * pi), glm::vec3(0, 1, 0)) * glm::rotate(float(pi), glm::vec3(0, 0, 1)));
+        seManager->update(dat.dt);
+    }
 
-        switch (scene)
+    void draw(IGraphicsProvider& g) {
+        hands.forEach([&](HandStore::Entity, const HandId&, const HandTracking& tracking, const HandAim& aim, const HandTrigger&) {
+            if (!tracking.pose.has_value())
+                return;
+            const Pose& pose = tracking.pose.value();
+            g.DrawModel(gunModel, pose.pos, pose.ori, glm::vec3{ 0.05, 0.05, 0.05 });
+
+            g.DrawModel(beamModel, pose.pos, pose.ori, glm::vec3{ 0.02, 0.02, aim.rayD.has_value() ? aim.rayD.value() : 10 });
+            if (aim.rayD.has_value())
+                g.DrawModel(sphereModel, pose.pos + float(aim.rayD.value()) * (pose.ori * glm::vec3{ 0, 0, -1 }), pose.ori, glm::vec3{ 0.01, 0.01, 0.01 });
+        });
+
+        double stageRotateStep = stage.rotate - stage.prevRotate;
+        if (stageRotateStep < 0.0)
+            stageRotateStep += 1.0;
+        g.DrawModel(testModel, stage.pose.pos, stage.pose.ori, glm::vec3(0.5, 0.02, 0.5),
+                    glm::rotate(float((stage.prevRotate + stageRotateStep * tickAlpha) * 2 * pi), glm::vec3(0, 1, 0)) * glm::rotate(float(pi), glm::vec3(0, 0, 1)));
+
+        switch (round.scene)
         {
             case Scene::Title: {
-                if (gsSelected)
-                    g.DrawModel(gamestartSelectedModel, gameStartStrPose.pos, gameStartStrPose.ori, glm::vec3(0.5, 0.5, 0.5));
-                else
-                    g.DrawModel(gamestartModel, gameStartStrPose.pos, gameStartStrPose.ori, glm::vec3(0.5, 0.5, 0.5));
+                // the text meshes are read from their -z side, panels from their +z side
+                auto flip = glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0,1,0 });
+                if (g.BeginPanel(titlePanel, round.gsSelected)) {
+                    g.DrawModel(round.gsSelected ? gamestartSelectedModel : gamestartModel, glm::vec3(0.0), flip, glm::vec3(0.5, 0.5, 0.5));
+                    g.EndPanel();
+                }
+                g.DrawPanel(titlePanel, stage.gameStartStrPose.pos, stage.gameStartStrPose.ori * glm::inverse(flip));
                 break;
             }
             case Scene::MainGame: {
-                for (const auto& target : targets) {
-                    g.DrawModel(tgtModel, target.pose.pos, target.pose.ori, glm::vec3(0.2, 0.2, 0.2));
-                }
-                for (const auto& effect : scoreEffects) {
-                    effect.draw(g);
-                }
-                for (const auto& effect : boomEffects) {
-                    effect.draw(g);
-                }
+                targets->forEach([&](TargetStore::Target target) {
+                    g.DrawModel(tgtModel, targets->getPosition(target, tickAlpha), targets->getRotation(target, tickAlpha), glm::vec3(0.2, 0.2, 0.2));
+                });
+                drawEffects(g);
+                if (gpuParticles)
+                    g.DrawParticles();
 
-                g.DrawModel(timeModel, sightBase.pos + fwdVec * 20.0f + upperVec * 6.0f,
-                            sightBase.ori * glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0,1,0 }), glm::vec3(4.0, 4.0, 4.0));
-                g.DrawModel(numberModel[int(gameTimer) / 10], sightBase.pos + fwdVec * 20.0f - rightVec * 3.0f,
-                            sightBase.ori * glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0,1,0 }), glm::vec3(10.0, 10.0, 10.0));
-                g.DrawModel(numberModel[int(gameTimer) % 10], sightBase.pos + fwdVec * 20.0f + rightVec * 3.0f,
-                            sightBase.ori * glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0,1,0 }), glm::vec3(10.0, 10.0, 10.0));
+                // the timer panel is centered 2m above the digits
+                if (g.BeginPanel(timerPanel, int(round.gameTimer))) {
+                    g.DrawString("TIME", glm::vec3(0.0, 4.0, 0.0), glm::identity<glm::quat>(), 2.4f, timeLabelColor);
+                    g.DrawString(fmt::format("{:02}", int(round.gameTimer)), glm::vec3(0.0, -2.0, 0.0), glm::identity<glm::quat>(), 6.0f, digitColor);
+                    g.EndPanel();
+                }
+                g.DrawPanel(timerPanel, stage.sightBase.pos + stage.fwdVec * 20.0f + stage.upperVec * 2.0f, stage.sightBase.ori);
 
                 break;
             }
             case Scene::ScoreResult: {
-                if (gameTimer < 7.0f) {
-                    g.DrawModel(scoreStrModel, sightBase.pos + fwdVec * 20.0f + upperVec * 8.0f,
-                                sightBase.ori * glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0,1,0 }), glm::vec3(4.0, 4.0, 4.0));
-                }
-
-                if (gameTimer < 5.0f) {
-                    int scoreDig = 0;
-                    {
-                        int tmp = score;
-                        while (tmp > 0) {
-                            scoreDig++;
-                            tmp /= 10;
-                        }
-                        if (scoreDig == 0)
-                            scoreDig = 1;
-                    }
-                    {
-                        int tmp = score;
-                        auto tmpOri = sightBase.ori * glm::rotate(glm::identity<glm::quat>(), float(pi), glm::vec3{ 0,1,0 });
-
-                        for (int i = 0; i < scoreDig; i++) {
-                            g.DrawModel(numberModel[int(tmp) % 10], sightBase.pos + fwdVec * 20.0f + rightVec * ((scoreDig - 1) / 2.0f - i) * 4.5f,
-                                        tmpOri, glm::vec3(6.0, 6.0, 6.0));
-                            tmp /= 10;
-                        }
+                // the score panel is centered 4m above the digits; the digits appear after the label
+                if (round.gameTimer < 7.0f) {
+                    bool showDigits = round.gameTimer < 5.0f;
+                    if (g.BeginPanel(scorePanel, uint64_t(round.score) * 2 + showDigits)) {
+                        g.DrawString("SCORE", glm::vec3(0.0, 4.0, 0.0), glm::identity<glm::quat>(), 2.4f, scoreLabelColor);
+                        if (showDigits)
+                            g.DrawString(fmt::format("{}", round.score), glm::vec3(0.0, -4.0, 0.0), glm::identity<glm::quat>(), 4.2f, digitColor);
+                        g.EndPanel();
                     }
+                    g.DrawPanel(scorePanel, stage.sightBase.pos + stage.fwdVec * 20.0f + stage.upperVec * 4.0f, stage.sightBase.ori);
                 }
 
-                for (const auto& target : targets) {
-                    g.DrawModel(tgtModel, target.pose.pos, target.pose.ori, glm::vec3(0.2, 0.2, 0.2));
-                }
-                for (const auto& effect : scoreEffects) {
-                    effect.draw(g);
-                }
-                for (const auto& effect : boomEffects) {
-                    effect.draw(g);
-                }
+                targets->forEach([&](TargetStore::Target target) {
+                    g.DrawModel(tgtModel, targets->getPosition(target, tickAlpha), targets->getRotation(target, tickAlpha), glm::vec3(0.2, 0.2, 0.2));
+                });
+                drawEffects(g);
+                if (gpuParticles)
+                    g.DrawParticles();
             }
             default:
                 break;
@@ -5,6 +5,7 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include "GraphicsProvider.hpp"
+#include <cstdint>
 #include <optional>
 
 namespace Game {
@@ -30,8 +31,25 @@ struct GameData {
 	std::optional<std::reference_wrapper<IVibrationProvider>> handVib[2];
 };
 
+// what a session depends on besides its GameData stream, so that a recording of the stream replays the same
+struct SessionConfig {
+	uint64_t seed;
+	int32_t simHz;
+	bool targetStress;
+	bool targetTree;
+};
+
+// loads the resources and starts a session from the debug.hello_xr settings
 void init(IGraphicsProvider& g);
 
+// back to the title with a new session
+void reset(const SessionConfig& config);
+
+const SessionConfig& getSessionConfig();
+
+// hash of the simulation state after the last proc(), to check that a replay runs the same as the recording
+uint64_t stateHash();
+
 void proc(const GameData& dat);
 
 void draw(IGraphicsProvider& g);
@@ -6,18 +6,42 @@
 
 #include <openxr/openxr.hpp>
 
+class RenderSnapshot;
+
 struct Swapchain {
 	xr::UniqueSwapchain handle;
 	xr::Extent2Di extent;
 };
 
+struct PanelLayerState {
+	bool visible;
+	bool dirty;		// content changed since the last renderPanelLayer()
+	xr::Posef pose;
+	xr::Extent2Df size;
+};
+
 class IGraphicsManager {
 public:
 	virtual std::unique_ptr<xr::impl::InputStructBase> getXrGraphicsBinding() const = 0;
 	virtual int64_t chooseImageFormat(const std::vector<int64_t>& formats) const = 0;
-	virtual void InitializeRenderTargets(const std::vector<Swapchain>& swapchains, int64_t format) = 0;
+	virtual void InitializeRenderTargets(const std::vector<Swapchain>& swapchains, int64_t format, uint32_t sampleCount) = 0;
 	virtual void PrepareResources() = 0;
+	virtual void update(double dt) = 0;
 	virtual void render(int viewIndex, int imageIndex, const xr::CompositionLayerProjectionView& view) = 0;
+	// With a snapshot, render() draws it instead of calling Game::draw(), which then belongs to the simulation thread.
+	// It has to stay unchanged until the last render() of the frame.
+	virtual void setRenderSnapshot(const RenderSnapshot* snapshot) = 0;
+
+	// Panels composited by the runtime as quad layers instead of being drawn into the eye buffers.
+	// One swapchain per panel, in the order of getPanelExtents(); panels without a swapchain stay in the eye buffers.
+	virtual std::vector<xr::Extent2Di> getPanelExtents() const = 0;
+	virtual void InitializePanelLayers(const std::vector<Swapchain>& swapchains, int64_t format) = 0;
+	virtual PanelLayerState getPanelLayerState(int panelIndex) const = 0;
+	virtual void renderPanelLayer(int panelIndex, int imageIndex) = 0;
+
+	// In-headset performance overlay. The CPU time of the game update is reported every frame before render().
+	virtual void setPerfOverlay(bool visible) = 0;
+	virtual void reportSimTime(double simMs, double displayPeriodMs) = 0;
 };
 
 #endif
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <chrono>
 #include <fmt/format.h>
 
 #define XR_NULL_ASYNC_REQUEST_ID_FB 0
@@ -27,9 +28,17 @@
 
 #include "vk_impl_utils.hpp"
 #include "vk_model.hpp"
+#include "vk_particles.hpp"
+#include "vk_panel.hpp"
+#include "vk_text.hpp"
+#include "vk_perf_overlay.hpp"
+#include "JobSystem.hpp"
+#include "OcclusionCuller.hpp"
+#include "RenderSnapshot.hpp"
 
 std::optional<TextureImage> ModelData::defaultTexture;
-vk::UniqueSampler ModelData::defaultSampler;
+std::optional<SamplerCache> ModelData::samplerCache;
+std::optional<DescriptorAllocator> ModelData::materialDescAllocator;
 
 auto CreateTranslationRotationScale(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
     return glm::translate(glm::identity<glm::mat4>(), translation)
@@ -42,6 +51,11 @@ auto CreateTranslationRotationScale(const xr::Posef& pose, const glm::vec3& scal
 
 class VulkanManager : public IGraphicsManager {
     vk::Instance instance;
+    // validation layer, debug-utils names and labels; off by default, as validation costs CPU on every call
+    bool vkDebug = false;
+    DebugUtils debug;
+    // VK_KHR_dynamic_rendering for the eye passes instead of a render pass and per-image framebuffers; needs Vulkan 1.1
+    bool dynamicRendering = false;
     vk::PhysicalDevice physicalDevice;
     uint32_t queueFamilyIndex;
     uint32_t queueIndex;
@@ -61,14 +75,123 @@ class VulkanManager : public IGraphicsManager {
     std::optional<ModelData> stageModel;
 
     std::vector<ModelData> modelDb;
+    std::optional<GeometryPool> geometryPool;
+    std::optional<PoseBuffer> poseBuffer;
+    std::optional<ParticleSystem> particleSystem;
+    bool particlesRequested = false;
+
+    struct DrawPacket {
+        ModelHandle model;
+        glm::mat4 mvp;
+        float viewDepth;
+        uint32_t id;
+        bool culled;
+        uint32_t instance;  // pose in poseBuffer, 0: drawn with mvp
+    };
+    std::vector<DrawPacket> drawPackets;
+    std::vector<glm::mat4> mvps;       // of every recorded draw
+    std::vector<uint8_t> occluderFlags;
+
+    std::optional<TextRenderer> textRenderer;
+    struct TextDraw {
+        std::string text;
+        glm::mat4 mat;
+        glm::vec3 color;
+    };
+    std::vector<TextDraw> textDraws;
+
+    struct Panel {
+        struct Item {
+            ModelHandle model;
+            glm::mat4 mat;      // panel space
+        };
+        glm::vec2 size;
+        vk::Extent2D extent;
+        std::optional<uint64_t> contentKey;
+        std::vector<Item> items;
+        std::vector<TextDraw> texts;    // panel space
+        bool dirty = false;
+        std::optional<PanelTarget> target;     // only with the HUD cache
+
+        // quad layer; drawn by the compositor at the last DrawPanel() pose
+        std::optional<PanelTarget> layer;
+        bool layerVisible = false;
+        glm::vec3 layerPos;
+        glm::quat layerRot;
+    };
+    struct PanelDraw {
+        PanelHandle panel;
+        glm::mat4 world;
+    };
+    std::vector<Panel> panels;
+    std::vector<PanelDraw> panelDraws;
+    std::optional<PanelHandle> recordingPanel;
+    bool hudCache = false;
+    struct HudCounter {
+        size_t draws = 0;
+        uint32_t renders = 0;
+        double cpuMs = 0.0;
+        uint32_t views = 0;
+    } hudCounter;
+
+    std::optional<OcclusionCuller> occlusionCuller;
+    // kept across frames, so that filling them does not allocate
+    struct OcclusionLists {
+        std::vector<const DrawPacket*> candidates;
+        std::vector<OcclusionCuller::Occluder> occluders;
+        std::vector<OcclusionCuller::Occludee> occludees;
+    } occlusionLists;
+    struct OcclusionCounter {
+        uint64_t draws = 0;
+        uint64_t culled = 0;
+        uint32_t views = 0;
+    } occlusionCounter;
+
+    bool drawSort = true;
+    bool depthPrepass = false;
+    bool overdrawStats = false;
+    bool pipelineStatisticsSupported = false;
+
+    std::vector<FragmentStatsQuery> fragmentStats;
+
+    // created when the device supports timestamps, measures only while visible
+    std::optional<PerfOverlay> perfOverlay;
+    bool perfOverlayVisible = false;
+    struct OverdrawCounter {
+        double fragments = 0.0;
+        double pixels = 0.0;
+        size_t draws = 0;
+        uint32_t frames = 0;
+    } overdrawCounter;
 
     void CreateInstance(xr::Instance xrInstance, xr::SystemId systemId) {
         auto graphicsRequirements = xrInstance.getVulkanGraphicsRequirements2KHR(systemId, xr::DispatchLoaderDynamic{ xrInstance });
 
         std::cout << fmt::format("Required Vulkan Version: {} ~ {}", to_string(graphicsRequirements.minApiVersionSupported), to_string(graphicsRequirements.maxApiVersionSupported)) << std::endl;
 
-        std::vector<const char*> exts = { "VK_EXT_debug_report" };
-        std::vector<const char*> layers = { /* "VK_LAYER_KHRONOS_validation" */ };
+        std::vector<const char*> exts = {};
+        std::vector<const char*> layers = {};
+        bool debugUtils = false;
+        if (vkDebug) {
+            static constexpr const char* validationLayer = "VK_LAYER_KHRONOS_validation";
+            auto availableLayers = vk::enumerateInstanceLayerProperties();
+            if (std::any_of(availableLayers.begin(), availableLayers.end(), [&](const vk::LayerProperties& layer) { return std::string_view(layer.layerName.data()) == validationLayer; }))
+                layers.push_back(validationLayer);
+            else
+                std::cout << "VK_LAYER_KHRONOS_validation is not available" << std::endl;
+
+            // also provided by the validation layer
+            auto availableExts = vk::enumerateInstanceExtensionProperties();
+            if (!layers.empty()) {
+                auto layerExts = vk::enumerateInstanceExtensionProperties(std::string(validationLayer));
+                availableExts.insert(availableExts.end(), layerExts.begin(), layerExts.end());
+            }
+            debugUtils = std::any_of(availableExts.begin(), availableExts.end(), [](const vk::ExtensionProperties& ext) { return std::string_view(ext.extensionName.data()) == VK_EXT_DEBUG_UTILS_EXTENSION_NAME; });
+            if (debugUtils)
+                exts.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+            else
+                std::cout << VK_EXT_DEBUG_UTILS_EXTENSION_NAME " is not available" << std::endl;
+        }
 
         vk::ApplicationInfo appInfo;
         appInfo.pApplicationName = "XRTest";
@@ -76,6 +199,14 @@ class VulkanManager : public IGraphicsManager {
         appInfo.pEngineName = "XRTest";
         appInfo.engineVersion = 1;
         appInfo.apiVersion = VK_API_VERSION_1_0;
+        if (dynamicRendering) {
+            if (vk::enumerateInstanceVersion() >= VK_API_VERSION_1_1)
+                appInfo.apiVersion = VK_API_VERSION_1_1;
+            else {
+                std::cout << "Dynamic rendering: Vulkan 1.1 is not available" << std::endl;
+                dynamicRendering = false;
+            }
+        }
 
 
         vk::InstanceCreateInfo createInfo{};
@@ -100,6 +231,8 @@ class VulkanManager : public IGraphicsManager {
             throw std::runtime_error(fmt::format("Vulkan Instance Creation Error(Vk): {}", to_string(vk::Result(vkResult))));
 
         this->instance = tmpInst;
+        if (debugUtils)
+            debug.init(instance);
     }
 
     void ChoosePhysicalDevice(xr::Instance xrInstance, xr::SystemId systemId) {
@@ -146,17 +279,45 @@ class VulkanManager : public IGraphicsManager {
         };
 
         std::vector<const char*> exts = {};
-        std::vector<const char*> layers = { "VK_LAYER_KHRONOS_validation" };
+        // device layers are deprecated, validation is enabled on the instance
 
         vk::PhysicalDeviceFeatures features{};
+        pipelineStatisticsSupported = physicalDevice.getFeatures().pipelineStatisticsQuery;
+        features.pipelineStatisticsQuery = pipelineStatisticsSupported;
+
+        vk::PhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures;
+        if (dynamicRendering) {
+            // with the extensions it depends on that are not core in 1.1
+            const std::vector<const char*> required = {
+                VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME
+            };
+            auto available = physicalDevice.enumerateDeviceExtensionProperties();
+            bool supported = physicalDevice.getProperties().apiVersion >= VK_API_VERSION_1_1
+                && std::all_of(required.begin(), required.end(), [&](const char* name) {
+                    return std::any_of(available.begin(), available.end(), [&](const vk::ExtensionProperties& ext) { return std::string_view(ext.extensionName.data()) == name; });
+                });
+            if (supported) {
+                auto chain = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDynamicRenderingFeaturesKHR>();
+                supported = chain.get<vk::PhysicalDeviceDynamicRenderingFeaturesKHR>().dynamicRendering;
+            }
+            if (supported) {
+                exts.insert(exts.end(), required.begin(), required.end());
+                dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+            }
+            else {
+                std::cout << "Dynamic rendering is not supported, using a render pass" << std::endl;
+                dynamicRendering = false;
+            }
+        }
 
         vk::DeviceCreateInfo createInfo{};
         createInfo.queueCreateInfoCount = queueInfo.size();
         createInfo.pQueueCreateInfos = queueInfo.data();
         createInfo.enabledExtensionCount = exts.size();
         createInfo.ppEnabledExtensionNames = exts.data();
-        createInfo.enabledLayerCount = layers.size();
-        createInfo.ppEnabledLayerNames = layers.data();
+        createInfo.pEnabledFeatures = &features;
+        if (dynamicRendering)
+            createInfo.pNext = &dynamicRenderingFeatures;
 
         const VkDeviceCreateInfo c_createInfo = (VkDeviceCreateInfo)createInfo;
 
@@ -188,24 +349,318 @@ class VulkanManager : public IGraphicsManager {
     public:
         VulkanGraphicsProvider(VulkanManager* p) : manager(p) {}
         ModelHandle LoadModel(const char* path) override {
-            manager->modelDb.emplace_back(manager->device, manager->allocator.value(), manager->cmdBufs.value(), manager->queue, manager->renderproc->getDescriptorSetLayout(), path);
+            manager->modelDb.emplace_back(manager->device, manager->allocator.value(), manager->cmdBufs.value(), manager->queue, manager->renderproc->getDescriptorSetLayout(), path,
+                manager->geometryPool ? &manager->geometryPool.value() : nullptr);
+            manager->occluderFlags.push_back(false);
+            if (manager->debug.isEnabled())
+                manager->modelDb.back().setDebugNames(manager->device, manager->debug, path);
             return manager->modelDb.size() - 1;
         }
-        void DrawModel(ModelHandle model, const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale, const glm::mat4& mat) override {
-            assert(manager->activeCmdBuf.has_value());
-
-            auto mvp = manager->currentVp * CreateTranslationRotationScale(pos, rot, scale) * mat;
-
-            manager->modelDb[model].DrawModel(manager->activeCmdBuf.value(), manager->renderproc->getPipelineLayout(), mvp);
+        void DrawString(std::string_view text, const glm::vec3& pos, const glm::quat& rot, float height, const glm::vec3& color) override {
+            if (!manager->textRenderer)
+                return;
+            TextDraw draw{ std::string(text), CreateTranslationRotationScale(pos, rot, glm::vec3(height)), color };
+            if (manager->recordingPanel)
+                manager->panels[manager->recordingPanel.value()].texts.push_back(std::move(draw));
+            else
+                manager->textDraws.push_back(std::move(draw));
+        }
+        bool InitParticles(const char* modelPath, uint32_t capacity) override {
+            if (!manager->renderproc->hasParticles())
+                return false;
+            manager->particleSystem.emplace(manager->device, manager->allocator.value(), manager->cmdBufs.value(), manager->queue,
+                manager->renderproc->getDescriptorSetLayout(), manager->renderproc->getParticleSetLayout(), modelPath, capacity);
+            return true;
+        }
+        void EmitParticles(const ParticleBurst& burst) override {
+            manager->particleSystem->emit(burst);
+        }
+        void DrawParticles() override {
+            manager->particlesRequested = true;
+        }
+        void SetOccluder(ModelHandle model, bool occluder) override {
+            manager->occluderFlags[model] = occluder;
+        }
+        PanelHandle CreatePanel(uint32_t width, uint32_t height, const glm::vec2& size) override {
+            auto& panel = manager->panels.emplace_back();
+            panel.size = size;
+            panel.extent = vk::Extent2D{ width, height };
+            if (manager->hudCache)
+                panel.target.emplace(manager->device, manager->allocator.value(), manager->renderproc.value(), vk::Extent2D{ width, height }, size);
+            return manager->panels.size() - 1;
+        }
+        bool BeginPanel(PanelHandle handle, uint64_t contentKey) override {
+            auto& panel = manager->panels[handle];
+            if (panel.contentKey == contentKey)
+                return false;
+            panel.contentKey = contentKey;
+            panel.items.clear();
+            panel.texts.clear();
+            panel.dirty = true;
+            manager->recordingPanel = handle;
+            drawList.setTarget(handle);
+            return true;
+        }
+        void EndPanel() override {
+            manager->recordingPanel.reset();
+            drawList.setTarget(DrawList::world);
+        }
+        void DrawPanel(PanelHandle handle, const glm::vec3& pos, const glm::quat& rot) override {
+            auto& panel = manager->panels[handle];
+            if (panel.layer) {
+                panel.layerVisible = true;
+                panel.layerPos = pos;
+                panel.layerRot = rot;
+                return;
+            }
+            manager->panelDraws.push_back({ handle, CreateTranslationRotationScale(pos, rot, glm::vec3{ 1,1,1 }) });
         }
     };
 
-    std::optional<vk::CommandBuffer> activeCmdBuf;
     std::optional<VulkanGraphicsProvider> provider;
+    const RenderSnapshot* renderSnapshot = nullptr;     // drawn instead of Game::draw() when the game runs on its own thread
     glm::mat4 currentVp;
+    glm::mat4 currentView;
+
+    // which packets SubmitDrawPackets() records; occluder packets are never culled
+    enum class PacketSet {
+        All, Occluders, Others,
+    };
+
+    void SubmitDrawPackets(const vk::CommandBuffer& cmdBuf, PacketSet set = PacketSet::All) {
+        if (geometryPool)
+            geometryPool->bind(cmdBuf, renderproc->getPipelineLayout());
+        // posed packets share the view-projection; it has to be pushed again after a packet with its own mvp
+        bool vpPushed = false;
+        for (const auto& packet : drawPackets) {
+            if (packet.culled)
+                continue;
+            if (set != PacketSet::All && (occluderFlags[packet.model] != 0) != (set == PacketSet::Occluders))
+                continue;
+            if (packet.instance != 0) {
+                if (!vpPushed) {
+                    cmdBuf.pushConstants(renderproc->getPipelineLayout(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(glm::mat4), &currentVp);
+                    vpPushed = true;
+                }
+                modelDb[packet.model].DrawModelPosed(cmdBuf, renderproc->getPipelineLayout(), packet.instance);
+            }
+            else {
+                modelDb[packet.model].DrawModel(cmdBuf, renderproc->getPipelineLayout(), packet.mvp);
+                vpPushed = false;
+            }
+        }
+    }
+
+    // Turns the draws recorded by Game::draw() into draw packets and panel items.
+    // The MVPs are built in one SIMD batch, split across the job workers for large scenes. With pose submission the matrix is built in the vertex shader;
+    // the CPU one is then only needed for occlusion culling.
+    void CollectDraws() {
+        const auto& drawList = provider->drawList;
+        const auto& transforms = drawList.getTransforms();
+        const auto& draws = drawList.getDraws();
+
+        const bool batched = !poseBuffer || occlusionCuller;
+        if (batched) {
+            mvps.resize(transforms.size());
+            transforms.computeMvps(currentVp, mvps.data(), &JobSystem::shared());
+        }
+
+        for (uint32_t i = 0; i < draws.size(); i++) {
+            const auto& draw = draws[i];
+            if (draw.target != DrawList::world) {
+                auto modelMat = transforms.computeMvp(i, glm::identity<glm::mat4>());
+                panels[draw.target].items.push_back({ draw.model, draw.mat ? modelMat * drawList.getMat(draw) : modelMat });
+                continue;
+            }
+
+            auto pos = transforms.getPosition(i);
+            auto viewPos = currentView * glm::vec4(pos, 1.0f);
+            uint32_t instance = poseBuffer && !draw.mat ? poseBuffer->push(pos, transforms.getRotation(i), transforms.getScale(i)) : 0;
+
+            glm::mat4 mvp{};
+            if (batched)
+                mvp = mvps[i];
+            else if (instance == 0)
+                mvp = transforms.computeMvp(i, currentVp);
+            if (draw.mat)
+                mvp = mvp * drawList.getMat(draw);
+
+            drawPackets.push_back({ draw.model, mvp, -viewPos.z, uint32_t(drawPackets.size()), false, instance });
+        }
+    }
+
+    // Starts the occlusion test of this view's packets on the worker thread.
+    // The nearest few occluder packets are rasterized, and every packet's bounds are tested.
+    void BeginOcclusionCulling() {
+        constexpr size_t maxOccluders = 8;
+
+        auto& candidates = occlusionLists.candidates;
+        candidates.clear();
+        for (const auto& packet : drawPackets) {
+            if (occluderFlags[packet.model])
+                candidates.push_back(&packet);
+        }
+        if (candidates.size() > maxOccluders) {
+            std::nth_element(candidates.begin(), candidates.begin() + maxOccluders, candidates.end(), [](const DrawPacket* a, const DrawPacket* b) {
+                return a->viewDepth < b->viewDepth;
+            });
+            candidates.resize(maxOccluders);
+        }
+
+        auto& occluders = occlusionLists.occluders;
+        occluders.clear();
+        for (const auto* packet : candidates) {
+            const auto& mesh = modelDb[packet->model].getCpuMesh();
+            occluders.push_back({ uint32_t(packet->model), &mesh.positions, &mesh.indices, packet->mvp });
+        }
+
+        auto& occludees = occlusionLists.occludees;
+        occludees.clear();
+        for (const auto& packet : drawPackets) {
+            const auto& mesh = modelDb[packet.model].getCpuMesh();
+            occludees.push_back({ mesh.boundsMin, mesh.boundsMax, packet.mvp });
+        }
+
+        occlusionCuller->begin(occluders, occludees);
+    }
+
+    // The occluders may have been recorded already, so they stay in even where they are hidden.
+    void FinishOcclusionCulling() {
+        const auto& visible = occlusionCuller->wait();
+        uint32_t culled = 0;
+        for (auto& packet : drawPackets) {
+            packet.culled = !visible[packet.id] && !occluderFlags[packet.model];
+            culled += packet.culled;
+        }
+
+        occlusionCounter.draws += drawPackets.size();
+        occlusionCounter.culled += culled;
+        occlusionCounter.views++;
+
+        if (occlusionCounter.views >= 300) {
+            auto stats = occlusionCuller->takeStats();
+            std::cout << fmt::format("Occlusion culling: {}/{} draws culled ({:.1f}%, {} outside frustum), {:.3f} ms/view on worker",
+                occlusionCounter.culled, occlusionCounter.draws,
+                occlusionCounter.draws ? 100.0 * occlusionCounter.culled / occlusionCounter.draws : 0.0,
+                stats.outside, stats.jobs ? stats.workerMs / stats.jobs : 0.0) << std::endl;
+            occlusionCounter = {};
+        }
+    }
+
+    // Text pipeline must be bound. Texts are blended, so they go after the opaque geometry they overlap.
+    void SubmitTexts(const vk::CommandBuffer& cmdBuf, const std::vector<TextDraw>& texts, const glm::mat4& vp) {
+        for (const auto& text : texts)
+            textRenderer->draw(cmdBuf, renderproc->getPipelineLayout(), vp * text.mat, text.text, text.color);
+    }
+
+    // Panel content is only rendered when it has changed since the last frame.
+    void RenderPanels(const vk::CommandBuffer& cmdBuf) {
+        for (auto& panel : panels) {
+            if (!panel.dirty || !panel.target)
+                continue;
+            panel.dirty = false;
+
+            auto start = std::chrono::steady_clock::now();
+            panel.target->begin(cmdBuf);
+            if (geometryPool)
+                geometryPool->bind(cmdBuf, renderproc->getPipelineLayout());
+            for (const auto& item : panel.items)
+                modelDb[item.model].DrawModel(cmdBuf, renderproc->getPipelineLayout(), panel.target->getProjection() * item.mat);
+            if (!panel.texts.empty()) {
+                panel.target->bindPipeline(cmdBuf, PipelineVariant::Text);
+                SubmitTexts(cmdBuf, panel.texts, panel.target->getProjection());
+            }
+            panel.target->end(cmdBuf);
+
+            hudCounter.cpuMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            hudCounter.renders++;
+        }
+    }
+
+    // Cached panels are one quad each; without the cache every model of the panel is drawn.
+    void SubmitPanels(const vk::CommandBuffer& cmdBuf, const SwapchainRenderTargets& renderTarget) {
+        auto start = std::chrono::steady_clock::now();
+
+        renderTarget.bindPipeline(cmdBuf, hudCache ? PipelineVariant::Panel : PipelineVariant::Opaque);
+        for (const auto& draw : panelDraws) {
+            const auto& panel = panels[draw.panel];
+            if (panel.target) {
+                PushConstantData pcd{};
+                pcd.mvp = currentVp * draw.world * panel.target->getQuadMatrix();
+                cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, renderproc->getPipelineLayout(), 0, { panel.target->getDescriptorSet() }, {});
+                cmdBuf.pushConstants(renderproc->getPipelineLayout(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(pcd), &pcd);
+                cmdBuf.draw(6, 1, 0, 0);
+                hudCounter.draws++;
+            }
+            else {
+                for (const auto& item : panel.items) {
+                    modelDb[item.model].DrawModel(cmdBuf, renderproc->getPipelineLayout(), currentVp * draw.world * item.mat);
+                    hudCounter.draws++;
+                }
+            }
+        }
+
+        // texts of uncached panels, after all of their models
+        bool textBound = false;
+        for (const auto& draw : panelDraws) {
+            const auto& panel = panels[draw.panel];
+            if (panel.target || panel.texts.empty())
+                continue;
+            if (!textBound) {
+                renderTarget.bindPipeline(cmdBuf, PipelineVariant::Text);
+                textBound = true;
+            }
+            SubmitTexts(cmdBuf, panel.texts, currentVp * draw.world);
+            hudCounter.draws += panel.texts.size();
+        }
+
+        hudCounter.cpuMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void UpdateHudCounter() {
+        hudCounter.views++;
+        if (hudCounter.views >= 300) {
+            std::cout << fmt::format("HUD: {:.1f} draws/view, {} offscreen renders, {:.3f} ms/view CPU (cache: {})",
+                double(hudCounter.draws) / hudCounter.views, hudCounter.renders, hudCounter.cpuMs / hudCounter.views,
+                hudCache ? "on" : "off") << std::endl;
+            hudCounter = {};
+        }
+    }
+
+    void CountOverlayDraws() {
+        uint32_t draws = 0, triangles = 0;
+        for (const auto& packet : drawPackets) {
+            if (packet.culled)
+                continue;
+            draws += modelDb[packet.model].getPrimitiveCount();
+            triangles += modelDb[packet.model].getTriangleCount();
+        }
+        perfOverlay->addDraws(draws, triangles);
+    }
+
+    void UpdateOverdrawCounter(int viewIndex) {
+        auto fragments = fragmentStats[viewIndex].getOldest(device);
+        if (!fragments.has_value())
+            return;
+
+        const auto& extent = renderTargets[viewIndex].getExtent();
+        overdrawCounter.fragments += fragments.value();
+        overdrawCounter.pixels += double(extent.width) * extent.height;
+        overdrawCounter.draws += drawPackets.size();
+        overdrawCounter.frames++;
+
+        if (overdrawCounter.frames >= 300) {
+            std::cout << fmt::format("Overdraw: {:.2f} fragments/pixel, {:.1f} draws/view (sort: {}, prepass: {})",
+                overdrawCounter.fragments / overdrawCounter.pixels, double(overdrawCounter.draws) / overdrawCounter.frames,
+                drawSort ? "on" : "off", depthPrepass ? "on" : "off") << std::endl;
+            overdrawCounter = {};
+        }
+    }
 
 public:
     VulkanManager(xr::Instance instance, xr::SystemId systemId) {
+        vkDebug = get_setting_int("vk_debug", 0) != 0;
+        dynamicRendering = get_setting_int("dynamic_rendering", 0) != 0;
         CreateInstance(instance, systemId);
         ChoosePhysicalDevice(instance, systemId);
         PrepareQueue();
@@ -240,8 +695,51 @@ public:
         return *it;
     }
 
-    void InitializeRenderTargets(const std::vector<Swapchain>& swapchains, int64_t format) override {
-        renderproc.emplace(device, vk::Format(format));
+    vk::SampleCountFlagBits chooseSampleCount(uint32_t requested) const {
+        auto limits = physicalDevice.getProperties().limits;
+        auto supported = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+
+        for (uint32_t count = 64; count > 1; count /= 2) {
+            auto bit = vk::SampleCountFlagBits(count);
+            if (count <= requested && (supported & bit))
+                return bit;
+        }
+        return vk::SampleCountFlagBits::e1;
+    }
+
+    void InitializeRenderTargets(const std::vector<Swapchain>& swapchains, int64_t format, uint32_t sampleCount) override {
+        auto samples = chooseSampleCount(sampleCount);
+        std::cout << fmt::format("MSAA: requested x{}, using x{}", sampleCount, uint32_t(samples)) << std::endl;
+
+        bool vertexPulling = get_setting_int("vertex_pulling", 0) != 0;
+        bool gpuParticles = get_setting_int("gpu_particles", 0) != 0;
+        hudCache = get_setting_int("hud_cache", 0) != 0;
+        bool poseSubmission = get_setting_int("pose_submission", 0) != 0;
+        if (poseSubmission && vertexPulling) {
+            std::cout << "Pose submission is not available with vertex pulling" << std::endl;
+            poseSubmission = false;
+        }
+        // the text shaders and glyph atlas are only loaded with text on
+        bool text = get_setting_int("text", 1) != 0;
+        renderproc.emplace(device, vk::Format(format), samples, vertexPulling, gpuParticles, hudCache, poseSubmission, dynamicRendering, text);
+        std::cout << fmt::format("Eye passes: {}", dynamicRendering ? "dynamic rendering" : "render pass") << std::endl;
+        if (vertexPulling)
+            geometryPool.emplace();
+        if (poseSubmission)
+            poseBuffer.emplace(device, allocator.value());
+
+        drawSort = get_setting_int("draw_sort", 1) != 0;
+        depthPrepass = get_setting_int("depth_prepass", 0) != 0;
+        overdrawStats = get_setting_int("overdraw_stats", 0) != 0 && pipelineStatisticsSupported;
+        if (get_setting_int("occlusion_culling", 0) != 0)
+            occlusionCuller.emplace();
+        if (overdrawStats) {
+            for (size_t i = 0; i < swapchains.size(); i++)
+                fragmentStats.emplace_back(device, 8);
+        }
+        auto limits = physicalDevice.getProperties().limits;
+        if (limits.timestampComputeAndGraphics && text)
+            perfOverlay.emplace(device, uint32_t(swapchains.size()), limits.timestampPeriod);
 
         for (const auto& swapchain : swapchains) {
             auto images = swapchain.handle->enumerateSwapchainImagesToVector<xr::SwapchainImageVulkanKHR>();
@@ -253,12 +751,113 @@ public:
 
             renderTargets.emplace_back(this->device, vkImages,
                 vk::Extent2D{ static_cast<uint32_t>(extent.width), static_cast<uint32_t>(extent.height) }, allocator.value(), renderproc.value());
+            if (debug.isEnabled())
+                renderTargets.back().setDebugNames(debug, renderTargets.size() == 1 ? "Left eye" : "Right eye");
         }
     }
 
     void PrepareResources() override {
         provider.emplace(this);
+        if (renderproc->hasText())
+            textRenderer.emplace(device, allocator.value(), cmdBufs.value(), queue, renderproc->getDescriptorSetLayout());
         Game::init(provider.value());
+        std::cout << fmt::format("Models: {}, samplers: {}, material descriptor pools: {}",
+            modelDb.size(), ModelData::getSamplerCount(), ModelData::getDescriptorPoolCount()) << std::endl;
+
+        if (geometryPool)
+            geometryPool->upload(device, allocator.value(), cmdBufs.value(), queue, renderproc->getGeometrySetLayout());
+    }
+
+    std::vector<xr::Extent2Di> getPanelExtents() const override {
+        std::vector<xr::Extent2Di> extents;
+        for (const auto& panel : panels)
+            extents.push_back(xr::Extent2Di{ int32_t(panel.extent.width), int32_t(panel.extent.height) });
+        return extents;
+    }
+
+    void InitializePanelLayers(const std::vector<Swapchain>& swapchains, int64_t format) override {
+        for (size_t i = 0; i < swapchains.size(); i++) {
+            auto images = swapchains[i].handle->enumerateSwapchainImagesToVector<xr::SwapchainImageVulkanKHR>();
+
+            std::vector<vk::Image> vkImages;
+            std::transform(images.begin(), images.end(), std::back_inserter(vkImages),
+                [](xr::SwapchainImageVulkanKHR image) { return vk::Image(image.image); });
+
+            auto& panel = panels[i];
+            panel.layer.emplace(device, allocator.value(), renderproc.value(), panel.extent, panel.size, vk::Format(format), vkImages);
+            panel.target.reset();
+            panel.dirty = true;
+        }
+    }
+
+    PanelLayerState getPanelLayerState(int panelIndex) const override {
+        const auto& panel = panels[panelIndex];
+
+        PanelLayerState state;
+        state.visible = panel.layerVisible;
+        state.dirty = panel.dirty;
+        state.pose = xr::Posef(toXr(panel.layerRot), toXr(panel.layerPos));
+        state.size = xr::Extent2Df(panel.size.x, panel.size.y);
+        return state;
+    }
+
+    void renderPanelLayer(int panelIndex, int imageIndex) override {
+        auto& panel = panels[panelIndex];
+        cmdBufs->exec(device, queue, [&](const vk::CommandBuffer& cmdBuf) {
+            if (textRenderer)
+                textRenderer->begin();
+            if (poseBuffer) {
+                poseBuffer->begin();
+                poseBuffer->bind(cmdBuf);
+            }
+            debug.beginLabel(cmdBuf, "Panel layer");
+            panel.layer->begin(cmdBuf, imageIndex);
+            if (geometryPool)
+                geometryPool->bind(cmdBuf, renderproc->getPipelineLayout());
+            for (const auto& item : panel.items)
+                modelDb[item.model].DrawModel(cmdBuf, renderproc->getPipelineLayout(), panel.layer->getProjection() * item.mat);
+            if (!panel.texts.empty()) {
+                panel.layer->bindPipeline(cmdBuf, PipelineVariant::Text);
+                SubmitTexts(cmdBuf, panel.texts, panel.layer->getProjection());
+            }
+            panel.layer->end(cmdBuf);
+            debug.endLabel(cmdBuf);
+            if (textRenderer)
+                textRenderer->end();
+            if (poseBuffer)
+                poseBuffer->end();
+        });
+        panel.dirty = false;
+        hudCounter.renders++;
+    }
+
+    void update(double dt) override {
+        if (!particleSystem)
+            return;
+        cmdBufs->exec(device, queue, [&](const vk::CommandBuffer& cmdBuf) {
+            debug.beginLabel(cmdBuf, "Particle update");
+            particleSystem->update(cmdBuf, dt);
+            debug.endLabel(cmdBuf);
+        });
+    }
+
+    void setPerfOverlay(bool visible) override {
+        if (!perfOverlay) {
+            std::cout << "Performance overlay: needs timestamps and text" << std::endl;
+            return;
+        }
+        if (visible && !perfOverlayVisible)
+            perfOverlay->show();
+        perfOverlayVisible = visible;
+    }
+
+    void setRenderSnapshot(const RenderSnapshot* snapshot) override {
+        renderSnapshot = snapshot;
+    }
+
+    void reportSimTime(double simMs, double displayPeriodMs) override {
+        if (perfOverlayVisible)
+            perfOverlay->reportSimTime(simMs, displayPeriodMs);
     }
 
     void render(int viewIndex, int imageIndex, const xr::CompositionLayerProjectionView& view) override {
@@ -266,18 +865,126 @@ public:
         XrMatrix4x4f_CreateProjectionFov(&proj, GRAPHICS_VULKAN, view.fov, 0.05f, 100.0f);
 
         auto matView = glm::inverse(CreateTranslationRotationScale(view.pose, glm::vec3{ 1,1,1 }));
+        currentView = matView;
         currentVp = toG(proj) * matView;
 
+        const bool overlay = perfOverlayVisible;
+        if (overlay && viewIndex == 0)
+            perfOverlay->beginFrame(CreateTranslationRotationScale(view.pose, glm::vec3{ 1,1,1 }));
+        auto recordStart = std::chrono::steady_clock::now();
+
         cmdBufs->exec(device, queue, [&](const vk::CommandBuffer& cmdBuf) {
             auto& renderTarget = this->renderTargets[viewIndex];
-            activeCmdBuf = cmdBuf;
+            debug.beginLabel(cmdBuf, viewIndex == 0 ? "Left eye" : "Right eye");
+            if (overlay)
+                perfOverlay->beginView(cmdBuf, viewIndex);
+            if (textRenderer)
+                textRenderer->begin();
+            if (poseBuffer) {
+                poseBuffer->begin();
+                poseBuffer->bind(cmdBuf);
+            }
+
+            drawPackets.clear();
+            provider->drawList.clear();
+            textDraws.clear();
+            panelDraws.clear();
+            for (auto& panel : panels)
+                panel.layerVisible = false;
+            particlesRequested = false;
+            if (renderSnapshot)
+                renderSnapshot->replay(provider.value());
+            else
+                Game::draw(provider.value());
+            CollectDraws();
+
+            if (occlusionCuller)
+                BeginOcclusionCulling();
+
+            // front to back, so that hidden fragments are rejected by the early depth test
+            if (drawSort) {
+                std::sort(drawPackets.begin(), drawPackets.end(), [](const DrawPacket& a, const DrawPacket& b) {
+                    return a.viewDepth < b.viewDepth;
+                });
+            }
+
+            // The occlusion test runs on its worker until the first draw that depends on it: the panels, the render pass
+            // and the occluders, which are never culled, are recorded in the meantime.
+            bool occlusionPending = occlusionCuller.has_value();
+            auto submitModels = [&] {
+                if (!occlusionPending) {
+                    SubmitDrawPackets(cmdBuf);
+                    return;
+                }
+                SubmitDrawPackets(cmdBuf, PacketSet::Occluders);
+                FinishOcclusionCulling();
+                occlusionPending = false;
+                SubmitDrawPackets(cmdBuf, PacketSet::Others);
+            };
+
+            debug.beginLabel(cmdBuf, "Panels");
+            RenderPanels(cmdBuf);
+            debug.endLabel(cmdBuf);
+
+            if (overdrawStats)
+                fragmentStats[viewIndex].reset(cmdBuf);
 
             renderTarget.beginRenderPass(cmdBuf, imageIndex);
+            if (overdrawStats)
+                fragmentStats[viewIndex].begin(cmdBuf);
+
+            if (depthPrepass) {
+                debug.beginLabel(cmdBuf, "Depth prepass");
+                renderTarget.bindPipeline(cmdBuf, PipelineVariant::DepthOnly);
+                submitModels();
+                renderTarget.bindPipeline(cmdBuf, PipelineVariant::AfterPrepass);
+                debug.endLabel(cmdBuf);
+            }
+            debug.beginLabel(cmdBuf, "Models");
+            submitModels();
+            debug.endLabel(cmdBuf);
+            if (overlay)
+                CountOverlayDraws();
+
+            if (!panelDraws.empty()) {
+                SubmitPanels(cmdBuf, renderTarget);
+                UpdateHudCounter();
+            }
+
+            if (particlesRequested && particleSystem) {
+                renderTarget.bindPipeline(cmdBuf, PipelineVariant::Particles);
+                particleSystem->draw(cmdBuf, renderproc->getParticlePipelineLayout(), currentVp);
+            }
+
+            if (!textDraws.empty()) {
+                renderTarget.bindPipeline(cmdBuf, PipelineVariant::Text);
+                SubmitTexts(cmdBuf, textDraws, currentVp);
+            }
 
-            Game::draw(provider.value());
+            if (overlay) {
+                renderTarget.bindPipeline(cmdBuf, PipelineVariant::Text);
+                perfOverlay->draw(cmdBuf, textRenderer.value(), renderproc->getPipelineLayout(), currentVp);
+            }
 
+            if (overdrawStats)
+                fragmentStats[viewIndex].end(cmdBuf);
             renderTarget.endRenderPass(cmdBuf);
+            if (overlay)
+                perfOverlay->endView(cmdBuf, viewIndex);
+            debug.endLabel(cmdBuf);
+            if (textRenderer)
+                textRenderer->end();
+            if (poseBuffer)
+                poseBuffer->end();
         });
+
+        if (overlay) {
+            // includes the submission and the wait for the command buffer slot
+            perfOverlay->addRecordTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count());
+            perfOverlay->collectGpuTime(device, viewIndex);
+        }
+        if (overdrawStats)
+            UpdateOverdrawCounter(viewIndex);
     }
 };
 
@@ -1,12 +1,101 @@
 #pragma once
 
 #include <filesystem>
+#include <string_view>
 #include <glm/glm.hpp>
 
+#include "TransformBatch.hpp"
+
 using ModelHandle = int;
+using PanelHandle = int;
+
+struct ParticleBurst {
+	glm::vec3 pos;
+	glm::vec3 axisX, axisY;	// particles fly out in random directions on this plane
+	float speed;
+	float lifetime;
+	float size;
+	uint32_t count;
+};
+
+// Model draws of one Game::draw() call. Recording is inline and non-virtual as it is the hot path;
+// the backend consumes the list afterwards. Draw i has transform i.
+class DrawList {
+public:
+	static constexpr PanelHandle world = -1;
+	struct Draw {
+		ModelHandle model;
+		PanelHandle target;		// world or the panel being recorded
+		uint32_t mat;			// 1 + index of the extra matrix, 0 if there is none
+	};
+
+	void clear() {
+		draws.clear();
+		mats.clear();
+		transforms.clear();
+	}
+	void setTarget(PanelHandle panel) {
+		target = panel;
+	}
+	void add(ModelHandle model, const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale) {
+		transforms.push(pos, rot, scale);
+		draws.push_back({ model, target, 0 });
+	}
+	void add(ModelHandle model, const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale, const glm::mat4& mat) {
+		mats.push_back(mat);
+		transforms.push(pos, rot, scale);
+		draws.push_back({ model, target, uint32_t(mats.size()) });
+	}
+
+	const std::vector<Draw>& getDraws() const {
+		return draws;
+	}
+	const TransformBatch& getTransforms() const {
+		return transforms;
+	}
+	const glm::mat4& getMat(const Draw& draw) const {
+		return mats[draw.mat - 1];
+	}
+
+private:
+	std::vector<Draw> draws;
+	std::vector<glm::mat4> mats;
+	TransformBatch transforms;
+	PanelHandle target = world;
+};
 
 class IGraphicsProvider {
 public:
 	virtual ModelHandle LoadModel(const char* path) = 0;
-	virtual void DrawModel(ModelHandle model, const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale, const glm::mat4& mat = glm::identity<glm::mat4>()) = 0;
+
+	// Recorded into drawList without a virtual call; mat is applied before the translation / rotation / scale.
+	void DrawModel(ModelHandle model, const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale) {
+		drawList.add(model, pos, rot, scale);
+	}
+	void DrawModel(ModelHandle model, const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale, const glm::mat4& mat) {
+		drawList.add(model, pos, rot, scale, mat);
+	}
+
+	// One line of text from the built-in glyph atlas (digits, A-Z, + - : . ! /), centered on pos and read from +z of rot.
+	// height is the cap height. Inside BeginPanel() / EndPanel() it is given in panel space like models.
+	virtual void DrawString(std::string_view text, const glm::vec3& pos, const glm::quat& rot, float height, const glm::vec3& color) = 0;
+
+	// GPU simulated particles. Returns false if not available; the game then has to simulate them by itself.
+	virtual bool InitParticles(const char* modelPath, uint32_t capacity) = 0;
+	virtual void EmitParticles(const ParticleBurst& burst) = 0;
+	virtual void DrawParticles() = 0;
+
+	// Large models that are likely to hide others; they are rasterized by the occlusion culler.
+	virtual void SetOccluder(ModelHandle model, bool occluder) = 0;
+
+	// Flat content such as the HUD. Models drawn between BeginPanel() and EndPanel() are given in panel space
+	// (meters, x right, y up, centered on the panel, viewed from +z) and may be cached in a texture of width x height.
+	// BeginPanel() returns false if contentKey is unchanged; the previous content is kept and EndPanel() must not be called.
+	virtual PanelHandle CreatePanel(uint32_t width, uint32_t height, const glm::vec2& size) = 0;
+	virtual bool BeginPanel(PanelHandle panel, uint64_t contentKey) = 0;
+	virtual void EndPanel() = 0;
+	virtual void DrawPanel(PanelHandle panel, const glm::vec3& pos, const glm::quat& rot) = 0;
+
+	// filled by DrawModel(), consumed and cleared by the backend
+	DrawList drawList;
 };
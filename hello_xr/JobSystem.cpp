@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <fmt/format.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "JobSystem.hpp"
+#include "TargetStore.hpp"
+#include "TransformBatch.hpp"
+#include "utils.hpp"
+
+namespace {
+    // the system and deque of the calling thread, when it is a worker
+    thread_local const JobSystem* currentSystem = nullptr;
+    thread_local uint32_t currentDeque = 0;
+
+    // a worker yields this many times before it sleeps, since fanning out happens a few times per step
+    constexpr int spinCount = 64;
+}
+
+JobSystem::JobSystem(uint32_t workerCount) {
+    for (uint32_t i = 0; i <= workerCount; i++)
+        deques.push_back(std::make_unique<Deque>());
+    for (uint32_t i = 1; i <= workerCount; i++)
+        workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+JobSystem& JobSystem::shared() {
+    static JobSystem system(uint32_t(std::max(get_setting_int("job_workers", int(std::thread::hardware_concurrency()) - 1), 0)));
+    return system;
+}
+
+uint32_t JobSystem::ownDeque() const {
+    return currentSystem == this ? currentDeque : 0;
+}
+
+void JobSystem::run(JobFunc func, const void* data, uint32_t begin, uint32_t end, Counter& counter) {
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    const Job job{ func, data, begin, end, &counter };
+    auto& deque = *deques[ownDeque()];
+    bool pushed;
+    {
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        pushed = deque.back - deque.front < Deque::capacity;
+        if (pushed)
+            deque.jobs[deque.back++ % Deque::capacity] = job;
+    }
+    if (!pushed) {
+        // full: run it in place rather than allocating
+        execute(job);
+        return;
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    if (!workers.empty()) {
+        // taking the lock orders this against a worker that is about to sleep
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+bool JobSystem::pop(uint32_t index, Job& job) {
+    auto& deque = *deques[index];
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    if (deque.front == deque.back)
+        return false;
+    job = deque.jobs[--deque.back % Deque::capacity];
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool JobSystem::steal(uint32_t thief, Job& job) {
+    const uint32_t n = uint32_t(deques.size());
+    for (uint32_t k = 1; k < n; k++) {
+        auto& deque = *deques[(thief + k) % n];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        if (deque.front == deque.back)
+            continue;
+        job = deque.jobs[deque.front++ % Deque::capacity];
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::execute(const Job& job) {
+    job.func(job.data, job.begin, job.end);
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::wait(Counter& counter) {
+    const uint32_t index = ownDeque();
+    while (counter.pending.load(std::memory_order_acquire) != 0) {
+        Job job;
+        if (take(index, job))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+    currentSystem = this;
+    currentDeque = index;
+    int idle = 0;
+    while (true) {
+        Job job;
+        if (take(index, job)) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < spinCount) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping)
+            return;
+        idle = 0;
+    }
+}
+
+void benchmarkJobSystem() {
+    constexpr uint32_t count = 100000;
+    constexpr int steps = 200;
+    constexpr float dt = 1.0f / 120;
+
+    auto vp = glm::perspective(1.5f, 1.0f, 0.05f, 100.0f) * glm::lookAt(glm::vec3(0, 1.6f, 0), glm::vec3(0, 1.6f, -1), glm::vec3(0, 1, 0));
+    const glm::vec3 origins[2] = { glm::vec3(-0.2f, 1.2f, -0.3f), glm::vec3(0.2f, 1.2f, -0.3f) };
+    const glm::vec3 dirs[2] = { glm::normalize(glm::vec3(-0.1f, 0.05f, -1.0f)), glm::normalize(glm::vec3(0.1f, 0.0f, -1.0f)) };
+
+    // the same targets and draws for every thread count
+    auto fill = [&](TargetStore& store, TransformBatch& batch) {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> time(0.0f, float(TargetStore::lifetime));
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 tgtPos = glm::vec3(dist(rng) * 8.0f, dist(rng) * 2.0f + 1.5f, -5.0f - dist(rng) * 3.0f);
+            auto endOri = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+            auto tgtOri = glm::normalize(endOri * glm::angleAxis(3.14159265f, glm::vec3(0, 1, 0)));
+            store.spawn(tgtPos - glm::vec3(0, 10, 0), tgtPos, tgtOri, endOri, time(rng));
+            batch.push(tgtPos, tgtOri, glm::vec3(0.2f, 0.2f, 0.01f));
+        }
+    };
+
+    const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    double baseMs = 0.0;
+    uint64_t baseHash = 0;
+    for (uint32_t threads = 1; threads <= maxThreads; threads++) {
+        JobSystem jobs(threads - 1);
+        TargetStore store(count);
+        TransformBatch batch;
+        fill(store, batch);
+        std::vector<glm::mat4> mvps(batch.size());
+
+        // FNV-1a over the ray results and the last poses and matrices
+        uint64_t hash = 14695981039346656037ull;
+        auto add = [&](const void* data, size_t size) {
+            for (size_t i = 0; i < size; i++)
+                hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 1099511628211ull;
+        };
+
+        double procMs = 0.0, rayMs = 0.0, mvpMs = 0.0;
+        auto time = [](double& ms, auto&& func) {
+            auto start = std::chrono::steady_clock::now();
+            func();
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        };
+        for (int step = 0; step < steps; step++) {
+            time(procMs, [&] { store.proc(dt, &jobs); });
+            TargetStore::RayResult results[2];
+            time(rayMs, [&] { store.rayCast(origins, dirs, 2, results, &jobs); });
+            time(mvpMs, [&] { batch.computeMvps(vp, mvps.data(), &jobs); });
+            for (const auto& result : results) {
+                uint32_t nearest = result.nearest ? result.nearest->target.slot : ~0u, lockedOn = result.lockedOn ? result.lockedOn->target.slot : ~0u;
+                add(&nearest, sizeof(nearest));
+                add(&lockedOn, sizeof(lockedOn));
+            }
+        }
+        store.forEach([&](TargetStore::Target target) {
+            auto p = store.getPosition(target);
+            auto q = store.getRotation(target);
+            add(&p, sizeof(p));
+            add(&q, sizeof(q));
+        });
+        add(mvps.data(), mvps.size() * sizeof(glm::mat4));
+
+        const double totalMs = (procMs + rayMs + mvpMs) / steps;
+        if (threads == 1) {
+            baseMs = totalMs;
+            baseHash = hash;
+        }
+        std::cout << fmt::format("Jobs: {} threads, {:.3f} ms/step (proc {:.3f}, rays {:.3f}, mvps {:.3f}), {:.2f}x, {}",
+            threads, totalMs, procMs / steps, rayMs / steps, mvpMs / steps, baseMs / totalMs,
+            hash == baseHash ? "same results" : "RESULTS DIFFER") << std::endl;
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of worker threads that run jobs from a deque of their own, and steal from the other deques when
+// theirs is empty. The thread that waits for a counter runs jobs too, so a job may fan out and wait in turn.
+// A job is a function pointer, its data and a range: queueing one never allocates.
+// parallelFor() splits a range by a fixed grain, never by the number of threads, so as long as each part
+// only writes its own outputs the results are the same with any number of workers, including none.
+class JobSystem {
+public:
+    using JobFunc = void (*)(const void* data, uint32_t begin, uint32_t end);
+
+    // jobs left to finish. run() counts it up and the end of each job counts it down,
+    // so wait() on it is the dependency of whatever needs those jobs done.
+    struct Counter {
+        std::atomic<uint32_t> pending{ 0 };
+    };
+
+    // workerCount threads besides the ones calling wait(). With none, jobs run in wait().
+    explicit JobSystem(uint32_t workerCount);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // one per process, with debug.hello_xr.job_workers workers, by default one less than the cores
+    static JobSystem& shared();
+
+    // func(data, begin, end) on some thread. data has to stay valid until counter drops to zero.
+    void run(JobFunc func, const void* data, uint32_t begin, uint32_t end, Counter& counter);
+    // func() on some thread; func has to stay alive until counter drops to zero
+    template<typename F>
+    void run(const F& func, Counter& counter) {
+        run([](const void* data, uint32_t, uint32_t) { (*static_cast<const F*>(data))(); }, &func, 0, 0, counter);
+    }
+    // runs queued jobs until counter drops to zero
+    void wait(Counter& counter);
+
+    // func(begin, end) over [0, count) in parts of grain, returns when all are done. One part runs in place.
+    template<typename F>
+    void parallelFor(uint32_t count, uint32_t grain, const F& func) {
+        if (count <= grain) {
+            if (count > 0)
+                func(0u, count);
+            return;
+        }
+        Counter counter;
+        auto part = [](const void* data, uint32_t begin, uint32_t end) { (*static_cast<const F*>(data))(begin, end); };
+        for (uint32_t begin = grain; begin < count; begin += grain)
+            run(part, &func, begin, std::min(begin + grain, count), counter);
+        func(0u, grain);
+        wait(counter);
+    }
+
+    uint32_t workerCount() const { return uint32_t(workers.size()); }
+
+private:
+    struct Job {
+        JobFunc func;
+        const void* data;
+        uint32_t begin, end;
+        Counter* counter;
+    };
+    // the owner pushes and pops at the back, thieves take from the front, the oldest and usually largest jobs
+    struct Deque {
+        static constexpr uint32_t capacity = 1024;
+        std::mutex mutex;
+        Job jobs[capacity];
+        uint32_t front = 0, back = 0;   // front <= back, both wrap around capacity
+    };
+
+    void workerLoop(uint32_t index);
+    // the deque of the calling thread, shared by every thread that is not a worker
+    uint32_t ownDeque() const;
+    bool pop(uint32_t index, Job& job);
+    bool steal(uint32_t thief, Job& job);
+    bool take(uint32_t index, Job& job) { return pop(index, job) || steal(index, job); }
+    static void execute(const Job& job);
+
+    std::vector<std::unique_ptr<Deque>> deques;     // deques[0] for the other threads, then one per worker
+    std::vector<std::thread> workers;
+    std::atomic<uint32_t> queued{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+// Times the target animation, the ray scan and the draw matrices over 100k targets / draws with 1 to
+// as many threads as there are cores, and logs the time per step, the speedup and whether every thread
+// count computed the same results.
+void benchmarkJobSystem();
+
+#endif
@@ -0,0 +1,77 @@
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <fmt/format.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "NullGraphicsProvider.hpp"
+
+namespace {
+    // what DrawModel() used to be: a virtual call that checks the recording state and builds the MVP per call
+    class VirtualTarget {
+    public:
+        virtual ~VirtualTarget() = default;
+        virtual void DrawModel(ModelHandle model, const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale) = 0;
+    };
+
+    class MatrixTarget final : public VirtualTarget {
+    public:
+        glm::mat4 vp;
+        std::optional<int> recording = 0;
+        std::vector<glm::mat4> mvps;
+
+        void DrawModel(ModelHandle model, const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale) override {
+            if (!recording)
+                return;
+            mvps.push_back(vp * glm::translate(glm::identity<glm::mat4>(), pos) * glm::mat4(rot) * glm::scale(glm::identity<glm::mat4>(), scale));
+        }
+    };
+}
+
+void benchmarkDrawSubmission() {
+    constexpr size_t count = 1024;
+    constexpr int frames = 200;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<glm::vec3> positions(count), scales(count);
+    std::vector<glm::quat> rotations(count);
+    for (size_t i = 0; i < count; i++) {
+        positions[i] = glm::vec3(dist(rng), dist(rng), dist(rng)) * 10.0f;
+        rotations[i] = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+        scales[i] = glm::vec3(dist(rng), dist(rng), dist(rng)) + 1.5f;
+    }
+    auto vp = glm::perspective(1.5f, 1.0f, 0.05f, 100.0f) * glm::lookAt(glm::vec3(0, 1.6f, 0), glm::vec3(0, 1.6f, -1), glm::vec3(0, 1, 0));
+
+    auto time = [&](auto&& frame) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++)
+            frame();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (frames * count);
+    };
+
+    MatrixTarget matrixTarget;
+    matrixTarget.vp = vp;
+    // volatile, so that the compiler cannot see the dynamic type and devirtualize the calls
+    VirtualTarget* volatile virtualTarget = &matrixTarget;
+    double virtualNs = time([&] {
+        matrixTarget.mvps.clear();
+        for (size_t i = 0; i < count; i++)
+            virtualTarget->DrawModel(0, positions[i], rotations[i], scales[i]);
+    });
+
+    NullGraphicsProvider provider;
+    IGraphicsProvider& g = provider;
+    std::vector<glm::mat4> mvps(count);
+    double recordNs = time([&] {
+        g.drawList.clear();
+        for (size_t i = 0; i < count; i++)
+            g.DrawModel(0, positions[i], rotations[i], scales[i]);
+    });
+    double batchNs = time([&] { g.drawList.getTransforms().computeMvps(vp, mvps.data()); });
+
+    std::cout << fmt::format("Draw submission: virtual + per-call MVP {:.1f} ns/draw, inline record {:.1f} + batched MVP {:.1f} ns/draw",
+        virtualNs, recordNs, batchNs) << std::endl;
+}
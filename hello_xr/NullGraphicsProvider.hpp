@@ -0,0 +1,43 @@
+#ifndef NULL_GRAPHICS_PROVIDER_HPP
+#define NULL_GRAPHICS_PROVIDER_HPP
+
+#include "GraphicsProvider.hpp"
+
+// Graphics backend that draws nothing, for running the game logic without a GPU (tests, benchmarks).
+// Model draws are recorded into drawList like with every backend; the owner clears it between frames.
+class NullGraphicsProvider final : public IGraphicsProvider {
+    ModelHandle modelCount = 0;
+    PanelHandle panelCount = 0;
+
+public:
+    ModelHandle LoadModel(const char* path) override {
+        return modelCount++;
+    }
+    void DrawString(std::string_view text, const glm::vec3& pos, const glm::quat& rot, float height, const glm::vec3& color) override {}
+
+    bool InitParticles(const char* modelPath, uint32_t capacity) override {
+        return false;
+    }
+    void EmitParticles(const ParticleBurst& burst) override {}
+    void DrawParticles() override {}
+
+    void SetOccluder(ModelHandle model, bool occluder) override {}
+
+    PanelHandle CreatePanel(uint32_t width, uint32_t height, const glm::vec2& size) override {
+        return panelCount++;
+    }
+    bool BeginPanel(PanelHandle panel, uint64_t contentKey) override {
+        drawList.setTarget(panel);
+        return true;
+    }
+    void EndPanel() override {
+        drawList.setTarget(DrawList::world);
+    }
+    void DrawPanel(PanelHandle panel, const glm::vec3& pos, const glm::quat& rot) override {}
+};
+
+// Per-call cost of DrawModel(): a virtual call building the MVP right away (the former path)
+// against the inline record plus its share of the batched MVP pass. Logs both.
+void benchmarkDrawSubmission();
+
+#endif
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+#include "OcclusionCuller.hpp"
+#include "simd.hpp"
+
+namespace {
+    // vertices closer than this (clip space w) are not rasterized / never culled
+    constexpr float nearW = 1e-3f;
+}
+
+OcclusionCuller::OcclusionCuller() : depth(width * height, 1.0f) {
+    worker = std::thread([this] { workerMain(); });
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    {
+        std::lock_guard lock(mtx);
+        quit = true;
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+void OcclusionCuller::begin(std::vector<Occluder>& _occluders, std::vector<Occludee>& _occludees) {
+    std::unique_lock lock(mtx);
+    cv.wait(lock, [&] { return jobDone; });
+    occluders.swap(_occluders);
+    occludees.swap(_occludees);
+    hasJob = true;
+    jobDone = false;
+    lock.unlock();
+    cv.notify_all();
+}
+
+const std::vector<uint8_t>& OcclusionCuller::wait() {
+    std::unique_lock lock(mtx);
+    cv.wait(lock, [&] { return jobDone; });
+    return visible;
+}
+
+OcclusionCuller::Stats OcclusionCuller::takeStats() {
+    std::lock_guard lock(mtx);
+    auto ret = stats;
+    stats = {};
+    return ret;
+}
+
+void OcclusionCuller::workerMain() {
+    while (true) {
+        {
+            std::unique_lock lock(mtx);
+            cv.wait(lock, [&] { return hasJob || quit; });
+            if (quit)
+                return;
+            hasJob = false;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard lock(mtx);
+            stats.workerMs += elapsed;
+            stats.jobs++;
+            jobDone = true;
+        }
+        cv.notify_all();
+    }
+}
+
+void OcclusionCuller::run() {
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    for (const auto& occluder : occluders)
+        rasterize(occluder);
+
+    visible.resize(occludees.size());
+    for (size_t i = 0; i < occludees.size(); i++)
+        visible[i] = test(occludees[i]);
+}
+
+const std::vector<uint32_t>& OcclusionCuller::getNeighbors(uint32_t mesh, const std::vector<uint32_t>& indices) {
+    if (mesh >= neighborCache.size())
+        neighborCache.resize(mesh + 1);
+    auto& neighbors = neighborCache[mesh];
+    if (neighbors.size() == indices.size())
+        return neighbors;
+
+    // edge k of a triangle is the one opposite its vertex k
+    neighbors.assign(indices.size(), noNeighbor);
+    std::unordered_map<uint64_t, uint32_t> open;
+    for (uint32_t i = 0; i + 2 < indices.size(); i += 3) {
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t a = indices[i + (k + 1) % 3], b = indices[i + (k + 2) % 3];
+            auto key = uint64_t(std::min(a, b)) << 32 | std::max(a, b);
+            auto [it, inserted] = open.try_emplace(key, i + k);
+            if (inserted)
+                continue;
+            // edges of more than two triangles keep the first pair; the others count as outline
+            if (it->second != noNeighbor && neighbors[it->second] == noNeighbor) {
+                neighbors[it->second] = i / 3;
+                neighbors[i + k] = it->second / 3;
+            }
+        }
+    }
+    return neighbors;
+}
+
+void OcclusionCuller::rasterize(const Occluder& occluder) {
+    const auto& positions = *occluder.positions;
+    const auto& indices = *occluder.indices;
+    const auto& neighbors = getNeighbors(occluder.mesh, indices);
+    const uint32_t triangleCount = uint32_t(indices.size() / 3);
+
+    clip.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); i++)
+        clip[i] = occluder.mvp * glm::vec4(positions[i], 1.0f);
+    screen.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        const auto& c = clip[i];
+        screen[i] = glm::vec3((c.x / c.w * 0.5f + 0.5f) * width, (c.y / c.w * 0.5f + 0.5f) * height, c.z / c.w);
+    }
+
+    // per triangle, the depth change over one pixel step in x plus one in y; negative for triangles that are not drawn
+    slope.assign(triangleCount, -1.0f);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const uint32_t* tri = &indices[t * 3];
+        // triangles crossing the near plane are skipped; dropping an occluder is always safe
+        if (clip[tri[0]].w < nearW || clip[tri[1]].w < nearW || clip[tri[2]].w < nearW)
+            continue;
+        const auto &v0 = screen[tri[0]], &v1 = screen[tri[1]], &v2 = screen[tri[2]];
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (std::abs(area) < 1e-6f)
+            continue;
+        float dzdx = ((v1.y - v2.y) * v0.z + (v2.y - v0.y) * v1.z + (v0.y - v1.y) * v2.z) / area;
+        float dzdy = ((v2.x - v1.x) * v0.z + (v0.x - v2.x) * v1.z + (v1.x - v0.x) * v2.z) / area;
+        slope[t] = std::abs(dzdx) + std::abs(dzdy);
+    }
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (slope[t] < 0.0f)
+            continue;
+        const uint32_t* tri = &indices[t * 3];
+        // An edge is inner where the drawn neighbor across it lies on its other side on screen: the pixels on it are then
+        // covered by the two triangles together, so both test them at their center. Every other edge is part of the outline.
+        bool inner[3];
+        float neighborSlope = 0.0f;
+        for (uint32_t k = 0; k < 3; k++) {
+            inner[k] = false;
+            uint32_t n = neighbors[t * 3 + k];
+            if (n == noNeighbor || slope[n] < 0.0f)
+                continue;
+            const auto& a = screen[tri[(k + 1) % 3]];
+            const auto& b = screen[tri[(k + 2) % 3]];
+            const uint32_t* ntri = &indices[n * 3];
+            const auto& own = screen[tri[k]];
+            const auto& other = screen[ntri[0] + ntri[1] + ntri[2] - tri[(k + 1) % 3] - tri[(k + 2) % 3]];
+            auto side = [&](const glm::vec3& p) { return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x); };
+            inner[k] = side(own) * side(other) < 0.0f;
+            if (inner[k])
+                neighborSlope = std::max(neighborSlope, slope[n]);
+        }
+        // A pixel is written with the farthest depth any part of it can have: half a pixel along this triangle's slope
+        // from its center, and where it reaches over an inner edge, a whole pixel along the neighbor's slope.
+        rasterizeTriangle(screen[tri[0]], screen[tri[1]], screen[tri[2]], inner, 0.5f * slope[t] + neighborSlope);
+    }
+}
+
+void OcclusionCuller::rasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, const bool inner[3], float zSlack) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    bool inner1 = inner[1], inner2 = inner[2];
+    // both windings occlude
+    if (area < 0) {
+        std::swap(v1, v2);
+        std::swap(inner1, inner2);
+        area = -area;
+    }
+
+    int minX = std::max(0, int(std::floor(std::min({ v0.x, v1.x, v2.x }))));
+    int maxX = std::min(int(width) - 1, int(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
+    int minY = std::max(0, int(std::floor(std::min({ v0.y, v1.y, v2.y }))));
+    int maxY = std::min(int(height) - 1, int(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+    if (minX > maxX || minY > maxY)
+        return;
+    minX &= ~3;
+
+    // edge function of a -> b evaluated at p: (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x) = A * p.x + B * p.y + C
+    struct Edge {
+        float a, b, c;
+    };
+    auto edge = [](glm::vec3 a, glm::vec3 b) {
+        Edge e;
+        e.a = -(b.y - a.y);
+        e.b = b.x - a.x;
+        e.c = -(e.a * a.x + e.b * a.y);
+        return e;
+    };
+    // weight of each vertex is the edge opposite to it
+    const Edge e0 = edge(v1, v2), e1 = edge(v2, v0), e2 = edge(v0, v1);
+    const float invArea = 1.0f / area;
+
+    // a pixel is entirely inside an outline edge when its center is at least half its extent along the edge normal inside
+    auto inset = [](const Edge& e, bool inner) {
+        return simd::set1(inner ? 0.0f : 0.5f * (std::abs(e.a) + std::abs(e.b)));
+    };
+    const auto in0 = inset(e0, inner[0]), in1 = inset(e1, inner1), in2 = inset(e2, inner2);
+
+    const auto z0 = simd::set1(v0.z * invArea), z1 = simd::set1(v1.z * invArea), z2 = simd::set1(v2.z * invArea);
+    const auto slack = simd::set1(zSlack);
+    const auto laneOffset = simd::set(0.5f, 1.5f, 2.5f, 3.5f);
+
+    for (int y = minY; y <= maxY; y++) {
+        const float py = y + 0.5f;
+        float* row = depth.data() + y * width;
+
+        for (int x = minX; x <= maxX; x += 4) {
+            auto px = simd::set1(float(x)) + laneOffset;
+
+            auto w0 = simd::fmadd(simd::set1(e0.a), px, simd::set1(e0.b * py + e0.c));
+            auto w1 = simd::fmadd(simd::set1(e1.a), px, simd::set1(e1.b * py + e1.c));
+            auto w2 = simd::fmadd(simd::set1(e2.a), px, simd::set1(e2.b * py + e2.c));
+
+            auto inside = (w0 >= in0) & (w1 >= in1) & (w2 >= in2);
+            if (!simd::any(inside))
+                continue;
+
+            auto z = w0 * z0 + w1 * z1 + w2 * z2 + slack;
+            auto d = simd::load(row + x);
+            simd::store(row + x, simd::select(inside, simd::min(d, z), d));
+        }
+    }
+}
+
+bool OcclusionCuller::test(const Occludee& occludee) {
+    stats.tested++;
+
+    const auto& bmin = occludee.boundsMin;
+    const auto& bmax = occludee.boundsMax;
+    if (bmin.x > bmax.x)
+        return true;
+
+    float minX = std::numeric_limits<float>::max(), minY = minX, minZ = minX;
+    float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 corner((i & 1) ? bmax.x : bmin.x, (i & 2) ? bmax.y : bmin.y, (i & 4) ? bmax.z : bmin.z, 1.0f);
+        auto c = occludee.mvp * corner;
+        if (c.w < nearW)
+            return true;
+
+        float sx = (c.x / c.w * 0.5f + 0.5f) * width;
+        float sy = (c.y / c.w * 0.5f + 0.5f) * height;
+        minX = std::min(minX, sx);
+        maxX = std::max(maxX, sx);
+        minY = std::min(minY, sy);
+        maxY = std::max(maxY, sy);
+        minZ = std::min(minZ, c.z / c.w);
+    }
+
+    if (maxX < 0 || maxY < 0 || minX > width || minY > height || minZ > 1.0f) {
+        stats.outside++;
+        return false;
+    }
+
+    // every pixel the screen bounds touch
+    int x0 = std::max(0, int(std::floor(minX)));
+    int x1 = std::min(int(width) - 1, int(std::floor(maxX)));
+    int y0 = std::max(0, int(std::floor(minY)));
+    int y1 = std::min(int(height) - 1, int(std::floor(maxY)));
+
+    const auto nearest = simd::set1(minZ);
+    const auto lanes = simd::set(0.0f, 1.0f, 2.0f, 3.0f);
+    const auto first = simd::set1(float(x0)), last = simd::set1(float(x1));
+
+    for (int y = y0; y <= y1; y++) {
+        const float* row = depth.data() + y * width;
+        for (int x = x0 & ~3; x <= x1; x += 4) {
+            auto px = simd::set1(float(x)) + lanes;
+            auto inRect = (px >= first) & (px <= last);
+            // something of the box may be in front of the occluder here
+            if (simd::any(inRect & (simd::load(row + x) >= nearest)))
+                return true;
+        }
+    }
+
+    stats.occluded++;
+    return false;
+}
@@ -0,0 +1,84 @@
+#ifndef OCCLUSION_CULLER_HPP
+#define OCCLUSION_CULLER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Software occlusion culling.
+// A few occluder meshes are rasterized into a small depth buffer, then the bounding boxes
+// of all draws are tested against it. Both run on a worker thread; begin() kicks the job
+// and wait() returns the visibility of every occludee.
+// Both sides are conservative, so that the low resolution never culls something visible:
+// an occluder only covers the pixels inside its outline on screen, at the farthest depth it has in them,
+// and an occludee is tested against every pixel its screen bounds touch, at its nearest depth.
+class OcclusionCuller {
+public:
+    struct Occluder {
+        uint32_t mesh;      // the same for every occluder with these positions and indices, e.g. its model
+        const std::vector<glm::vec3>* positions;
+        const std::vector<uint32_t>* indices;
+        glm::mat4 mvp;
+    };
+    struct Occludee {
+        glm::vec3 boundsMin, boundsMax;
+        glm::mat4 mvp;
+    };
+    struct Stats {
+        uint64_t tested = 0;
+        uint64_t occluded = 0;
+        uint64_t outside = 0;
+        double workerMs = 0.0;
+        uint32_t jobs = 0;
+    };
+
+    static constexpr uint32_t width = 128;
+    static constexpr uint32_t height = 64;
+
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    // takes the contents of both; they come back with the lists of an earlier job, to be cleared and refilled,
+    // so that the lists are not reallocated every frame
+    void begin(std::vector<Occluder>& occluders, std::vector<Occludee>& occludees);
+    const std::vector<uint8_t>& wait();
+
+    // only valid after wait()
+    Stats takeStats();
+
+private:
+    std::vector<float> depth;
+    std::vector<Occluder> occluders;
+    std::vector<Occludee> occludees;
+    std::vector<uint8_t> visible;
+    Stats stats;
+
+    static constexpr uint32_t noNeighbor = ~0u;
+    // the rest is the worker's: the neighbors per mesh id, and the transformed vertices of the occluder being rasterized
+    std::vector<std::vector<uint32_t>> neighborCache;
+    std::vector<glm::vec4> clip;
+    std::vector<glm::vec3> screen;
+    std::vector<float> slope;
+
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool hasJob = false;
+    bool jobDone = true;
+    bool quit = false;
+
+    void workerMain();
+    void run();
+    // per index, the triangle across the edge opposite it, or noNeighbor. Built once per mesh.
+    const std::vector<uint32_t>& getNeighbors(uint32_t mesh, const std::vector<uint32_t>& indices);
+    void rasterize(const Occluder& occluder);
+    // inner: per edge, whether it is inside the outline of the mesh (edge k is the one opposite vertex k)
+    void rasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, const bool inner[3], float zSlack);
+    bool test(const Occludee& occludee);
+};
+
+#endif
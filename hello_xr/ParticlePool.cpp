@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <fmt/format.h>
+
+#include "ParticlePool.hpp"
+#include "simd.hpp"
+
+namespace {
+    // unit directions around the circle, so that a burst needs no sin / cos per particle
+    constexpr uint32_t directionBits = 8;
+    const auto directions = [] {
+        std::array<glm::vec2, 1 << directionBits> dirs;
+        for (uint32_t i = 0; i < dirs.size(); i++) {
+            float angle = float(i) / dirs.size() * 6.28318530718f;
+            dirs[i] = glm::vec2(std::cos(angle), std::sin(angle));
+        }
+        return dirs;
+    }();
+}
+
+ParticlePool::ParticlePool(uint32_t capacity) : entities(capacity) {
+    for (int c = 0; c < 3; c++) {
+        pos[c] = entities.column<Position>(c);
+        prevPos[c] = entities.column<PrevPosition>(c);
+        vel[c] = entities.column<Velocity>(c);
+    }
+    age = entities.column<Age>(0);
+    lifetime = entities.column<Lifetime>(0);
+    tag = entities.array<uint32_t>();
+    expired.resize(capacity);
+}
+
+bool ParticlePool::emit(const glm::vec3& p, const glm::vec3& v, float life, uint32_t t) {
+    return entities.create({ p.x, p.y, p.z }, { p.x, p.y, p.z }, { v.x, v.y, v.z }, { 0.0f }, { life }, t).has_value();
+}
+
+void ParticlePool::emit(const ParticleBurst& burst, Random& random, uint32_t t) {
+    for (uint32_t i = 0; i < burst.count; i++) {
+        const glm::vec2 dir = directions[random.next() >> (32 - directionBits)];
+        if (!emit(burst.pos, burst.speed * (burst.axisX * dir.x + burst.axisY * dir.y), burst.lifetime, t))
+            break;
+    }
+}
+
+void ParticlePool::proc(float dt) {
+    using namespace simd;
+
+    const auto step = set1(dt);
+    const uint32_t count = entities.size();
+    // the lanes past count hold stale particles, which are never swept
+    uint32_t firstExpired = count;
+    for (uint32_t i = 0; i < count; i += 4) {
+        for (int c = 0; c < 3; c++) {
+            auto p = load(&pos[c][i]);
+            store(&prevPos[c][i], p);
+            store(&pos[c][i], fmadd(load(&vel[c][i]), step, p));
+        }
+        auto a = load(&age[i]) + step;
+        store(&age[i], a);
+        if (firstExpired == count && bits(a > load(&lifetime[i])))
+            firstExpired = i;
+    }
+
+    // the expired ones from the first lane group where something expired, in order. The write index only
+    // advances past expired ones, so this loop does not branch on the lifetime.
+    uint32_t expiredCount = 0;
+    for (uint32_t i = firstExpired; i < count; i++) {
+        expired[expiredCount] = i;
+        expiredCount += age[i] > lifetime[i];
+    }
+    // the runs between them move down, one array at a time
+    entities.removeDense(expired.data(), expiredCount);
+}
+
+namespace {
+    // what the hit effects used to be
+    struct BoomEffect {
+        glm::vec3 pos, prevPos, vel;
+        double timer = 0;
+        bool alive = true;
+        BoomEffect(glm::vec3 pos, const glm::vec3& axisX, const glm::vec3& axisY) : pos(pos), prevPos(pos) {
+            float angle = float(rand() % 10000) / 5000 * 3.14159265f;
+            vel = 3.0f * (axisY * std::sin(angle) + axisX * std::cos(angle));
+        }
+        void proc(double dt) {
+            timer += dt;
+            prevPos = pos;
+            pos += float(dt) * vel;
+            if (timer > 0.2)
+                alive = false;
+        }
+    };
+}
+
+void benchmarkParticlePool() {
+    constexpr int frames = 20000;
+    constexpr float dt = 1.0f / 120;
+    // a burst on every 6th step, and ten at once on every 60th
+    auto burstsAt = [](int frame) { return frame % 60 == 0 ? 10 : frame % 6 == 0 ? 1 : 0; };
+    const ParticleBurst burst{ glm::vec3(0.0f, 1.2f, -3.0f), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), 3.0f, 0.2f, 0.04f, 10 };
+
+    auto time = [&](auto&& frame) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++)
+            frame(i);
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+    };
+
+    std::vector<BoomEffect> effects;
+    size_t vectorPeak = 0, vectorGrowths = 0;
+    double vectorUs = time([&](int frame) {
+        const size_t oldCapacity = effects.capacity();
+        for (int b = 0; b < burstsAt(frame); b++) {
+            for (uint32_t i = 0; i < burst.count; i++)
+                effects.emplace_back(burst.pos, burst.axisX, burst.axisY);
+        }
+        vectorGrowths += effects.capacity() != oldCapacity;
+        for (auto& effect : effects)
+            effect.proc(dt);
+        effects.erase(std::remove_if(effects.begin(), effects.end(), [](const auto& effect) { return !effect.alive; }), effects.end());
+        vectorPeak = std::max(vectorPeak, effects.size());
+    });
+
+    ParticlePool pool(512);
+    Random random(1);
+    uint32_t poolPeak = 0;
+    double poolUs = time([&](int frame) {
+        for (int b = 0; b < burstsAt(frame); b++)
+            pool.emit(burst, random);
+        pool.proc(dt);
+        poolPeak = std::max(poolPeak, pool.size());
+    });
+
+    std::cout << fmt::format("Hit effects: vector + remove_if {:.2f} us/step (peak {}, grew {} times), pool {:.2f} us/step (peak {}, capacity {})",
+        vectorUs, vectorPeak, vectorGrowths, poolUs, poolPeak, pool.capacity()) << std::endl;
+}
@@ -0,0 +1,73 @@
+#ifndef PARTICLE_POOL_HPP
+#define PARTICLE_POOL_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "EntityStore.hpp"
+#include "GraphicsProvider.hpp"
+#include "Random.hpp"
+
+// Particles simulated on the CPU, for the effects that the graphics provider does not simulate.
+// An archetype in an EntityStore allocated up front: emit() appends and proc() moves every particle along
+// its velocity four at a time, then sweeps out the expired ones, found without branching on their lifetime.
+// A full pool drops what is emitted, so no frame allocates however many effects there are.
+class ParticlePool {
+    struct PositionTag; struct PrevPositionTag; struct VelocityTag; struct AgeTag; struct LifetimeTag;
+    using Position = FloatColumns<PositionTag, 3>;
+    using PrevPosition = FloatColumns<PrevPositionTag, 3>;
+    using Velocity = FloatColumns<VelocityTag, 3>;
+    using Age = FloatColumns<AgeTag, 1>;
+    using Lifetime = FloatColumns<LifetimeTag, 1>;
+    // and the tag, whole
+    using Store = EntityStore<Position, PrevPosition, Velocity, Age, Lifetime, uint32_t>;
+
+public:
+    explicit ParticlePool(uint32_t capacity);
+    // the loops below reach the columns of the store through pointers taken once
+    ParticlePool(const ParticlePool&) = delete;
+    ParticlePool& operator=(const ParticlePool&) = delete;
+    // below this many particles, proc() is done before a worker would have woken up for it
+    static constexpr uint32_t jobMin = 2048;
+
+    // false when the pool is full. tag is handed back to forEach(), e.g. what to draw.
+    bool emit(const glm::vec3& pos, const glm::vec3& vel, float lifetime, uint32_t tag = 0);
+    // burst.count particles from burst.pos at burst.speed, in random directions on the plane of axisX / axisY,
+    // as many as fit. burst.size is left to the caller to draw with.
+    void emit(const ParticleBurst& burst, Random& random, uint32_t tag = 0);
+    void clear() { entities.clear(); }
+
+    // ages and moves every particle by dt, then frees the ones past their lifetime, keeping the others in order
+    void proc(float dt);
+
+    // func(position between the last two proc() by alpha, lifetime left, tag) for every particle, oldest first
+    template<typename F>
+    void forEach(float alpha, F&& func) const {
+        for (uint32_t i = 0; i < entities.size(); i++) {
+            glm::vec3 prev(prevPos[0][i], prevPos[1][i], prevPos[2][i]);
+            glm::vec3 cur(pos[0][i], pos[1][i], pos[2][i]);
+            func(glm::mix(prev, cur, alpha), lifetime[i] - age[i], tag[i]);
+        }
+    }
+    uint32_t size() const { return entities.size(); }
+    uint32_t capacity() const { return entities.capacity(); }
+
+private:
+    Store entities;
+    // the columns of entities, which never reallocates
+    float* pos[3];
+    float* prevPos[3];
+    float* vel[3];
+    float* age;
+    float* lifetime;
+    uint32_t* tag;
+    std::vector<uint32_t> expired;      // scratch of proc()
+};
+
+// Times emitting, moving and freeing hit effects as a vector of structs compacted with remove_if (the former path)
+// against the pool, per particle, while the number of effects spikes and falls. Logs both.
+void benchmarkParticlePool();
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstdint>
+
+// PCG32 (pcg-random.org). Unlike rand(), the sequence of a seed is the same on every platform and
+// there is no hidden global state. Each stream of a seed is an independent sequence, so every subsystem
+// draws from its own and a change in how often one of them draws leaves the others as they were.
+class Random {
+public:
+    explicit Random(uint64_t seed = 0, uint64_t stream = 0) : inc((stream << 1) | 1) {
+        next();
+        state += seed;
+        next();
+    }
+
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorShifted = uint32_t(((old >> 18) ^ old) >> 27);
+        uint32_t rot = uint32_t(old >> 59);
+        return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+    }
+    // in [0, 1)
+    float uniform() {
+        return float(next() >> 8) * (1.0f / 16777216.0f);
+    }
+    // in [min, max)
+    float uniform(float min, float max) {
+        return min + (max - min) * uniform();
+    }
+
+private:
+    uint64_t state = 0;
+    uint64_t inc;
+};
+
+#endif
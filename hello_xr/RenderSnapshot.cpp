@@ -0,0 +1,111 @@
+#include <stdexcept>
+
+#include "RenderSnapshot.hpp"
+
+void RenderSnapshot::clear(bool keepHaptics) {
+    drawList.clear();
+    drawList.setTarget(DrawList::world);
+    commands.clear();
+    strings.clear();
+    textBuffer.clear();
+    panelCalls.clear();
+    if (!keepHaptics)
+        haptics.clear();
+    simMs = 0.0;
+}
+
+void RenderSnapshot::replay(IGraphicsProvider& g) const {
+    const auto& draws = drawList.getDraws();
+    const auto& transforms = drawList.getTransforms();
+    uint32_t replayed = 0;
+    bool skipping = false;      // inside a panel that g has cached
+    auto drawModels = [&](uint32_t end) {
+        for (; replayed < end; replayed++) {
+            if (skipping)
+                continue;
+            const auto& draw = draws[replayed];
+            if (draw.mat)
+                g.DrawModel(draw.model, transforms.getPosition(replayed), transforms.getRotation(replayed), transforms.getScale(replayed), drawList.getMat(draw));
+            else
+                g.DrawModel(draw.model, transforms.getPosition(replayed), transforms.getRotation(replayed), transforms.getScale(replayed));
+        }
+    };
+
+    for (const auto& command : commands) {
+        drawModels(command.modelsBefore);
+        switch (command.call) {
+        case Call::DrawString:
+            if (!skipping) {
+                const auto& s = strings[command.index];
+                g.DrawString(std::string_view(textBuffer).substr(s.textBegin, s.textSize), s.pos, s.rot, s.height, s.color);
+            }
+            break;
+        case Call::DrawParticles:
+            g.DrawParticles();
+            break;
+        case Call::BeginPanel: {
+            const auto& p = panelCalls[command.index];
+            skipping = !g.BeginPanel(p.panel, p.contentKey);
+            break;
+        }
+        case Call::EndPanel:
+            if (!skipping)
+                g.EndPanel();
+            skipping = false;
+            break;
+        case Call::DrawPanel: {
+            const auto& p = panelCalls[command.index];
+            g.DrawPanel(p.panel, p.pos, p.rot);
+            break;
+        }
+        }
+    }
+    drawModels(uint32_t(draws.size()));
+}
+
+ModelHandle RenderSnapshot::LoadModel(const char* path) {
+    throw std::logic_error("RenderSnapshot: models are loaded on the real provider");
+}
+
+void RenderSnapshot::DrawString(std::string_view text, const glm::vec3& pos, const glm::quat& rot, float height, const glm::vec3& color) {
+    strings.push_back({ uint32_t(textBuffer.size()), uint32_t(text.size()), pos, rot, height, color });
+    textBuffer.append(text);
+    add(Call::DrawString, uint32_t(strings.size() - 1));
+}
+
+bool RenderSnapshot::InitParticles(const char* modelPath, uint32_t capacity) {
+    throw std::logic_error("RenderSnapshot: particles are set up on the real provider");
+}
+
+void RenderSnapshot::EmitParticles(const ParticleBurst& burst) {
+    throw std::logic_error("RenderSnapshot: bursts go to the real provider, a snapshot may be drawn more than once");
+}
+
+void RenderSnapshot::DrawParticles() {
+    add(Call::DrawParticles);
+}
+
+void RenderSnapshot::SetOccluder(ModelHandle model, bool occluder) {
+    throw std::logic_error("RenderSnapshot: occluders are set on the real provider");
+}
+
+PanelHandle RenderSnapshot::CreatePanel(uint32_t width, uint32_t height, const glm::vec2& size) {
+    throw std::logic_error("RenderSnapshot: panels are created on the real provider");
+}
+
+bool RenderSnapshot::BeginPanel(PanelHandle panel, uint64_t contentKey) {
+    panelCalls.push_back({ panel, contentKey, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f) });
+    add(Call::BeginPanel, uint32_t(panelCalls.size() - 1));
+    drawList.setTarget(panel);
+    return true;
+}
+
+void RenderSnapshot::EndPanel() {
+    add(Call::EndPanel);
+    drawList.setTarget(DrawList::world);
+}
+
+void RenderSnapshot::DrawPanel(PanelHandle panel, const glm::vec3& pos, const glm::quat& rot) {
+    panelCalls.push_back({ panel, 0, pos, rot });
+    add(Call::DrawPanel, uint32_t(panelCalls.size() - 1));
+}
@@ -0,0 +1,85 @@
+#ifndef RENDER_SNAPSHOT_HPP
+#define RENDER_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GraphicsProvider.hpp"
+
+// What one Game::draw() handed its graphics provider, kept so that another thread can draw it later,
+// once per view. The models are in drawList as with every provider; the other calls are kept in order
+// with the number of models drawn before each, so that replay() interleaves both as they were made.
+// Resources are created on the real provider by Game::init(), so the calls for that throw here,
+// and so does EmitParticles(): a burst happens once, while a snapshot may be drawn any number of times.
+// The snapshot also carries the haptics requested while simulating it, for the render thread to apply:
+// OpenXR calls on the session stay on the thread that waits for and begins the frames.
+class RenderSnapshot final : public IGraphicsProvider {
+public:
+    struct Haptic {
+        int hand;
+        float amplitude;
+    };
+
+    // keepHaptics leaves the haptics queued, for a snapshot that was skipped before they were applied
+    void clear(bool keepHaptics = false);
+    // makes the recorded calls on g. The content of a panel that g still has cached is skipped.
+    void replay(IGraphicsProvider& g) const;
+
+    // how long the simulation of this snapshot took
+    double simMs = 0.0;
+
+    void vibrate(int hand, float amplitude) { haptics.push_back({ hand, amplitude }); }
+    const std::vector<Haptic>& getHaptics() const { return haptics; }
+
+    ModelHandle LoadModel(const char* path) override;
+    void DrawString(std::string_view text, const glm::vec3& pos, const glm::quat& rot, float height, const glm::vec3& color) override;
+
+    bool InitParticles(const char* modelPath, uint32_t capacity) override;
+    void EmitParticles(const ParticleBurst& burst) override;
+    void DrawParticles() override;
+
+    void SetOccluder(ModelHandle model, bool occluder) override;
+
+    PanelHandle CreatePanel(uint32_t width, uint32_t height, const glm::vec2& size) override;
+    // always true: whether the content is cached is up to the provider the snapshot is replayed on
+    bool BeginPanel(PanelHandle panel, uint64_t contentKey) override;
+    void EndPanel() override;
+    void DrawPanel(PanelHandle panel, const glm::vec3& pos, const glm::quat& rot) override;
+
+private:
+    enum class Call : uint8_t {
+        DrawString, DrawParticles, BeginPanel, EndPanel, DrawPanel,
+    };
+    struct Command {
+        Call call;
+        uint32_t modelsBefore;      // draws in drawList when the call was made
+        uint32_t index;             // into strings / panelCalls
+    };
+    struct StringCall {
+        uint32_t textBegin;         // in textBuffer
+        uint32_t textSize;
+        glm::vec3 pos;
+        glm::quat rot;
+        float height;
+        glm::vec3 color;
+    };
+    struct PanelCall {
+        PanelHandle panel;
+        uint64_t contentKey;        // BeginPanel()
+        glm::vec3 pos;              // DrawPanel()
+        glm::quat rot;
+    };
+
+    void add(Call call, uint32_t index = 0) {
+        commands.push_back({ call, uint32_t(drawList.getDraws().size()), index });
+    }
+
+    std::vector<Command> commands;
+    std::vector<StringCall> strings;
+    std::string textBuffer;     // of every DrawString(), one after the other, so that a string does not allocate
+    std::vector<PanelCall> panelCalls;
+    std::vector<Haptic> haptics;
+};
+
+#endif
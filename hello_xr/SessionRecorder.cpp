@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <fmt/format.h>
+
+#include "SessionRecorder.hpp"
+
+namespace {
+    constexpr char magic[4] = { 'H', 'X', 'R', 'S' };
+    constexpr uint32_t version = 1;
+    // flushed this often, so that little is lost when the app is killed
+    constexpr uint32_t flushInterval = 128;
+
+    enum FrameFlags : uint8_t {
+        hasViewPose = 1 << 0,
+        hasStagePose = 1 << 1,
+        hasHandPose0 = 1 << 2,  // << hand
+        trigger0 = 1 << 4,      // << hand
+    };
+
+    template<typename T>
+    void put(std::ostream& s, const T& value) {
+        s.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool get(std::istream& s, T& value) {
+        return bool(s.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    void putPose(std::ostream& s, const Game::Pose& pose) {
+        const float v[7] = { pose.pos.x, pose.pos.y, pose.pos.z, pose.ori.x, pose.ori.y, pose.ori.z, pose.ori.w };
+        put(s, v);
+    }
+
+    bool getPose(std::istream& s, std::optional<Game::Pose>& pose) {
+        float v[7];
+        if (!get(s, v))
+            return false;
+        pose.emplace();
+        pose->pos = glm::vec3(v[0], v[1], v[2]);
+        pose->ori = glm::quat(v[6], v[3], v[4], v[5]);
+        return true;
+    }
+
+    bool getFrame(std::istream& s, SessionRecording::Frame& frame) {
+        uint8_t flags;
+        if (!get(s, frame.dat.dt) || !get(s, flags))
+            return false;
+        if ((flags & hasViewPose) && !getPose(s, frame.dat.viewPose))
+            return false;
+        if ((flags & hasStagePose) && !getPose(s, frame.dat.stagePose))
+            return false;
+        for (int i = 0; i < 2; i++) {
+            if ((flags & (hasHandPose0 << i)) && !getPose(s, frame.dat.handPoses[i]))
+                return false;
+            frame.dat.trigger[i] = (flags & (trigger0 << i)) != 0;
+        }
+        return get(s, frame.stateHash);
+    }
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty())
+            return 0.0;
+        auto nth = values.begin() + size_t(p * (values.size() - 1));
+        std::nth_element(values.begin(), nth, values.end());
+        return *nth;
+    }
+}
+
+SessionRecorder::SessionRecorder(const std::filesystem::path& path, const Game::SessionConfig& config)
+    : file(path, std::ios_base::binary | std::ios_base::trunc) {
+    if (!file)
+        throw std::runtime_error(fmt::format("cannot create session recording {}", path.string()));
+    file.write(magic, sizeof(magic));
+    put(file, version);
+    put(file, config.seed);
+    put(file, config.simHz);
+    put(file, uint8_t(config.targetStress));
+    put(file, uint8_t(config.targetTree));
+    std::cout << fmt::format("Recording session to {}", path.string()) << std::endl;
+}
+
+void SessionRecorder::write(const Game::GameData& dat, uint64_t stateHash) {
+    uint8_t flags = 0;
+    if (dat.viewPose.has_value())
+        flags |= hasViewPose;
+    if (dat.stagePose.has_value())
+        flags |= hasStagePose;
+    for (int i = 0; i < 2; i++) {
+        if (dat.handPoses[i].has_value())
+            flags |= hasHandPose0 << i;
+        if (dat.trigger[i])
+            flags |= trigger0 << i;
+    }
+
+    put(file, dat.dt);
+    put(file, flags);
+    if (dat.viewPose.has_value())
+        putPose(file, dat.viewPose.value());
+    if (dat.stagePose.has_value())
+        putPose(file, dat.stagePose.value());
+    for (int i = 0; i < 2; i++) {
+        if (dat.handPoses[i].has_value())
+            putPose(file, dat.handPoses[i].value());
+    }
+    put(file, stateHash);
+
+    if (++frameCount % flushInterval == 0)
+        file.flush();
+}
+
+SessionRecording SessionRecording::load(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios_base::binary);
+    if (!file)
+        throw std::runtime_error(fmt::format("cannot open session recording {}", path.string()));
+
+    char fileMagic[4];
+    uint32_t fileVersion;
+    if (!file.read(fileMagic, sizeof(fileMagic)) || !std::equal(fileMagic, fileMagic + 4, magic) || !get(file, fileVersion))
+        throw std::runtime_error(fmt::format("{} is not a session recording", path.string()));
+    if (fileVersion != version)
+        throw std::runtime_error(fmt::format("session recording {} has version {}, expected {}", path.string(), fileVersion, version));
+
+    SessionRecording recording;
+    uint8_t targetStress, targetTree;
+    if (!get(file, recording.config.seed) || !get(file, recording.config.simHz) || !get(file, targetStress) || !get(file, targetTree))
+        throw std::runtime_error(fmt::format("session recording {} is truncated", path.string()));
+    recording.config.targetStress = targetStress != 0;
+    recording.config.targetTree = targetTree != 0;
+
+    while (file.peek() != std::ifstream::traits_type::eof()) {
+        SessionRecording::Frame frame{};
+        if (!getFrame(file, frame)) {
+            std::cout << fmt::format("Session recording {}: dropped the cut off frame {}", path.string(), recording.frames.size()) << std::endl;
+            break;
+        }
+        recording.frames.push_back(frame);
+    }
+    return recording;
+}
+
+ReplayResult replaySession(const SessionRecording& recording, IGraphicsProvider& g, const std::filesystem::path& timesPath) {
+    std::optional<std::ofstream> times;
+    if (!timesPath.empty()) {
+        times.emplace(timesPath);
+        *times << "frame,dt,proc_ms,draw_ms,draws\n";
+    }
+
+    Game::reset(recording.config);
+
+    ReplayResult result{ uint32_t(recording.frames.size()), std::nullopt };
+    std::vector<double> procMs, drawMs, draws;
+    procMs.reserve(recording.frames.size());
+    drawMs.reserve(recording.frames.size());
+    draws.reserve(recording.frames.size());
+    for (uint32_t i = 0; i < recording.frames.size(); i++) {
+        const auto& frame = recording.frames[i];
+
+        auto procStart = std::chrono::steady_clock::now();
+        Game::proc(frame.dat);
+        auto drawStart = std::chrono::steady_clock::now();
+        g.drawList.clear();
+        Game::draw(g);
+        auto drawEnd = std::chrono::steady_clock::now();
+
+        procMs.push_back(std::chrono::duration<double, std::milli>(drawStart - procStart).count());
+        drawMs.push_back(std::chrono::duration<double, std::milli>(drawEnd - drawStart).count());
+        draws.push_back(double(g.drawList.getDraws().size()));
+        if (!result.firstMismatch && Game::stateHash() != frame.stateHash)
+            result.firstMismatch = i;
+        if (times)
+            *times << fmt::format("{},{},{:.4f},{:.4f},{}\n", i, frame.dat.dt, procMs.back(), drawMs.back(), draws.back());
+    }
+
+    std::cout << fmt::format("Replay: {} frames, seed {}, {}", result.frameCount, recording.config.seed,
+        result.firstMismatch ? fmt::format("diverged at frame {}", result.firstMismatch.value()) : std::string("every frame matched")) << std::endl;
+    // in us: a frame of the default session is well under the 1 us that ms with three decimals can show
+    auto us = [](const std::vector<double>& ms, double p) { return percentile(ms, p) * 1000.0; };
+    std::cout << fmt::format("Replay: proc p50 {:.1f} p99 {:.1f} max {:.1f} us, draw p50 {:.1f} p99 {:.1f} max {:.1f} us, draws p50 {} p99 {} max {}",
+        us(procMs, 0.5), us(procMs, 0.99), us(procMs, 1.0),
+        us(drawMs, 0.5), us(drawMs, 0.99), us(drawMs, 1.0),
+        percentile(draws, 0.5), percentile(draws, 0.99), percentile(draws, 1.0)) << std::endl;
+    return result;
+}
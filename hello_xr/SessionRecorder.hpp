@@ -0,0 +1,49 @@
+#ifndef SESSION_RECORDER_HPP
+#define SESSION_RECORDER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include "Game.hpp"
+
+// Binary recording of a session: its Game::SessionConfig, then for every frame the GameData that
+// Game::proc() got and Game::stateHash() after it. Poses are only stored when present, about 130 bytes
+// per frame at most; the vibration providers are not stored. Little endian, like every target of the app.
+class SessionRecorder {
+public:
+    // throws if the file cannot be created
+    SessionRecorder(const std::filesystem::path& path, const Game::SessionConfig& config);
+    void write(const Game::GameData& dat, uint64_t stateHash);
+
+private:
+    std::ofstream file;
+    uint32_t frameCount = 0;
+};
+
+struct SessionRecording {
+    struct Frame {
+        Game::GameData dat;
+        uint64_t stateHash;
+    };
+    Game::SessionConfig config;
+    std::vector<Frame> frames;
+
+    // throws if the file is missing or not a recording. A frame cut off at the end, by the app
+    // being killed while recording, is dropped.
+    static SessionRecording load(const std::filesystem::path& path);
+};
+
+struct ReplayResult {
+    uint32_t frameCount;
+    std::optional<uint32_t> firstMismatch;  // the first frame whose state differs from the recording
+};
+
+// Re-runs a recording from Game::reset() through Game::proc() and Game::draw() into g, which should draw nothing
+// (NullGraphicsProvider), and logs whether every frame matched and the p50 / p99 / max proc and draw times and draw counts.
+// The time and draw count of every frame go to timesPath as CSV unless it is empty.
+ReplayResult replaySession(const SessionRecording& recording, IGraphicsProvider& g, const std::filesystem::path& timesPath);
+
+#endif
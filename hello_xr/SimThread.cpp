@@ -0,0 +1,70 @@
+#include <chrono>
+
+#include "SimThread.hpp"
+
+SimThread::SimThread(SessionRecorder* recorder)
+    : recorder(recorder), thread([this] { loop(); }) {
+}
+
+SimThread::~SimThread() {
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        stopping = true;
+    }
+    inputReady.notify_one();
+    thread.join();
+}
+
+void SimThread::submit(const Game::GameData& dat) {
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        if (input) {
+            // the last frame is still being simulated: this one catches up on its time and presses
+            Game::GameData merged = dat;
+            merged.dt += input->dt;
+            for (int i = 0; i < 2; i++)
+                merged.trigger[i] = merged.trigger[i] || input->trigger[i];
+            input = merged;
+        }
+        else {
+            input = dat;
+        }
+    }
+    inputReady.notify_one();
+}
+
+const RenderSnapshot& SimThread::acquire(bool& fresh) {
+    fresh = snapshots.update();
+    return snapshots.front();
+}
+
+void SimThread::loop() {
+    bool skipped = false;
+    while (true) {
+        Game::GameData dat;
+        {
+            std::unique_lock<std::mutex> lock(inputMutex);
+            inputReady.wait(lock, [&] { return stopping || input.has_value(); });
+            if (stopping)
+                return;
+            dat = input.value();
+            input.reset();
+        }
+
+        auto simStart = std::chrono::steady_clock::now();
+        // the haptics of a snapshot that the render thread skipped have yet to be applied
+        auto& snapshot = snapshots.back();
+        snapshot.clear(skipped);
+        for (int i = 0; i < 2; i++) {
+            if (dat.handVib[i].has_value())
+                dat.handVib[i].emplace(std::ref<Game::IVibrationProvider>(handVib[i]));
+        }
+        Game::proc(dat);
+        if (recorder)
+            recorder->write(dat, Game::stateHash());
+
+        Game::draw(snapshot);
+        snapshot.simMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - simStart).count();
+        skipped = snapshots.publish();
+    }
+}
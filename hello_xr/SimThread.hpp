@@ -0,0 +1,59 @@
+#ifndef SIM_THREAD_HPP
+#define SIM_THREAD_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "Game.hpp"
+#include "RenderSnapshot.hpp"
+#include "SessionRecorder.hpp"
+#include "TripleBuffer.hpp"
+
+// Runs Game::proc() and Game::draw() on a thread of their own, a frame ahead of the render thread:
+// while the render thread draws the snapshot of frame N, this one simulates frame N + 1 from the input
+// submitted for it and records its draws into the next snapshot. The snapshots go through a TripleBuffer,
+// so neither thread waits for the other, and the CPU frame time is the longer of the two instead of their sum.
+// Game::init() has to be done, and from then on only this thread may call into Game.
+// The haptics that Game::proc() requests are queued in the snapshot instead of applied on this thread.
+class SimThread {
+public:
+    // recorder, if given, gets every simulated frame
+    explicit SimThread(SessionRecorder* recorder);
+    ~SimThread();
+    SimThread(const SimThread&) = delete;
+    SimThread& operator=(const SimThread&) = delete;
+
+    // the input of the next frame. Input that the thread has not started on yet is merged into it:
+    // the times add up, trigger presses are kept and the poses are the newest.
+    void submit(const Game::GameData& dat);
+    // the newest finished snapshot; it stays as it is until the next acquire(). Empty until the first one is done.
+    // fresh is false when it is the one the last acquire() returned, whose haptics were applied already.
+    const RenderSnapshot& acquire(bool& fresh);
+
+private:
+    // queues the vibrations of one hand in the snapshot being simulated
+    class SnapshotVibration : public Game::IVibrationProvider {
+        SimThread* const sim;
+        const int hand;
+    public:
+        SnapshotVibration(SimThread* sim, int hand) : sim(sim), hand(hand) {}
+        void vibrate(float a) override { sim->snapshots.back().vibrate(hand, a); }
+    };
+
+    void loop();
+
+    TripleBuffer<RenderSnapshot> snapshots;
+    SessionRecorder* const recorder;
+    SnapshotVibration handVib[2]{ { this, 0 }, { this, 1 } };
+
+    std::mutex inputMutex;
+    std::condition_variable inputReady;
+    std::optional<Game::GameData> input;
+    bool stopping = false;
+
+    std::thread thread;     // last, so that it starts on the rest
+};
+
+#endif
@@ -0,0 +1,613 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <fmt/format.h>
+
+#include <glm/gtx/intersect.hpp>
+
+#include "TargetStore.hpp"
+#include "simd.hpp"
+
+namespace {
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+
+    Aabb sphereBounds(const glm::vec3& center, float radius) {
+        return { center - glm::vec3(radius), center + glm::vec3(radius) };
+    }
+
+    glm::quat loadQuat(float* const* q, uint32_t i) {
+        return glm::quat(q[3][i], q[0][i], q[1][i], q[2][i]);
+    }
+
+    void storeQuat(float* const* q, uint32_t i, const glm::quat& value) {
+        for (int c = 0; c < 4; c++)
+            q[c][i] = value[c];
+    }
+
+    std::array<float, 3> floats(const glm::vec3& v) { return { v.x, v.y, v.z }; }
+    std::array<float, 4> floats(const glm::quat& q) { return { q.x, q.y, q.z, q.w }; }
+}
+
+TargetStore::TargetStore(uint32_t capacity, bool spatialIndex)
+    : entities(capacity), spatialIndex(spatialIndex) {
+    for (int c = 0; c < 3; c++) {
+        hid[c] = entities.column<HidPos>(c);
+        tgt[c] = entities.column<TgtPos>(c);
+        pos[c] = entities.column<Position>(c);
+        prevPos[c] = entities.column<PrevPosition>(c);
+        fatMin[c] = entities.column<FatMin>(c);
+        fatMax[c] = entities.column<FatMax>(c);
+    }
+    for (int c = 0; c < 4; c++) {
+        tgtRot[c] = entities.column<TgtRot>(c);
+        endRot[c] = entities.column<EndRot>(c);
+        rot[c] = entities.column<Rotation>(c);
+        prevRot[c] = entities.column<PrevRotation>(c);
+    }
+    timer = entities.array<double>();
+    proxies = entities.array<int32_t>();
+    dying = entities.array<uint8_t>();
+    // whole lane groups, so that proc() needs no remainder loop
+    events.resize((capacity + 3) / 4);
+    swept.reserve(capacity);
+    clear();
+}
+
+void TargetStore::clear() {
+    entities.clear();
+    tree.clear();
+    anyDying = false;
+}
+
+std::optional<TargetStore::Target> TargetStore::spawn(const glm::vec3& hidPos, const glm::vec3& tgtPos, const glm::quat& tgtOri, const glm::quat& endOri, double startTime) {
+    // the pose at startTime, so that the first proc() does not move the target across the tree.
+    // At 0, the hidden pose the old Target started from. Past the turn, the pose it ends on.
+    glm::quat q = tgtOri;
+    if (startTime >= holdEnd)
+        q = glm::normalize(glm::slerp(tgtOri, endOri, float(std::min(startTime - holdEnd, 1.0))));
+    auto target = entities.create(floats(hidPos), floats(tgtPos), floats(tgtOri), floats(endOri), floats(hidPos), floats(q), floats(hidPos), floats(q),
+        { -infinity, -infinity, -infinity }, { infinity, infinity, infinity }, startTime, AabbTree::nullNode, 0);
+    if (!target)
+        return std::nullopt;
+    const uint32_t i = entities.indexOf(target.value());
+
+    if (startTime > 0.0) {
+        const glm::vec3 p = pathAt(i, startTime);
+        for (int c = 0; c < 3; c++)
+            pos[c][i] = prevPos[c][i] = p[c];
+    }
+    if (spatialIndex) {
+        proxies[i] = tree.createProxy(sphereBounds(positionAt(i), radius), i);
+        copyFatBounds(i);
+    }
+    return target;
+}
+
+void TargetStore::kill(Target target) {
+    dying[entities.indexOf(target)] = 1;
+    anyDying = true;
+}
+
+// close to what proc() computes for the position, at any time
+glm::vec3 TargetStore::pathAt(uint32_t i, double t) const {
+    const float u = std::clamp(float(t / riseEnd), 0.0f, 1.0f);
+    const float s = std::clamp(float((t - turnEnd) / (lifetime - turnEnd)), 0.0f, 1.0f);
+    const float k = 1.0f - (1.0f - u) * (1.0f - u) - s * s;
+    const glm::vec3 hidPos(hid[0][i], hid[1][i], hid[2][i]);
+    const glm::vec3 tgtPos(tgt[0][i], tgt[1][i], tgt[2][i]);
+    return hidPos + (tgtPos - hidPos) * k;
+}
+
+void TargetStore::refit(uint32_t i) {
+    // the path is a straight line that the target goes up, holds, then goes down. The hold is longer
+    // than the lookahead, so the positions now and at the end of it bound the path in between.
+    const glm::vec3 now = positionAt(i);
+    if (tree.moveProxy(proxies[i], sphereBounds(now, radius), pathAt(i, timer[i] + refitLookahead) - now))
+        copyFatBounds(i);
+}
+
+void TargetStore::copyFatBounds(uint32_t i) {
+    const Aabb& fat = tree.getFatAabb(proxies[i]);
+    for (int c = 0; c < 3; c++) {
+        fatMin[c][i] = fat.min[c];
+        fatMax[c][i] = fat.max[c];
+    }
+}
+
+void TargetStore::animate(double dt, uint32_t beginGroup, uint32_t endGroup) {
+    using namespace simd;
+
+    const auto zero = set1(0.0f), bound = set1(radius);
+    const uint32_t count = entities.size();
+
+    const uint32_t begin = beginGroup * 4, end = endGroup * 4;
+    for (int c = 0; c < 3; c++)
+        std::copy(pos[c] + begin, pos[c] + end, prevPos[c] + begin);
+    for (int c = 0; c < 4; c++)
+        std::copy(rot[c] + begin, rot[c] + end, prevRot[c] + begin);
+
+    for (uint32_t i = begin; i < end; i += 4) {
+        // the phase and weights of each lane in double, as Target::proc did. The position is
+        // vLerp(a, b, k) = float(1.0 - k) * a + k * b: hid and tgt swap places in the sink.
+        alignas(16) float hidWeight[4] = {}, tgtWeight[4] = {}, held[4] = {};
+        int expired = 0;
+        for (uint32_t lane = 0; lane < 4 && i + lane < count; lane++) {
+            const uint32_t j = i + lane;
+            const double t = timer[j];
+            if (t < riseEnd) {
+                double u = t / 2.0;
+                float k = float(1.0 - (1.0 - u) * (1.0 - u));
+                hidWeight[lane] = float(1.0 - k);
+                tgtWeight[lane] = k;
+            }
+            else if (t < holdEnd) {
+                // the rotation is still the tgtOri that spawn() set
+                held[lane] = 1.0f;
+            }
+            else if (t < turnEnd) {
+                held[lane] = 1.0f;
+                storeQuat(rot, j, glm::normalize(glm::slerp(loadQuat(tgtRot, j), loadQuat(endRot, j), float(t - holdEnd))));
+            }
+            else if (t < lifetime) {
+                double u = (t - turnEnd) / 2.0;
+                float k = float(u * u);
+                hidWeight[lane] = k;
+                tgtWeight[lane] = float(1.0 - k);
+            }
+            else {
+                // left where it was, to be swept out
+                held[lane] = -1.0f;
+                expired |= 1 << lane;
+            }
+            timer[j] = t + dt;
+        }
+
+        // held lanes take tgt as it is, expired lanes keep their position
+        const auto wh = load(hidWeight), wt = load(tgtWeight), h = load(held);
+        f4 p[3];
+        for (int c = 0; c < 3; c++) {
+            auto blend = wh * load(&hid[c][i]) + wt * load(&tgt[c][i]);
+            p[c] = select(h < zero, load(&pos[c][i]), select(h > zero, load(&tgt[c][i]), blend));
+            store(&pos[c][i], p[c]);
+        }
+
+        int left = 0;
+        if (spatialIndex) {
+            // the targets whose bounding sphere left its fat bounds in the tree
+            auto outside = [&](int c) { return (p[c] - bound < load(&fatMin[c][i])) | (p[c] + bound > load(&fatMax[c][i])); };
+            left = bits(outside(0) | outside(1) | outside(2));
+        }
+        events[i / 4] = uint8_t(expired | left << 4);
+    }
+}
+
+void TargetStore::proc(double dt, JobSystem* jobs) {
+    const uint32_t count = entities.size();
+    const uint32_t groups = (count + 3) / 4;
+    if (jobs)
+        jobs->parallelFor(groups, procGrain / 4, [&](uint32_t begin, uint32_t end) { animate(dt, begin, end); });
+    else
+        animate(dt, 0, groups);
+
+    // sweeping and refitting change the store and the tree, so they stay in spawn order on this thread
+    swept.clear();
+    for (uint32_t g = 0; g < groups; g++) {
+        if (!events[g] && !anyDying)
+            continue;
+        const uint32_t lanes = std::min(count - g * 4, 4u);
+        for (uint32_t lane = 0; lane < lanes; lane++) {
+            const uint32_t i = g * 4 + lane;
+            if (dying[i] || (events[g] & (1 << lane))) {
+                if (proxies[i] != AabbTree::nullNode)
+                    tree.destroyProxy(proxies[i]);
+                swept.push_back(i);
+            }
+            else if ((events[g] & (16 << lane)) && proxies[i] != AabbTree::nullNode) {
+                refit(i);
+            }
+        }
+    }
+    anyDying = false;
+    if (swept.empty())
+        return;
+
+    // like remove_if, the targets that stay keep their order. The tree names them by index, which moved.
+    entities.removeDense(swept.data(), uint32_t(swept.size()));
+    if (spatialIndex) {
+        for (uint32_t i = swept[0]; i < entities.size(); i++)
+            tree.setUserData(proxies[i], i);
+    }
+}
+
+std::optional<TargetStore::RayHit> TargetStore::rayCastAt(uint32_t i, const glm::vec3& origin, const glm::vec3& dir) const {
+    const glm::vec3 center = positionAt(i);
+    const glm::vec3 norm = rotationAt(i) * glm::vec3{ 0, 0, 1 };
+    float rayLen;
+    if (!glm::intersectRayPlane(origin, dir, center, norm, rayLen))
+        return std::nullopt;
+    auto p = origin + rayLen * dir;
+    auto dCenter = glm::length(p - center);
+    if (!(dCenter < radius))
+        return std::nullopt;
+    return RayHit{ entities.entityAt(i), glm::dot(dir, norm) >= 0, p, rayLen, dCenter };
+}
+
+// in spawn order, this is what the per-target loop used to do
+void TargetStore::mergeHit(RayResult& result, const RayHit& hit) {
+    if (result.nearest && !(hit.rayLen < result.nearest->rayLen))
+        return;
+    result.nearest = hit;
+    if (hit.facing)
+        result.lockedOn = hit;
+}
+
+void TargetStore::mergeResult(RayResult& result, const RayResult& next) {
+    // the hits of next that become the nearest are the ones that next.nearest comes after,
+    // from the first one nearer than result.nearest on. next.lockedOn is the last facing one of them, if it is among those.
+    if (!next.nearest || (result.nearest && !(next.nearest->rayLen < result.nearest->rayLen)))
+        return;
+    if (next.lockedOn && (!result.nearest || next.lockedOn->rayLen < result.nearest->rayLen))
+        result.lockedOn = next.lockedOn;
+    result.nearest = next.nearest;
+}
+
+void TargetStore::rayCast(const glm::vec3* origins, const glm::vec3* dirs, uint32_t rayCount, RayResult* results, JobSystem* jobs) const {
+    if (!spatialIndex || entities.size() < treeRayCastMin)
+        rayCastScan(origins, dirs, rayCount, results, jobs);
+    else
+        rayCastTree(origins, dirs, rayCount, results);
+}
+
+void TargetStore::rayCastTree(const glm::vec3* origins, const glm::vec3* dirs, uint32_t rayCount, RayResult* results) const {
+    for (uint32_t r = 0; r < rayCount; r++) {
+        results[r] = {};
+        rayCandidates.clear();
+        tree.queryRay(origins[r], dirs[r], std::numeric_limits<float>::max(), [&](uint32_t i) { rayCandidates.push_back(i); });
+        std::sort(rayCandidates.begin(), rayCandidates.end());
+        for (auto i : rayCandidates) {
+            if (auto hit = rayCastAt(i, origins[r], dirs[r]))
+                mergeHit(results[r], hit.value());
+        }
+    }
+}
+
+void TargetStore::rayCastScan(const glm::vec3* origins, const glm::vec3* dirs, uint32_t rayCount, RayResult* results, JobSystem* jobs) const {
+    for (uint32_t r = 0; r < rayCount; r++)
+        results[r] = {};
+    const uint32_t count = entities.size();
+    if (!jobs || count <= rayCastGrain) {
+        rayCastRange(origins, dirs, rayCount, results, 0, count);
+        return;
+    }
+
+    // each part on its own results, merged in spawn order
+    const uint32_t parts = (count + rayCastGrain - 1) / rayCastGrain;
+    std::vector<RayResult> partResults(size_t(parts) * rayCount);
+    jobs->parallelFor(parts, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t part = begin; part < end; part++)
+            rayCastRange(origins, dirs, rayCount, &partResults[size_t(part) * rayCount], part * rayCastGrain, std::min((part + 1) * rayCastGrain, count));
+    });
+    for (uint32_t part = 0; part < parts; part++) {
+        for (uint32_t r = 0; r < rayCount; r++)
+            mergeResult(results[r], partResults[size_t(part) * rayCount + r]);
+    }
+}
+
+void TargetStore::rayCastRange(const glm::vec3* origins, const glm::vec3* dirs, uint32_t rayCount, RayResult* results, uint32_t begin, uint32_t end) const {
+    using namespace simd;
+
+    const auto zero = set1(0.0f), one = set1(1.0f), two = set1(2.0f);
+    const auto epsilon = set1(std::numeric_limits<float>::epsilon()), maxDist = set1(radius);
+
+    for (uint32_t i = begin; i < end; i += 4) {
+        const auto cx = load(&pos[0][i]), cy = load(&pos[1][i]), cz = load(&pos[2][i]);
+        const auto qx = load(&rot[0][i]), qy = load(&rot[1][i]), qz = load(&rot[2][i]), qw = load(&rot[3][i]);
+
+        // rot * (0, 0, 1), in the order glm evaluates it
+        const auto nx = (qy * qw + qx * qz) * two;
+        const auto ny = (qy * qz - qx * qw) * two;
+        const auto nz = one - (qx * qx + qy * qy) * two;
+
+        for (uint32_t r = 0; r < rayCount; r++) {
+            const auto ox = set1(origins[r].x), oy = set1(origins[r].y), oz = set1(origins[r].z);
+            const auto dx = set1(dirs[r].x), dy = set1(dirs[r].y), dz = set1(dirs[r].z);
+
+            // glm::intersectRayPlane, then the distance of the intersection to the center
+            const auto d = dx * nx + dy * ny + dz * nz;
+            const auto t = ((cx - ox) * nx + (cy - oy) * ny + (cz - oz) * nz) / d;
+            const auto px = ox + t * dx, py = oy + t * dy, pz = oz + t * dz;
+            const auto ex = px - cx, ey = py - cy, ez = pz - cz;
+            const auto dCenter = sqrt(ex * ex + ey * ey + ez * ez);
+            // dCenter < radius is dCenter <= 0.2 in double, as 0.2f is just above 0.2
+            int hits = bits((abs(d) > epsilon) & (t > zero) & (dCenter < maxDist));
+            if (!hits)
+                continue;
+
+            // rare, so the lanes are merged one at a time, in spawn order
+            alignas(16) float lanes[6][4];
+            store(lanes[0], t);
+            store(lanes[1], dCenter);
+            store(lanes[2], d);
+            store(lanes[3], px);
+            store(lanes[4], py);
+            store(lanes[5], pz);
+            for (int lane = 0; lane < 4; lane++) {
+                if ((hits & (1 << lane)) && i + lane < end)
+                    mergeHit(results[r], RayHit{ entities.entityAt(i + lane), lanes[2][lane] >= 0.0f, glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]), lanes[0][lane], lanes[1][lane] });
+            }
+        }
+    }
+}
+
+void benchmarkTargetStore() {
+    constexpr uint32_t count = 10000;
+    constexpr int iterations = 200;
+    constexpr double dt = 1.0 / 72.0;
+
+    // the old per-target loop, as Game.cpp had it
+    struct Target {
+        glm::vec3 pos, hidPos, tgtPos;
+        glm::quat ori, tgtOri, endOri;
+        double timer;
+        bool alive = true;
+
+        void proc(double dt) {
+            auto vLerp = [](glm::vec3 v1, glm::vec3 v2, float t) { return float(1.0 - t) * v1 + t * v2; };
+            if (timer < 2.0f) {
+                double t = timer / 2.0;
+                pos = vLerp(hidPos, tgtPos, float(1.0 - (1.0 - t) * (1.0 - t)));
+            }
+            else if (timer < 4.0f) {
+                pos = tgtPos;
+                ori = tgtOri;
+            }
+            else if (timer < 5.0f) {
+                double t = timer - 4.0f;
+                pos = tgtPos;
+                ori = glm::normalize(glm::slerp(tgtOri, endOri, float(t)));
+            }
+            else if (timer < 7.0f) {
+                double t = (timer - 5.0f) / 2.0;
+                pos = vLerp(tgtPos, hidPos, float(t * t));
+            }
+            else {
+                alive = false;
+            }
+            timer += dt;
+        }
+    };
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<double> time(0.0, TargetStore::lifetime);
+    TargetStore store(count);
+    std::vector<Target> reference;
+    // both start from the pose spawn() gives
+    auto spawn = [&](double timer) {
+        glm::vec3 tgtPos = glm::vec3(dist(rng), dist(rng), dist(rng)) * 8.0f;
+        auto endOri = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+        auto tgtOri = glm::normalize(endOri * glm::angleAxis(3.14159265f, glm::vec3(0, 1, 0)));
+        auto target = store.spawn(tgtPos - glm::vec3(0, 10, 0), tgtPos, tgtOri, endOri, timer).value();
+        reference.push_back({ store.getPosition(target), tgtPos - glm::vec3(0, 10, 0), tgtPos, store.getRotation(target), tgtOri, endOri, timer });
+    };
+    for (uint32_t i = 0; i < count; i++)
+        spawn(time(rng));
+
+    // kept full like the stress mode, with the new targets outside the timing
+    double referenceNs = 0.0, simdNs = 0.0;
+    uint32_t mismatches = 0;
+    for (int step = 0; step < iterations; step++) {
+        auto start = std::chrono::steady_clock::now();
+        for (auto& target : reference)
+            target.proc(dt);
+        reference.erase(std::remove_if(reference.begin(), reference.end(), [](const Target& target) { return !target.alive; }), reference.end());
+        auto mid = std::chrono::steady_clock::now();
+        store.proc(dt);
+        auto end = std::chrono::steady_clock::now();
+        referenceNs += std::chrono::duration<double, std::nano>(mid - start).count();
+        simdNs += std::chrono::duration<double, std::nano>(end - mid).count();
+
+        if (store.size() != reference.size()) {
+            mismatches++;
+            break;
+        }
+        for (uint32_t i = 0; i < store.size(); i++) {
+            glm::vec3 p = store.getPosition(store.at(i));
+            glm::quat q = store.getRotation(store.at(i));
+            mismatches += std::memcmp(&p, &reference[i].pos, sizeof(p)) != 0 || std::memcmp(&q, &reference[i].ori, sizeof(q)) != 0;
+        }
+        while (store.size() < count)
+            spawn(0.0);
+    }
+    referenceNs /= double(iterations) * count;
+    simdNs /= double(iterations) * count;
+
+    std::cout << fmt::format("Target store: {} targets, {} steps, old loop {:.2f} ns/target, SIMD {:.2f} ns/target ({:.1f}x), {} poses differ",
+        count, iterations, referenceNs, simdNs, referenceNs / simdNs, mismatches) << std::endl;
+
+    auto timeNs = [&](auto&& func) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+            func();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (double(iterations) * count);
+    };
+
+    // pairs of hand rays, each aimed close to a random target so that most of them hit something
+    constexpr uint32_t rayPairs = 64;
+    std::vector<glm::vec3> origins(rayPairs * 2), dirs(rayPairs * 2);
+    std::uniform_int_distribution<uint32_t> index(0, count - 1);
+    for (uint32_t i = 0; i < rayPairs * 2; i++) {
+        origins[i] = glm::vec3(dist(rng), dist(rng) + 1.5f, dist(rng)) * 0.3f;
+        dirs[i] = glm::normalize(store.getPosition(store.at(index(rng))) + glm::vec3(dist(rng), dist(rng), dist(rng)) * 0.2f - origins[i]);
+    }
+
+    std::vector<TargetStore::RayResult> scanned(rayPairs * 2), batched(rayPairs * 2);
+    // the per-target loop the game used to run
+    auto scanNs = timeNs([&] {
+        for (uint32_t r = 0; r < rayPairs * 2; r++) {
+            auto& result = scanned[r];
+            result = {};
+            store.forEach([&](TargetStore::Target target) {
+                auto hit = store.rayCastReference(target, origins[r], dirs[r]);
+                if (!hit || (result.nearest && !(hit->rayLen < result.nearest->rayLen)))
+                    return;
+                result.nearest = hit;
+                if (hit->facing)
+                    result.lockedOn = hit;
+            });
+        }
+    }) / (rayPairs * 2);
+    auto batchNs = timeNs([&] {
+        for (uint32_t r = 0; r < rayPairs * 2; r += 2)
+            store.rayCastScan(&origins[r], &dirs[r], 2, &batched[r]);
+    }) / (rayPairs * 2);
+
+    auto same = [](const std::optional<TargetStore::RayHit>& a, const std::optional<TargetStore::RayHit>& b) {
+        if (!a || !b)
+            return !a && !b;
+        return a->target == b->target && a->facing == b->facing && a->colPos == b->colPos && a->rayLen == b->rayLen && a->dCenter == b->dCenter;
+    };
+    uint32_t hitCount = 0, rayMismatches = 0;
+    for (uint32_t r = 0; r < rayPairs * 2; r++) {
+        hitCount += scanned[r].nearest.has_value();
+        rayMismatches += !same(scanned[r].nearest, batched[r].nearest) || !same(scanned[r].lockedOn, batched[r].lockedOn);
+    }
+
+    std::cout << fmt::format("Target ray cast: {} rays, {} hit, glm scan {:.2f} ns/target/ray, SIMD {:.2f} ns/target/ray ({:.1f}x), {} differ",
+        rayPairs * 2, hitCount, scanNs, batchNs, scanNs / batchNs, rayMismatches) << std::endl;
+}
+
+void benchmarkTargetQueries() {
+    constexpr int frames = 72;
+    constexpr uint32_t queries = 64;
+    const glm::vec3 head(0.0f, 1.5f, 0.0f);
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> time(0.0f, float(TargetStore::lifetime));
+
+    // arena: where the game spawns them, 1 to 8 m in front of the player, so they crowd as the count grows.
+    // open: one target per cubic meter around the player, so a query sees about as many at any count.
+    for (bool open : { false, true }) {
+        for (uint32_t count : { 10u, 100u, 1000u, 10000u, 100000u }) {
+            const float openSize = std::cbrt(float(count));
+            auto randomPosition = [&] {
+                if (open)
+                    return head + glm::vec3(dist(rng), dist(rng), dist(rng)) * (openSize * 0.5f);
+                return head + glm::normalize(glm::vec3(dist(rng), dist(rng) * 0.5f, -1.0f)) * (4.5f + 3.5f * dist(rng));
+            };
+
+            TargetStore store(count, true);
+            auto spawn = [&](float timer) {
+                auto tgtPos = randomPosition();
+                auto endOri = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+                auto tgtOri = glm::normalize(endOri * glm::angleAxis(3.14159265f, glm::vec3(0, 1, 0)));
+                store.spawn(tgtPos - glm::vec3(0, 10, 0), tgtPos, tgtOri, endOri, timer);
+            };
+            while (store.size() < count)
+                spawn(time(rng));
+
+            // a second of frames, kept full like the stress mode
+            double procNs = 0.0;
+            for (int f = 0; f < frames; f++) {
+                auto start = std::chrono::steady_clock::now();
+                store.proc(1.0f / frames);
+                procNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                while (store.size() < count)
+                    spawn(0.0f);
+            }
+            store.proc(0.0f);
+
+            // the store is full, so any index is a live target to aim at
+            std::uniform_int_distribution<uint32_t> index(0, count - 1);
+            std::vector<glm::vec3> origins(queries), dirs(queries), centers(queries);
+            for (uint32_t q = 0; q < queries; q++) {
+                auto aim = store.getPosition(store.at(index(rng)));
+                origins[q] = open ? aim + glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng))) * 5.0f : head + glm::vec3(dist(rng), dist(rng), dist(rng)) * 0.3f;
+                dirs[q] = glm::normalize(aim + glm::vec3(dist(rng), dist(rng), dist(rng)) * 0.2f - origins[q]);
+                centers[q] = store.getPosition(store.at(index(rng)));
+            }
+            constexpr float sphereRadius = 0.5f, coneAngle = 0.05f, coneRange = 20.0f;
+
+            const uint32_t repeats = std::max(1u, 100000u / count);
+            auto timeNs = [&](auto&& func) {
+                auto start = std::chrono::steady_clock::now();
+                for (uint32_t i = 0; i < repeats; i++)
+                    func();
+                return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (double(repeats) * queries);
+            };
+
+            std::vector<TargetStore::RayResult> scanRays(queries), treeRays(queries);
+            std::vector<std::vector<uint32_t>> scanSpheres(queries), treeSpheres(queries), scanCones(queries), treeCones(queries);
+            // both hands at once, as in the game
+            double rayScanNs = timeNs([&] {
+                for (uint32_t q = 0; q < queries; q += 2)
+                    store.rayCastScan(&origins[q], &dirs[q], 2, &scanRays[q]);
+            });
+            double rayTreeNs = timeNs([&] {
+                for (uint32_t q = 0; q < queries; q += 2)
+                    store.rayCastTree(&origins[q], &dirs[q], 2, &treeRays[q]);
+            });
+            double sphereScanNs = timeNs([&] {
+                const float maxDist = sphereRadius + TargetStore::radius;
+                for (uint32_t q = 0; q < queries; q++) {
+                    scanSpheres[q].clear();
+                    store.forEach([&](TargetStore::Target target) {
+                        glm::vec3 d = store.getPosition(target) - centers[q];
+                        if (glm::dot(d, d) <= maxDist * maxDist)
+                            scanSpheres[q].push_back(target.slot);
+                    });
+                }
+            });
+            double sphereTreeNs = timeNs([&] {
+                for (uint32_t q = 0; q < queries; q++) {
+                    treeSpheres[q].clear();
+                    store.querySphere(centers[q], sphereRadius, [&](TargetStore::Target target) { treeSpheres[q].push_back(target.slot); });
+                }
+            });
+            double coneScanNs = timeNs([&] {
+                const float sinAngle = std::sin(coneAngle), cosAngle = std::cos(coneAngle);
+                for (uint32_t q = 0; q < queries; q++) {
+                    scanCones[q].clear();
+                    store.forEach([&](TargetStore::Target target) {
+                        if (AabbTree::sphereInCone(store.getPosition(target), TargetStore::radius, origins[q], dirs[q], sinAngle, cosAngle, coneRange))
+                            scanCones[q].push_back(target.slot);
+                    });
+                }
+            });
+            double coneTreeNs = timeNs([&] {
+                for (uint32_t q = 0; q < queries; q++) {
+                    treeCones[q].clear();
+                    store.queryCone(origins[q], dirs[q], coneAngle, coneRange, [&](TargetStore::Target target) { treeCones[q].push_back(target.slot); });
+                }
+            });
+
+            auto sameHit = [](const std::optional<TargetStore::RayHit>& a, const std::optional<TargetStore::RayHit>& b) {
+                if (!a || !b)
+                    return !a && !b;
+                return a->target == b->target && a->facing == b->facing && a->colPos == b->colPos && a->rayLen == b->rayLen && a->dCenter == b->dCenter;
+            };
+            auto sameSlots = [](std::vector<uint32_t>& a, std::vector<uint32_t>& b) {
+                std::sort(a.begin(), a.end());
+                std::sort(b.begin(), b.end());
+                return a == b;
+            };
+            uint32_t mismatches = 0;
+            for (uint32_t q = 0; q < queries; q++) {
+                mismatches += !sameHit(scanRays[q].nearest, treeRays[q].nearest) || !sameHit(scanRays[q].lockedOn, treeRays[q].lockedOn);
+                mismatches += !sameSlots(scanSpheres[q], treeSpheres[q]);
+                mismatches += !sameSlots(scanCones[q], treeCones[q]);
+            }
+
+            std::cout << fmt::format("Target queries, {} {} targets: proc + refit {:.2f} ns/target, "
+                "ray scan {:.0f} / tree {:.0f} ns, sphere scan {:.0f} / tree {:.0f} ns, cone scan {:.0f} / tree {:.0f} ns, {} differ",
+                count, open ? "open" : "arena", procNs / (double(frames) * count),
+                rayScanNs, rayTreeNs, sphereScanNs, sphereTreeNs, coneScanNs, coneTreeNs, mismatches) << std::endl;
+        }
+    }
+}
@@ -0,0 +1,213 @@
+#ifndef TARGET_STORE_HPP
+#define TARGET_STORE_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "AabbTree.hpp"
+#include "EntityStore.hpp"
+#include "JobSystem.hpp"
+
+// The shooting targets, an archetype in an EntityStore: one float array per coordinate, with the targets
+// packed at the front in the order they were spawned, like the vector of targets the game used to keep.
+// A target rises from its hidden position, holds, turns away and sinks back; proc() steps that animation as
+// Target::proc did, with the same double timers and glm::slerp, and blends the positions of four targets per
+// SIMD lane group, so the poses come out bit for bit the same.
+// Targets are named by generational handles. Killed and expired targets are swept out at the end of proc(),
+// keeping the order of the others.
+// With the spatial index, the bounding spheres of the disks are also kept in an AabbTree, which proc()
+// refits as targets move, for queries that do not scale with the number of targets. It only pays off
+// where targets are spread out: benchmarkTargetQueries() compares it with scanning every target.
+// Given a JobSystem, proc() and the ray scan split large stores into parts of a fixed size, which give
+// the same results as one pass.
+class TargetStore {
+    // the components of a target, quaternions as x, y, z, w
+    struct HidPosTag; struct TgtPosTag; struct TgtRotTag; struct EndRotTag;
+    struct PositionTag; struct RotationTag; struct PrevPositionTag; struct PrevRotationTag;
+    struct FatMinTag; struct FatMaxTag;
+    using HidPos = FloatColumns<HidPosTag, 3>;
+    using TgtPos = FloatColumns<TgtPosTag, 3>;
+    using TgtRot = FloatColumns<TgtRotTag, 4>;
+    using EndRot = FloatColumns<EndRotTag, 4>;
+    using Position = FloatColumns<PositionTag, 3>;              // output of proc()
+    using Rotation = FloatColumns<RotationTag, 4>;
+    using PrevPosition = FloatColumns<PrevPositionTag, 3>;      // output of the proc() before
+    using PrevRotation = FloatColumns<PrevRotationTag, 4>;
+    // copy of the fat bounds in the tree. Infinite without the spatial index, so targets never leave them.
+    using FatMin = FloatColumns<FatMinTag, 3>;
+    using FatMax = FloatColumns<FatMaxTag, 3>;
+    // and whole: the timer, the proxy in the tree and whether kill() was called
+    using Store = EntityStore<HidPos, TgtPos, TgtRot, EndRot, Position, Rotation, PrevPosition, PrevRotation, FatMin, FatMax, double, int32_t, uint8_t>;
+
+public:
+    using Target = Store::Entity;
+
+    static constexpr double riseEnd = 2.0;
+    static constexpr double holdEnd = 4.0;
+    static constexpr double turnEnd = 5.0;
+    static constexpr double lifetime = 7.0;
+    static constexpr float radius = 0.2f;
+    // below this many targets, the SIMD scan beats the tree for ray casts even where targets are spread out
+    static constexpr uint32_t treeRayCastMin = 1000;
+    // a target leaving its fat bounds is reinserted with bounds that cover its path for this long
+    static constexpr float refitLookahead = 0.25f;
+    // targets per job of proc() / of the ray scan, whole lane groups
+    static constexpr uint32_t procGrain = 2048;
+    static constexpr uint32_t rayCastGrain = 2048;
+
+    struct RayHit {
+        Target target;
+        bool facing;        // the ray runs along the disk normal, onto the side that can be shot
+        glm::vec3 colPos;
+        float rayLen;
+        float dCenter;
+    };
+    struct RayResult {
+        std::optional<RayHit> nearest;      // facing or not
+        // what a scan in spawn order locks on to: the last facing hit that was nearer than every hit before it
+        std::optional<RayHit> lockedOn;
+    };
+
+    explicit TargetStore(uint32_t capacity, bool spatialIndex = false);
+    // the systems below reach the columns of the store through pointers taken once
+    TargetStore(const TargetStore&) = delete;
+    TargetStore& operator=(const TargetStore&) = delete;
+
+    // appended after every other target, nullopt when the store is full. timer > 0 starts the
+    // animation part way through.
+    std::optional<Target> spawn(const glm::vec3& hidPos, const glm::vec3& tgtPos, const glm::quat& tgtOri, const glm::quat& endOri, double timer = 0.0);
+    // marks the target dead. Like the old alive flag, it is still animated, cast against and visited
+    // by forEach() until the next proc() sweeps it out.
+    void kill(Target target);
+    void clear();
+    bool alive(Target target) const { return entities.alive(target); }
+
+    // poses at the current timers, then advances the timers by dt and sweeps out the targets that were
+    // killed or past their lifetime
+    void proc(double dt, JobSystem* jobs = nullptr);
+
+    // every ray against the disks of every target at the poses of the last proc(), through rayCastTree()
+    // with the spatial index and enough targets, rayCastScan() otherwise. Both give the same results
+    // as long as neither is built with contracted multiply-adds.
+    void rayCast(const glm::vec3* origins, const glm::vec3* dirs, uint32_t rayCount, RayResult* results, JobSystem* jobs = nullptr) const;
+    // every target, four at a time
+    void rayCastScan(const glm::vec3* origins, const glm::vec3* dirs, uint32_t rayCount, RayResult* results, JobSystem* jobs = nullptr) const;
+    // the targets whose bounds the ray crosses, tested through rayCastReference() in spawn order.
+    // Needs the spatial index. Not to be called from two threads at once: it shares one candidate list.
+    void rayCastTree(const glm::vec3* origins, const glm::vec3* dirs, uint32_t rayCount, RayResult* results) const;
+    // one ray against one disk through glm, the reference for rayCast()
+    std::optional<RayHit> rayCastReference(Target target, const glm::vec3& origin, const glm::vec3& dir) const {
+        return rayCastAt(entities.indexOf(target), origin, dir);
+    }
+
+    // the targets whose bounding sphere, of the disk radius, overlaps the sphere / the cone around
+    // the normalized axis up to range from the apex, in no particular order.
+    // Through the tree with the spatial index, by testing every target otherwise.
+    template<typename F>
+    void querySphere(const glm::vec3& center, float sphereRadius, F&& func) const {
+        const float maxDist = sphereRadius + radius;
+        auto test = [&](uint32_t i) {
+            glm::vec3 d = positionAt(i) - center;
+            if (glm::dot(d, d) <= maxDist * maxDist)
+                func(entities.entityAt(i));
+        };
+        if (spatialIndex)
+            tree.querySphere(center, sphereRadius, test);
+        else
+            forEachIndex(test);
+    }
+    template<typename F>
+    void queryCone(const glm::vec3& apex, const glm::vec3& axis, float halfAngle, float range, F&& func) const {
+        const float sinAngle = std::sin(halfAngle), cosAngle = std::cos(halfAngle);
+        auto test = [&](uint32_t i) {
+            if (AabbTree::sphereInCone(positionAt(i), radius, apex, axis, sinAngle, cosAngle, range))
+                func(entities.entityAt(i));
+        };
+        if (spatialIndex)
+            tree.queryCone(apex, axis, halfAngle, range, test);
+        else
+            forEachIndex(test);
+    }
+
+    // func(Target) for every target, in spawn order
+    template<typename F>
+    void forEach(F&& func) const {
+        for (uint32_t i = 0; i < entities.size(); i++)
+            func(entities.entityAt(i));
+    }
+    // the i-th target in spawn order
+    Target at(uint32_t i) const { return entities.entityAt(i); }
+    glm::vec3 getPosition(Target target) const { return positionAt(entities.indexOf(target)); }
+    glm::quat getRotation(Target target) const { return rotationAt(entities.indexOf(target)); }
+    // between the pose before the last proc() (alpha 0) and after it (alpha 1), for drawing between two steps
+    glm::vec3 getPosition(Target target, float alpha) const {
+        const uint32_t i = entities.indexOf(target);
+        return glm::mix(glm::vec3(prevPos[0][i], prevPos[1][i], prevPos[2][i]), positionAt(i), alpha);
+    }
+    glm::quat getRotation(Target target, float alpha) const {
+        const uint32_t i = entities.indexOf(target);
+        glm::quat prev(prevRot[3][i], prevRot[0][i], prevRot[1][i], prevRot[2][i]);
+        return glm::normalize(prev * (1.0f - alpha) + rotationAt(i) * alpha);
+    }
+    uint32_t size() const { return entities.size(); }
+    uint32_t capacity() const { return entities.capacity(); }
+
+private:
+    template<typename F>
+    void forEachIndex(F&& func) const {
+        for (uint32_t i = 0; i < entities.size(); i++)
+            func(i);
+    }
+    glm::vec3 positionAt(uint32_t i) const { return glm::vec3(pos[0][i], pos[1][i], pos[2][i]); }
+    glm::quat rotationAt(uint32_t i) const { return glm::quat(rot[3][i], rot[0][i], rot[1][i], rot[2][i]); }
+    std::optional<RayHit> rayCastAt(uint32_t i, const glm::vec3& origin, const glm::vec3& dir) const;
+    // the animation of the lane groups [beginGroup, endGroup), with the lanes that expired or left their fat bounds in events
+    void animate(double dt, uint32_t beginGroup, uint32_t endGroup);
+    // merges the hits of the targets [begin, end) into results, begin at a lane group
+    void rayCastRange(const glm::vec3* origins, const glm::vec3* dirs, uint32_t rayCount, RayResult* results, uint32_t begin, uint32_t end) const;
+    // where target i is at time t, in float: only to stretch the fat bounds
+    glm::vec3 pathAt(uint32_t i, double t) const;
+    // reinserts target i into the tree when it left its fat bounds
+    void refit(uint32_t i);
+    void copyFatBounds(uint32_t i);
+    static void mergeHit(RayResult& result, const RayHit& hit);
+    // as if the targets of next had been scanned after those of result
+    static void mergeResult(RayResult& result, const RayResult& next);
+
+    Store entities;
+    // the columns of entities, which never reallocates
+    float* hid[3];
+    float* tgt[3];
+    float* tgtRot[4];
+    float* endRot[4];
+    float* pos[3];
+    float* rot[4];
+    float* prevPos[3];
+    float* prevRot[4];
+    float* fatMin[3];
+    float* fatMax[3];
+    double* timer;
+    int32_t* proxies;
+    uint8_t* dying;
+    bool anyDying = false;
+    // per lane group, written by animate(): the lanes past their lifetime in the low bits, out of their fat bounds in the high bits
+    std::vector<uint8_t> events;
+    std::vector<uint32_t> swept;        // scratch for the sweep in proc()
+
+    bool spatialIndex;
+    AabbTree tree;
+    mutable std::vector<uint32_t> rayCandidates;    // scratch for rayCastTree(), kept to reuse its capacity
+};
+
+// Times proc() against a copy of the old Target::proc() loop and its sweep for 10k targets kept full, and
+// rayCast() against rayCastReference() per target. Logs ns per target, and the poses and ray casts that differ.
+void benchmarkTargetStore();
+// Times the ray, sphere and cone queries through the tree against a scan of every target, for 10 to 100k targets.
+void benchmarkTargetQueries();
+
+#endif
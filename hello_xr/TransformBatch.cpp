@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <fmt/format.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "TransformBatch.hpp"
+#include "simd.hpp"
+
+glm::mat4 TransformBatch::computeMvp(size_t i, const glm::mat4& vp) const {
+    return vp * glm::translate(glm::identity<glm::mat4>(), glm::vec3(px[i], py[i], pz[i]))
+        * glm::mat4(glm::quat(qw[i], qx[i], qy[i], qz[i]))
+        * glm::scale(glm::identity<glm::mat4>(), glm::vec3(sx[i], sy[i], sz[i]));
+}
+
+void TransformBatch::computeMvps(const glm::mat4& vp, glm::mat4* out, JobSystem* jobs) const {
+    if (jobs)
+        jobs->parallelFor(uint32_t(size()), mvpGrain, [&](uint32_t begin, uint32_t end) { computeMvps(vp, out, begin, end); });
+    else
+        computeMvps(vp, out, 0, size());
+}
+
+void TransformBatch::computeMvps(const glm::mat4& vp, glm::mat4* out, size_t begin, size_t end) const {
+    using namespace simd;
+
+    // vp[column][row], broadcast to all lanes
+    f4 m[4][4];
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            m[c][r] = set1(vp[c][r]);
+    const auto one = set1(1.0f), two = set1(2.0f);
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        auto x = load(&qx[i]), y = load(&qy[i]), z = load(&qz[i]), w = load(&qw[i]);
+        auto xx = x * x, yy = y * y, zz = z * z;
+        auto xy = x * y, xz = x * z, yz = y * z;
+        auto wx = w * x, wy = w * y, wz = w * z;
+
+        // columns of R * S
+        auto scaleX = load(&sx[i]), scaleY = load(&sy[i]), scaleZ = load(&sz[i]);
+        f4 model[3][3] = {
+            { (one - two * (yy + zz)) * scaleX, two * (xy + wz) * scaleX, two * (xz - wy) * scaleX },
+            { two * (xy - wz) * scaleY, (one - two * (xx + zz)) * scaleY, two * (yz + wx) * scaleY },
+            { two * (xz + wy) * scaleZ, two * (yz - wx) * scaleZ, (one - two * (xx + yy)) * scaleZ },
+        };
+        auto tx = load(&px[i]), ty = load(&py[i]), tz = load(&pz[i]);
+
+        for (int c = 0; c < 4; c++) {
+            f4 col[4];
+            for (int r = 0; r < 4; r++) {
+                col[r] = c < 3
+                    ? fmadd(m[0][r], model[c][0], fmadd(m[1][r], model[c][1], m[2][r] * model[c][2]))
+                    : fmadd(m[0][r], tx, fmadd(m[1][r], ty, fmadd(m[2][r], tz, m[3][r])));
+            }
+            // lanes are draws; after the transpose each register is the column of one draw
+            transpose(col[0], col[1], col[2], col[3]);
+            for (int k = 0; k < 4; k++)
+                store(&out[i + k][c][0], col[k]);
+        }
+    }
+    for (; i < end; i++)
+        out[i] = computeMvp(i, vp);
+}
+
+void benchmarkTransformBatch() {
+    constexpr size_t count = 1024;
+    constexpr int iterations = 200;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    TransformBatch batch;
+    for (size_t i = 0; i < count; i++) {
+        auto rot = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+        batch.push(glm::vec3(dist(rng), dist(rng), dist(rng)) * 10.0f, rot, glm::vec3(dist(rng), dist(rng), dist(rng)) + 1.5f);
+    }
+    auto vp = glm::perspective(1.5f, 1.0f, 0.05f, 100.0f) * glm::lookAt(glm::vec3(0, 1.6f, 0), glm::vec3(0, 1.6f, -1), glm::vec3(0, 1, 0));
+
+    std::vector<glm::mat4> reference(count), batched(count);
+    auto time = [&](auto&& func) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+            func();
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+    double referenceUs = time([&] {
+        for (size_t i = 0; i < count; i++)
+            reference[i] = batch.computeMvp(i, vp);
+    });
+    double batchedUs = time([&] { batch.computeMvps(vp, batched.data()); });
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < count; i++)
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                maxError = std::max(maxError, std::abs(reference[i][c][r] - batched[i][c][r]));
+
+    std::cout << fmt::format("Transform batch: {} draws, glm {:.2f} us, batched {:.2f} us ({:.1f}x), max error {:g}",
+        count, referenceUs, batchedUs, referenceUs / batchedUs, maxError) << std::endl;
+}
@@ -0,0 +1,59 @@
+#ifndef TRANSFORM_BATCH_HPP
+#define TRANSFORM_BATCH_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "JobSystem.hpp"
+
+// Translation / rotation / scale of every draw of a view, stored as SoA.
+// computeMvps() turns all of them into vp * T * R * S at once, four draws per SIMD lane group,
+// in parts of mvpGrain draws on the jobs when it is given them.
+class TransformBatch {
+public:
+    static constexpr uint32_t mvpGrain = 1024;
+
+    void clear() {
+        for (auto* v : { &px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz })
+            v->clear();
+    }
+    // inline, it is called once per draw
+    uint32_t push(const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale) {
+        px.push_back(pos.x);
+        py.push_back(pos.y);
+        pz.push_back(pos.z);
+        qx.push_back(rot.x);
+        qy.push_back(rot.y);
+        qz.push_back(rot.z);
+        qw.push_back(rot.w);
+        sx.push_back(scale.x);
+        sy.push_back(scale.y);
+        sz.push_back(scale.z);
+        return uint32_t(px.size() - 1);
+    }
+    size_t size() const { return px.size(); }
+    glm::vec3 getPosition(size_t i) const { return glm::vec3(px[i], py[i], pz[i]); }
+    glm::quat getRotation(size_t i) const { return glm::quat(qw[i], qx[i], qy[i], qz[i]); }
+    glm::vec3 getScale(size_t i) const { return glm::vec3(sx[i], sy[i], sz[i]); }
+
+    // out must hold size() matrices
+    void computeMvps(const glm::mat4& vp, glm::mat4* out, JobSystem* jobs = nullptr) const;
+    // one matrix through glm, also used for the remainder of computeMvps()
+    glm::mat4 computeMvp(size_t index, const glm::mat4& vp) const;
+
+private:
+    // the draws [begin, end), begin at a lane group
+    void computeMvps(const glm::mat4& vp, glm::mat4* out, size_t begin, size_t end) const;
+
+    std::vector<float> px, py, pz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> sx, sy, sz;
+};
+
+// Compares computeMvps() with the glm path per draw and logs both timings.
+void benchmarkTransformBatch();
+
+#endif
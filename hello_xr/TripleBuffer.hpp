@@ -0,0 +1,42 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Hands values from one writer thread to one reader thread without either waiting for the other.
+// The writer fills back() and publishes it; the reader takes the newest published value with update()
+// and reads front() until its next update(). Values published in between are skipped, never torn.
+// The three slots are reused, so a T that keeps its capacity across frames does not allocate.
+template<typename T>
+class TripleBuffer {
+public:
+    T& back() { return slots[backIndex]; }
+    // back() becomes the newest value; the writer gets the slot that is neither it nor the reader's.
+    // True when the reader skipped the value published before, which back() then still holds.
+    bool publish() {
+        const uint8_t old = middle.exchange(uint8_t(backIndex | freshBit), std::memory_order_acq_rel);
+        backIndex = old & indexMask;
+        return (old & freshBit) != 0;
+    }
+
+    // false when nothing was published since the last update(), front() is then unchanged
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & freshBit))
+            return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+    const T& front() const { return slots[frontIndex]; }
+
+private:
+    static constexpr uint8_t indexMask = 3, freshBit = 4;
+
+    T slots[3];
+    // the slot between the two threads, with freshBit while the reader has not taken it
+    std::atomic<uint8_t> middle{ 1 };
+    uint8_t backIndex = 0;      // the writer's
+    uint8_t frontIndex = 2;     // the reader's
+};
+
+#endif
@@ -9,11 +9,15 @@
 #include <fmt/format.h>
 #include "pch.h"
 #include <array>
+#include <chrono>
 
 #include "xr_linear.h"
 #include "logger.h"
 #include "Game.hpp"
 #include "GraphicsManager_Vulkan.hpp"
+#include "NullGraphicsProvider.hpp"
+#include "SessionRecorder.hpp"
+#include "SimThread.hpp"
 #include "utils.hpp"
 
 #ifdef XR_USE_PLATFORM_ANDROID
@@ -148,6 +152,9 @@ class App
     xr::UniqueSession session;
 
     std::vector<Swapchain> swapchains;
+    std::vector<Swapchain> panelSwapchains;
+    int64_t swapchainFormat;
+    uint32_t maxLayerCount;
     xr::UniqueSpace appSpace;
     xr::UniqueSpace viewSpace;
     xr::UniqueSpace stageSpace;
@@ -157,10 +164,12 @@ class App
     struct HandActions {
         xr::UniqueAction pose;
         xr::UniqueAction trigger;
+        xr::UniqueAction menu;
         xr::UniqueAction haptics;
         xr::Path subActionPath[2];
         xr::UniqueSpace space[2];
     } handActions;
+    bool perfOverlay = false;
 
     //xr::UniqueActionSet trackerActionSet;
     //struct TrackerActions {
@@ -195,6 +204,10 @@ class App
     bool session_running = false;
 
     Game::GameData gameData;
+    std::optional<XrTime> lastDisplayTime;
+    std::optional<SessionRecorder> recorder;
+    // Game::proc() / Game::draw() on their own thread, a frame ahead of rendering. Destroyed before the recorder.
+    std::optional<SimThread> sim;
 
     void CreateInstance() {
         std::vector<const char*> layers = {};
@@ -230,6 +243,7 @@ class App
             throw std::runtime_error("system get error");
 
         auto props = instance->getSystemProperties(systemId);
+        maxLayerCount = props.graphicsProperties.maxLayerCount;
 
         std::cout << fmt::format("SystemID: {:X}, FormFactor: {}", this->systemId.get(), to_string(sysGetInfo.formFactor)) << std::endl;
         std::cout << fmt::format("SystemName: {}, vendorID: {:X}", props.systemName, props.vendorId) << std::endl;
@@ -294,6 +308,7 @@ class App
         auto swapchainFmtCnt = swapchainFmts.size();
 
         auto selectedSwapchainFmt = graphicsManager->chooseImageFormat(swapchainFmts);
+        swapchainFormat = selectedSwapchainFmt;
 
         std::cout << "Avilable Swapchain Format x" << swapchainFmtCnt << std::endl;
         for (int i = 0; const auto & swapchainFmt : swapchainFmts) {
@@ -326,6 +341,9 @@ class App
 
         this->views.resize(viewCnt);
 
+        // MSAA is resolved inside the render pass, so the swapchain itself is always single sampled
+        uint32_t msaaSampleCount = 1;
+
         std::cout << "View x" << viewCnt << std::endl;
 
         for (int i = 0; const auto & configView : configViews) {
@@ -343,7 +361,9 @@ class App
             createInfo.height = configView.recommendedImageRectHeight;
             createInfo.mipCount = 1;
             createInfo.faceCount = 1;
-            createInfo.sampleCount = configView.recommendedSwapchainSampleCount;
+            createInfo.sampleCount = 1;
+
+            msaaSampleCount = std::max(msaaSampleCount, configView.recommendedSwapchainSampleCount);
             createInfo.usageFlags = xr::SwapchainUsageFlagBits::ColorAttachment/* | xr::SwapchainUsageFlagBits::Sampled*/;
 
             Swapchain swapchain;
@@ -355,7 +375,42 @@ class App
 
             i++;
         }
-        graphicsManager->InitializeRenderTargets(swapchains, selectedSwapchainFmt);
+        msaaSampleCount = get_setting_int("msaa", msaaSampleCount);
+        graphicsManager->InitializeRenderTargets(swapchains, selectedSwapchainFmt, msaaSampleCount);
+    }
+
+    // Flat panels (title, score board) get their own swapchains and are submitted as quad layers,
+    // so the compositor samples them at display resolution instead of them being rendered per eye.
+    void CreatePanelSwapchains() {
+        if (get_setting_int("quad_layers", 0) == 0)
+            return;
+
+        auto extents = graphicsManager->getPanelExtents();
+        // one layer is taken by the projection layer
+        if (extents.size() + 1 > maxLayerCount) {
+            std::cout << fmt::format("Quad layers: {} panels, but only {} layers are supported", extents.size(), maxLayerCount) << std::endl;
+            extents.resize(maxLayerCount - 1);
+        }
+
+        for (const auto& extent : extents) {
+            xr::SwapchainCreateInfo createInfo{};
+            createInfo.arraySize = 1;
+            createInfo.format = swapchainFormat;
+            createInfo.width = extent.width;
+            createInfo.height = extent.height;
+            createInfo.mipCount = 1;
+            createInfo.faceCount = 1;
+            createInfo.sampleCount = 1;
+            createInfo.usageFlags = xr::SwapchainUsageFlagBits::ColorAttachment;
+
+            Swapchain swapchain;
+            swapchain.handle = session->createSwapchainUnique(createInfo);
+            swapchain.extent = extent;
+
+            panelSwapchains.emplace_back(std::move(swapchain));
+        }
+        std::cout << fmt::format("Quad layers: {} panels", panelSwapchains.size()) << std::endl;
+        graphicsManager->InitializePanelLayers(panelSwapchains, swapchainFormat);
     }
 
     void InitializeAction() {
@@ -414,6 +469,7 @@ class App
 
         DefineAction("hand_pose", "Hand Pose", xr::ActionType::PoseInput, handActions.pose);
         DefineAction("trigger", "Trigger", xr::ActionType::BooleanInput, handActions.trigger);
+        DefineAction("menu", "Menu", xr::ActionType::BooleanInput, handActions.menu);
         DefineAction("haptics", "Haptics", xr::ActionType::VibrationOutput, handActions.haptics);
         //DefineTrackerAction("tracker_pose", "Tracker Pose", xr::ActionType::PoseInput, trackerActions.pose);
         //DefineTrackerAction("tracker_haptics", "Tracker Haptics", xr::ActionType::VibrationOutput, trackerActions.haptics);
@@ -423,6 +479,8 @@ class App
                 { handActions.pose, "/user/hand/right/input/aim/pose" },
                 { handActions.trigger, "/user/hand/left/input/select/click" },
                 { handActions.trigger, "/user/hand/right/input/select/click" },
+                { handActions.menu, "/user/hand/left/input/menu/click" },
+                { handActions.menu, "/user/hand/right/input/menu/click" },
                 { handActions.haptics, "/user/hand/left/output/haptic" },
                 { handActions.haptics, "/user/hand/right/output/haptic" },
             });
@@ -431,6 +489,8 @@ class App
                 { handActions.pose, "/user/hand/right/input/aim/pose" },
                 { handActions.trigger, "/user/hand/left/input/trigger/click" },
                 { handActions.trigger, "/user/hand/right/input/trigger/click" },
+                { handActions.menu, "/user/hand/left/input/b/click" },
+                { handActions.menu, "/user/hand/right/input/b/click" },
                 { handActions.haptics, "/user/hand/left/output/haptic" },
                 { handActions.haptics, "/user/hand/right/output/haptic" },
             });
@@ -445,6 +505,8 @@ class App
                 { handActions.pose, "/user/hand/right/input/aim/pose" },
                 { handActions.trigger, "/user/hand/left/input/trigger/click" },
                 { handActions.trigger, "/user/hand/right/input/trigger/click" },
+                { handActions.menu, "/user/hand/left/input/menu/click" },
+                { handActions.menu, "/user/hand/right/input/menu/click" },
                 { handActions.haptics, "/user/hand/left/output/haptic" },
                 { handActions.haptics, "/user/hand/right/output/haptic" },
             });
@@ -453,6 +515,8 @@ class App
                 { handActions.pose, "/user/hand/right/input/aim/pose" },
                 { handActions.trigger, "/user/hand/left/input/squeeze/click" },
                 { handActions.trigger, "/user/hand/right/input/squeeze/click" },
+                { handActions.menu, "/user/hand/left/input/menu/click" },
+                { handActions.menu, "/user/hand/right/input/menu/click" },
                 { handActions.haptics, "/user/hand/left/output/haptic" },
                 { handActions.haptics, "/user/hand/right/output/haptic" },
             });
@@ -467,6 +531,8 @@ class App
                 { handActions.pose, "/user/hand/right/input/aim/pose" },
                 { handActions.trigger, "/user/hand/left/input/trigger/touch" },
                 { handActions.trigger, "/user/hand/right/input/trigger/touch" },
+                { handActions.menu, "/user/hand/left/input/menu/click" },
+                { handActions.menu, "/user/hand/right/input/b/click" },
                 { handActions.haptics, "/user/hand/left/output/haptic" },
                 { handActions.haptics, "/user/hand/right/output/haptic" },
             });
@@ -607,6 +673,16 @@ class App
 
         static bool oldState[2] = {};
 
+        // menu held on either hand turns the next trigger press into the performance overlay toggle
+        bool menuHeld = false;
+        for (int i = 0; i < 2; i++) {
+            xr::ActionStateGetInfo getInfo{};
+            getInfo.action = handActions.menu.get();
+            getInfo.subactionPath = handActions.subActionPath[i];
+            auto menuState = session->getActionStateBoolean(getInfo);
+            menuHeld = menuHeld || (menuState.isActive && menuState.currentState);
+        }
+
         for (int i = 0; i < 2; i++) {
             xr::ActionStateGetInfo getInfo{};
             getInfo.action = handActions.trigger.get();
@@ -623,7 +699,11 @@ class App
 
                 //XR_CHK_ERR(session->applyHapticFeedback(hapticActionInfo2, reinterpret_cast<XrHapticBaseHeader*>(&vibration)));
 
-                gameData.trigger[i] = true;
+                gameData.trigger[i] = !menuHeld;
+                if (menuHeld) {
+                    perfOverlay = !perfOverlay;
+                    graphicsManager->setPerfOverlay(perfOverlay);
+                }
             }
             else {
                 gameData.trigger[i] = false;
@@ -653,18 +733,17 @@ class App
         xr::FrameBeginInfo beginInfo{};
         XR_CHK_ERR(session->beginFrame(beginInfo));
 
-        constexpr auto max_layers_num = 1;
         constexpr auto max_views_num = 2;
 
-        std::array<xr::CompositionLayerBaseHeader*, max_layers_num> layers{};
+        std::vector<xr::CompositionLayerBaseHeader*> layers;
         xr::CompositionLayerProjection layer{};
         std::array<xr::CompositionLayerProjectionView, max_views_num> projectionViews{};
+        std::vector<xr::CompositionLayerQuad> quadLayers;
+        quadLayers.reserve(panelSwapchains.size());
 
         xr::FrameEndInfo endInfo;
         endInfo.displayTime = frameState.predictedDisplayTime;
         endInfo.environmentBlendMode = xr::EnvironmentBlendMode::Opaque;
-        endInfo.layerCount = 0;
-        endInfo.layers = layers.data();
 
         if (frameState.shouldRender) {
             xr::ViewLocateInfo locateInfo;
@@ -679,18 +758,44 @@ class App
             if (viewCountOutput != views.size())
                 throw std::runtime_error("Failed to locate views: viewCountOutput != views.size()");
 
+            // the time since the last rendered frame, so that the game catches up on missed frames
+            const double displayPeriod = (long double)(frameState.predictedDisplayPeriod.get()) / 1'000'000'000;
+            const XrTime displayTime = frameState.predictedDisplayTime.get();
+            gameData.dt = lastDisplayTime ? (long double)(displayTime - lastDisplayTime.value()) / 1'000'000'000 : displayPeriod;
+            lastDisplayTime = displayTime;
+
+            // the simulation thread works on the next frame, so it gets the poses predicted for that one
+            const xr::Time poseTime = sim ? xr::Time(displayTime + frameState.predictedDisplayPeriod.get()) : frameState.predictedDisplayTime;
             for (int i = 0; i < 2; i++) {
-                gameData.handPoses[i] = SpaceToPose(handActions.space[i].get(), appSpace.get(), frameState.predictedDisplayTime);
+                gameData.handPoses[i] = SpaceToPose(handActions.space[i].get(), appSpace.get(), poseTime);
             }
 
-            gameData.viewPose = SpaceToPose(viewSpace.get(), appSpace.get(), frameState.predictedDisplayTime);
-            gameData.stagePose = SpaceToPose(stageSpace.get(), appSpace.get(), frameState.predictedDisplayTime);
+            gameData.viewPose = SpaceToPose(viewSpace.get(), appSpace.get(), poseTime);
+            gameData.stagePose = SpaceToPose(stageSpace.get(), appSpace.get(), poseTime);
 
             //renderDat.track = SpaceToPose(trackerActions.space.get(), appSpace.get(), frameState.predictedDisplayTime);
 
-            gameData.dt = (long double)(frameState.predictedDisplayPeriod.get()) / 1'000'000'000;
-
-            Game::proc(gameData);
+            if (sim) {
+                // what was simulated for this frame during the last one, taken before the next frame is started on
+                bool fresh;
+                const auto& snapshot = sim->acquire(fresh);
+                graphicsManager->setRenderSnapshot(&snapshot);
+                // requested while simulating it, applied here with the other calls on the session
+                if (fresh) {
+                    for (const auto& haptic : snapshot.getHaptics())
+                        handVibProvider[haptic.hand]->vibrate(haptic.amplitude);
+                }
+                graphicsManager->reportSimTime(snapshot.simMs, displayPeriod * 1000);
+                sim->submit(gameData);
+            }
+            else {
+                auto simStart = std::chrono::steady_clock::now();
+                Game::proc(gameData);
+                graphicsManager->reportSimTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - simStart).count(), displayPeriod * 1000);
+                if (recorder)
+                    recorder->write(gameData, Game::stateHash());
+            }
+            graphicsManager->update(displayPeriod);
 
             for (uint32_t i = 0; const auto & _ : swapchains) {
                 const auto& swapchain = swapchains[i].handle;
@@ -721,45 +826,114 @@ class App
             layer.layerFlags = {};
             layer.viewCount = swapchains.size();
             layer.views = projectionViews.data();
-            layers[endInfo.layerCount++] = reinterpret_cast<xr::CompositionLayerBaseHeader*>(&layer);
+            layers.push_back(reinterpret_cast<xr::CompositionLayerBaseHeader*>(&layer));
+
+            // panel content is only re-rendered when it changed; otherwise the last released image is composited again
+            for (int i = 0; i < int(panelSwapchains.size()); i++) {
+                auto state = graphicsManager->getPanelLayerState(i);
+                if (!state.visible)
+                    continue;
+
+                const auto& swapchain = panelSwapchains[i].handle;
+                if (state.dirty) {
+                    xr::SwapchainImageAcquireInfo acquireInfo;
+                    auto imageIndex = swapchain->acquireSwapchainImage(acquireInfo);
+
+                    xr::SwapchainImageWaitInfo waitInfo;
+                    waitInfo.timeout = xr::Duration::infinite();
+                    swapchain->waitSwapchainImage(waitInfo);
+
+                    graphicsManager->renderPanelLayer(i, imageIndex);
+
+                    xr::SwapchainImageReleaseInfo releaseInfo;
+                    swapchain->releaseSwapchainImage(releaseInfo);
+                    quadLayerCounter.rendered++;
+                }
+
+                xr::CompositionLayerQuad quad{};
+                quad.layerFlags = xr::CompositionLayerFlagBits::BlendTextureSourceAlpha;
+                quad.space = appSpace.get();
+                quad.eyeVisibility = xr::EyeVisibility::Both;
+                quad.subImage.swapchain = swapchain.get();
+                quad.subImage.imageRect.offset = xr::Offset2Di{ 0, 0 };
+                quad.subImage.imageRect.extent = panelSwapchains[i].extent;
+                quad.pose = state.pose;
+                quad.size = state.size;
+                quadLayers.push_back(quad);
+                layers.push_back(reinterpret_cast<xr::CompositionLayerBaseHeader*>(&quadLayers.back()));
+                quadLayerCounter.submitted++;
+            }
         }
 
+        endInfo.layerCount = layers.size();
+        endInfo.layers = layers.data();
         session->endFrame(endInfo);
     }
 
     int cnt = 0;
 
+    // with debug.hello_xr.frames, the session is ended after that many rendered frames
+    const int frameLimit = get_setting_int("frames", 0);
+    int renderedFrames = 0;
+    struct QuadLayerCounter {
+        uint64_t submitted = 0;
+        uint64_t rendered = 0;
+    } quadLayerCounter;
+
+#ifdef XR_USE_PLATFORM_ANDROID
     bool* pResumed = nullptr;
     android_app* pAndroidApp = nullptr;
+#endif
+
+    // breadcrumbs in logcat while the app starts up
+    static void startupMark(const char* mark) {
+#ifdef XR_USE_PLATFORM_ANDROID
+        __android_log_write(ANDROID_LOG_INFO, "mylog", mark);
+#endif
+    }
 
 public:
+#ifdef XR_USE_PLATFORM_ANDROID
     void setAndroidSettings(bool* _pResumed, android_app* _pAndroidApp){
         pResumed = _pResumed;
         pAndroidApp = _pAndroidApp;
+        setDataPath(pAndroidApp->activity->internalDataPath);
+    }
+#endif
+
+    void setDataPath(const std::filesystem::path& dataPath) {
+        // adb shell setprop debug.hello_xr.record 1, then
+        // adb exec-out run-as com.khronos.hello_xr cat files/session.rec > session.rec
+        if (get_setting_int("record", 0) != 0)
+            recorder.emplace(dataPath / "session.rec", Game::getSessionConfig());
+        // adb shell setprop debug.hello_xr.sim_thread 1
+        if (get_setting_int("sim_thread", 0) != 0)
+            sim.emplace(recorder ? &recorder.value() : nullptr);
     }
 
     App(void* instanceCreateNext = nullptr) : instanceCreateNext(instanceCreateNext) {
         showPlatformInfo();
-        __android_log_write(ANDROID_LOG_INFO, "mylog", "aa");
+        startupMark("aa");
         CreateInstance();
-        __android_log_write(ANDROID_LOG_INFO, "mylog", "bb");
+        startupMark("bb");
         InitializeSystem();
-        __android_log_write(ANDROID_LOG_INFO, "mylog", "cc");
+        startupMark("cc");
         graphicsManager = CreateGraphicsManager_Vulkan(instance.get(), systemId);
-        __android_log_write(ANDROID_LOG_INFO, "mylog", "dd");
+        startupMark("dd");
 
         InitializeSession();
-        __android_log_write(ANDROID_LOG_INFO, "mylog", "ee");
+        startupMark("ee");
         InitializeAction();
-        __android_log_write(ANDROID_LOG_INFO, "mylog", "ff");
+        startupMark("ff");
         CreateSwapchain();
-        __android_log_write(ANDROID_LOG_INFO, "mylog", "gg");
+        startupMark("gg");
 
         CreateReferenceSpace();
-        __android_log_write(ANDROID_LOG_INFO, "mylog", "hh");
+        startupMark("hh");
 
         graphicsManager->PrepareResources();
-        __android_log_write(ANDROID_LOG_INFO, "mylog", "ii");
+        startupMark("ii");
+        CreatePanelSwapchains();
     }
 
     void MainLoop() {
@@ -786,6 +960,11 @@ public:
             if (session_running) {
                 PollAction();
                 RenderFrame();
+                if (frameLimit > 0 && ++renderedFrames == frameLimit) {
+                    std::cout << fmt::format("{} frames rendered, {} quad layers submitted, {} panel images rendered",
+                        renderedFrames, quadLayerCounter.submitted, quadLayerCounter.rendered) << std::endl;
+                    session->requestExitSession();
+                }
             }
             else {
                 std::this_thread::sleep_for(std::chrono::milliseconds(250));
@@ -969,10 +1148,20 @@ void android_main(struct android_app* app) {
         instanceCreateInfoAndroid.applicationVM = app->activity->vm;
         instanceCreateInfoAndroid.applicationActivity = app->activity->clazz;
 
-        App myapp{&instanceCreateInfoAndroid};
-        myapp.setAndroidSettings(&(appState.Resumed), app);
+        // replays files/session.rec without a session or GPU, then exits:
+        // adb shell setprop debug.hello_xr.replay 1. The frame times go to files/session.rec.csv
+        if (get_setting_int("replay", 0) != 0) {
+            std::filesystem::path dataPath = app->activity->internalDataPath;
+            NullGraphicsProvider provider;
+            Game::init(provider);
+            replaySession(SessionRecording::load(dataPath / "session.rec"), provider, dataPath / "session.rec.csv");
+        }
+        else {
+            App myapp{&instanceCreateInfoAndroid};
+            myapp.setAndroidSettings(&(appState.Resumed), app);
 
-        myapp.MainLoop();
+            myapp.MainLoop();
+        }
 
 
 //        {
@@ -991,4 +1180,23 @@ void android_main(struct android_app* app) {
         Log::Write(Log::Level::Error, "Unknown Error");
     }
 }
+#else
+
+// Desktop build (desktop/CMakeLists.txt), to run the app against a runtime without a headset,
+// such as Monado with its null compositor. The settings are read from HELLO_XR_<NAME>.
+int main() {
+    try {
+        // recordings go to the directory the app was started in, the assets are read from the build
+        const auto dataPath = std::filesystem::current_path();
+        std::filesystem::current_path(HELLO_XR_ASSET_DIR);
+
+        App myapp;
+        myapp.setDataPath(dataPath);
+        myapp.MainLoop();
+    } catch (const std::exception& ex) {
+        Log::Write(Log::Level::Error, ex.what());
+        return 1;
+    }
+    return 0;
+}
 #endif
@@ -0,0 +1,171 @@
+#pragma once
+
+// Minimal 4-wide float vector for the CPU kernels.
+// NEON on arm64 (the headset), SSE on x86, and a scalar fallback with identical results.
+// fmadd() rounds the product before the add, as glm does, so that the kernels match their glm
+// references; the files using this header are built with -ffp-contract=off for the same reason.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE 1
+#endif
+
+namespace simd {
+
+#if defined(SIMD_NEON)
+
+struct f4 {
+    float32x4_t v;
+};
+struct m4 {
+    uint32x4_t v;
+};
+
+inline f4 load(const float* p) { return { vld1q_f32(p) }; }
+inline void store(float* p, f4 a) { vst1q_f32(p, a.v); }
+inline f4 set1(float a) { return { vdupq_n_f32(a) }; }
+inline f4 set(float a, float b, float c, float d) {
+    alignas(16) float tmp[4] = { a, b, c, d };
+    return { vld1q_f32(tmp) };
+}
+
+inline f4 operator+(f4 a, f4 b) { return { vaddq_f32(a.v, b.v) }; }
+inline f4 operator-(f4 a, f4 b) { return { vsubq_f32(a.v, b.v) }; }
+inline f4 operator*(f4 a, f4 b) { return { vmulq_f32(a.v, b.v) }; }
+inline f4 operator/(f4 a, f4 b) { return { vdivq_f32(a.v, b.v) }; }
+inline f4 sqrt(f4 a) { return { vsqrtq_f32(a.v) }; }
+inline f4 abs(f4 a) { return { vabsq_f32(a.v) }; }
+inline f4 min(f4 a, f4 b) { return { vminq_f32(a.v, b.v) }; }
+inline f4 max(f4 a, f4 b) { return { vmaxq_f32(a.v, b.v) }; }
+inline f4 fmadd(f4 a, f4 b, f4 c) { return { vaddq_f32(vmulq_f32(a.v, b.v), c.v) }; }
+
+inline m4 operator<(f4 a, f4 b) { return { vcltq_f32(a.v, b.v) }; }
+inline m4 operator<=(f4 a, f4 b) { return { vcleq_f32(a.v, b.v) }; }
+inline m4 operator>(f4 a, f4 b) { return { vcgtq_f32(a.v, b.v) }; }
+inline m4 operator>=(f4 a, f4 b) { return { vcgeq_f32(a.v, b.v) }; }
+inline m4 operator&(m4 a, m4 b) { return { vandq_u32(a.v, b.v) }; }
+inline m4 operator|(m4 a, m4 b) { return { vorrq_u32(a.v, b.v) }; }
+
+// a where mask is set, b otherwise
+inline f4 select(m4 mask, f4 a, f4 b) { return { vbslq_f32(mask.v, a.v, b.v) }; }
+inline bool any(m4 mask) { return vmaxvq_u32(mask.v) != 0; }
+inline bool all(m4 mask) { return vminvq_u32(mask.v) != 0; }
+inline int bits(m4 mask) {
+    alignas(16) uint32_t tmp[4];
+    vst1q_u32(tmp, mask.v);
+    return (tmp[0] & 1) | (tmp[1] & 2) | (tmp[2] & 4) | (tmp[3] & 8);
+}
+
+// rows a, b, c, d become columns
+inline void transpose(f4& a, f4& b, f4& c, f4& d) {
+    float32x4x2_t ab = vtrnq_f32(a.v, b.v);
+    float32x4x2_t cd = vtrnq_f32(c.v, d.v);
+    a.v = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b.v = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+#elif defined(SIMD_SSE)
+
+struct f4 {
+    __m128 v;
+};
+struct m4 {
+    __m128 v;
+};
+
+inline f4 load(const float* p) { return { _mm_loadu_ps(p) }; }
+inline void store(float* p, f4 a) { _mm_storeu_ps(p, a.v); }
+inline f4 set1(float a) { return { _mm_set1_ps(a) }; }
+inline f4 set(float a, float b, float c, float d) { return { _mm_setr_ps(a, b, c, d) }; }
+
+inline f4 operator+(f4 a, f4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline f4 operator-(f4 a, f4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline f4 operator*(f4 a, f4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline f4 operator/(f4 a, f4 b) { return { _mm_div_ps(a.v, b.v) }; }
+inline f4 sqrt(f4 a) { return { _mm_sqrt_ps(a.v) }; }
+inline f4 abs(f4 a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+inline f4 min(f4 a, f4 b) { return { _mm_min_ps(a.v, b.v) }; }
+inline f4 max(f4 a, f4 b) { return { _mm_max_ps(a.v, b.v) }; }
+inline f4 fmadd(f4 a, f4 b, f4 c) { return { _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v) }; }
+
+inline m4 operator<(f4 a, f4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline m4 operator<=(f4 a, f4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline m4 operator>(f4 a, f4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline m4 operator>=(f4 a, f4 b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline m4 operator&(m4 a, m4 b) { return { _mm_and_ps(a.v, b.v) }; }
+inline m4 operator|(m4 a, m4 b) { return { _mm_or_ps(a.v, b.v) }; }
+
+inline f4 select(m4 mask, f4 a, f4 b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+inline bool any(m4 mask) { return _mm_movemask_ps(mask.v) != 0; }
+inline bool all(m4 mask) { return _mm_movemask_ps(mask.v) == 0xf; }
+inline int bits(m4 mask) { return _mm_movemask_ps(mask.v); }
+
+inline void transpose(f4& a, f4& b, f4& c, f4& d) { _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v); }
+
+#else
+
+struct f4 {
+    float v[4];
+};
+struct m4 {
+    bool v[4];
+};
+
+inline f4 load(const float* p) { return { p[0], p[1], p[2], p[3] }; }
+inline void store(float* p, f4 a) { std::memcpy(p, a.v, sizeof(a.v)); }
+inline f4 set1(float a) { return { a, a, a, a }; }
+inline f4 set(float a, float b, float c, float d) { return { a, b, c, d }; }
+
+#define SIMD_SCALAR_OP(ret, name, expr) \
+    inline ret name(f4 a, f4 b) { ret r; for (int i = 0; i < 4; i++) r.v[i] = (expr); return r; }
+SIMD_SCALAR_OP(f4, operator+, a.v[i] + b.v[i])
+SIMD_SCALAR_OP(f4, operator-, a.v[i] - b.v[i])
+SIMD_SCALAR_OP(f4, operator*, a.v[i] * b.v[i])
+SIMD_SCALAR_OP(f4, operator/, a.v[i] / b.v[i])
+SIMD_SCALAR_OP(f4, min, std::min(a.v[i], b.v[i]))
+SIMD_SCALAR_OP(f4, max, std::max(a.v[i], b.v[i]))
+SIMD_SCALAR_OP(m4, operator<, a.v[i] < b.v[i])
+SIMD_SCALAR_OP(m4, operator<=, a.v[i] <= b.v[i])
+SIMD_SCALAR_OP(m4, operator>, a.v[i] > b.v[i])
+SIMD_SCALAR_OP(m4, operator>=, a.v[i] >= b.v[i])
+#undef SIMD_SCALAR_OP
+
+inline f4 fmadd(f4 a, f4 b, f4 c) { return a * b + c; }
+inline f4 sqrt(f4 a) { return { std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3]) }; }
+inline f4 abs(f4 a) { return { std::abs(a.v[0]), std::abs(a.v[1]), std::abs(a.v[2]), std::abs(a.v[3]) }; }
+inline m4 operator&(m4 a, m4 b) { return { a.v[0] && b.v[0], a.v[1] && b.v[1], a.v[2] && b.v[2], a.v[3] && b.v[3] }; }
+inline m4 operator|(m4 a, m4 b) { return { a.v[0] || b.v[0], a.v[1] || b.v[1], a.v[2] || b.v[2], a.v[3] || b.v[3] }; }
+
+inline f4 select(m4 mask, f4 a, f4 b) {
+    f4 r;
+    for (int i = 0; i < 4; i++)
+        r.v[i] = mask.v[i] ? a.v[i] : b.v[i];
+    return r;
+}
+inline int bits(m4 mask) { return mask.v[0] | (mask.v[1] << 1) | (mask.v[2] << 2) | (mask.v[3] << 3); }
+inline bool any(m4 mask) { return bits(mask) != 0; }
+inline bool all(m4 mask) { return bits(mask) == 0xf; }
+
+inline void transpose(f4& a, f4& b, f4& c, f4& d) {
+    f4 r[4] = { a, b, c, d };
+    for (int i = 0; i < 4; i++) {
+        a.v[i] = r[i].v[0];
+        b.v[i] = r[i].v[1];
+        c.v[i] = r[i].v[2];
+        d.v[i] = r[i].v[3];
+    }
+}
+
+#endif
+
+}
@@ -3,12 +3,18 @@
 #include <filesystem>
 #include <fstream>
 #include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cctype>
 #ifdef XR_USE_PLATFORM_ANDROID
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
-#endif
+#include <sys/system_properties.h>
 
 extern AAssetManager* asset_manager;
+#endif
 
 inline auto file_get_contents(std::filesystem::path path) {
 #ifdef XR_USE_PLATFORM_ANDROID
@@ -31,3 +37,21 @@ inline auto file_get_contents(std::filesystem::path path) {
     return data;
 #endif
 }
+
+inline int get_setting_int(const char* name, int defaultValue) {
+#ifdef XR_USE_PLATFORM_ANDROID
+    // adb shell setprop debug.hello_xr.<name> <value>
+    auto propName = std::string("debug.hello_xr.") + name;
+    char value[PROP_VALUE_MAX] = {};
+    if (__system_property_get(propName.c_str(), value) > 0)
+        return std::atoi(value);
+    return defaultValue;
+#else
+    auto envName = std::string("HELLO_XR_") + name;
+    for (auto& c : envName)
+        c = std::toupper(c);
+    if (auto value = std::getenv(envName.c_str()))
+        return std::atoi(value);
+    return defaultValue;
+#endif
+}
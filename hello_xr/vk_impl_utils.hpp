@@ -1,5 +1,6 @@
 #pragma once
 
+#include <unordered_map>
 #include <stb_image.h>
 #include <fmt/format.h>
 
@@ -14,21 +15,116 @@ struct PushConstantData {
 //    glm::vec3 lightDir;
 };
 
+// per-instance model transform of shader_pose.vert; glm::quat is stored as x, y, z, w
+struct InstancePose {
+    glm::vec3 pos;
+    glm::quat rot;
+    glm::vec3 scale;
+};
+static_assert(sizeof(InstancePose) == 40);
+
+// VK_EXT_debug_utils: validation messages, object names and command buffer labels.
+// Every call is a no-op until init() succeeded, so the names are only built by callers that check isEnabled().
+class DebugUtils {
+    vk::Instance instance;
+    VkDebugUtilsMessengerEXT messenger = VK_NULL_HANDLE;
+    PFN_vkDestroyDebugUtilsMessengerEXT destroyMessenger = nullptr;
+    PFN_vkSetDebugUtilsObjectNameEXT setObjectName = nullptr;
+    PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginLabel = nullptr;
+    PFN_vkCmdEndDebugUtilsLabelEXT cmdEndLabel = nullptr;
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT types,
+        const VkDebugUtilsMessengerCallbackDataEXT* data, void* userData) {
+        std::cout << fmt::format("Vulkan {}: {}", severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT ? "error" : "warning", data->pMessage) << std::endl;
+        return VK_FALSE;
+    }
+
+public:
+    DebugUtils() = default;
+    DebugUtils(const DebugUtils&) = delete;
+    DebugUtils& operator=(const DebugUtils&) = delete;
+    ~DebugUtils() {
+        if (messenger)
+            destroyMessenger(instance, messenger, nullptr);
+    }
+
+    // the instance must have been created with VK_EXT_debug_utils
+    void init(vk::Instance _instance) {
+        instance = _instance;
+        auto getProc = [&](const char* name) { return vkGetInstanceProcAddr(instance, name); };
+        auto createMessenger = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(getProc("vkCreateDebugUtilsMessengerEXT"));
+        destroyMessenger = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(getProc("vkDestroyDebugUtilsMessengerEXT"));
+        setObjectName = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(getProc("vkSetDebugUtilsObjectNameEXT"));
+        cmdBeginLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(getProc("vkCmdBeginDebugUtilsLabelEXT"));
+        cmdEndLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(getProc("vkCmdEndDebugUtilsLabelEXT"));
+        if (!createMessenger || !destroyMessenger || !setObjectName || !cmdBeginLabel || !cmdEndLabel) {
+            setObjectName = nullptr;
+            cmdBeginLabel = nullptr;
+            cmdEndLabel = nullptr;
+            std::cout << "VK_EXT_debug_utils functions are not available" << std::endl;
+            return;
+        }
+
+        VkDebugUtilsMessengerCreateInfoEXT createInfo{ VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT };
+        createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        createInfo.pfnUserCallback = callback;
+        auto result = createMessenger(instance, &createInfo, nullptr, &messenger);
+        if (result != VK_SUCCESS)
+            throw std::runtime_error(fmt::format("Vulkan Debug Messenger Creation Error: {}", to_string(vk::Result(result))));
+    }
+
+    bool isEnabled() const {
+        return setObjectName != nullptr;
+    }
+
+    template<typename T>
+    void setName(vk::Device device, T handle, const std::string& name) const {
+        if (!setObjectName)
+            return;
+        VkDebugUtilsObjectNameInfoEXT info{ VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT };
+        info.objectType = VkObjectType(T::objectType);
+        info.objectHandle = uint64_t(static_cast<typename T::CType>(handle));
+        info.pObjectName = name.c_str();
+        setObjectName(device, &info);
+    }
+
+    void beginLabel(const vk::CommandBuffer cmdBuf, const char* name) const {
+        if (!cmdBeginLabel)
+            return;
+        VkDebugUtilsLabelEXT label{ VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT };
+        label.pLabelName = name;
+        cmdBeginLabel(cmdBuf, &label);
+    }
+    void endLabel(const vk::CommandBuffer cmdBuf) const {
+        if (cmdEndLabel)
+            cmdEndLabel(cmdBuf);
+    }
+};
+
 class Allocator {
     const vk::Device device;
     const vk::PhysicalDeviceMemoryProperties props;
 
-    uint32_t findSuitableMemory(vk::MemoryRequirements memReq, vk::MemoryPropertyFlags flag) const {
+    std::optional<uint32_t> findMemoryType(vk::MemoryRequirements memReq, vk::MemoryPropertyFlags flag) const {
         for (uint32_t i = 0; i < props.memoryTypeCount; i++) {
             if (((memReq.memoryTypeBits >> i) & 1) &&
                 (props.memoryTypes[i].propertyFlags & flag) == flag) {
                 return i;
             }
         }
+        return std::nullopt;
+    }
+    uint32_t findSuitableMemory(vk::MemoryRequirements memReq, vk::MemoryPropertyFlags flag) const {
+        if (auto index = findMemoryType(memReq, flag))
+            return index.value();
         throw std::runtime_error("Could not find suitable memory type");
     }
 public:
     Allocator(const vk::Device& _device, vk::PhysicalDevice physDevice) : device(_device), props(physDevice.getMemoryProperties()) {}
+    bool supports(vk::MemoryRequirements memReq, vk::MemoryPropertyFlags flag) const {
+        return findMemoryType(memReq, flag).has_value();
+    }
     auto allocate(vk::MemoryRequirements memReq, vk::MemoryPropertyFlags flag = {}) const {
         vk::MemoryAllocateInfo allocInfo;
         allocInfo.allocationSize = memReq.size;
@@ -127,7 +223,7 @@ public:
 
         vk::MappedMemoryRange range;
         range.memory = mem.get();
-        range.offset = 0;
+        range.offset = offset;
         range.size = dataSize;
         device.flushMappedMemoryRanges({ range });
 
@@ -184,7 +280,8 @@ class Image {
     vk::Format format;
 public:
     Image(vk::Device device, const Allocator& allocator, vk::Extent3D _extent, vk::Format _format, vk::ImageUsageFlags usage = {},
-        vk::MemoryPropertyFlags memProps = vk::MemoryPropertyFlagBits::eDeviceLocal, vk::SharingMode share = vk::SharingMode::eExclusive)
+        vk::MemoryPropertyFlags memProps = vk::MemoryPropertyFlagBits::eDeviceLocal, vk::SharingMode share = vk::SharingMode::eExclusive,
+        vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1)
         : extent(_extent), format(_format)
     {
         vk::ImageCreateInfo createInfo;
@@ -195,13 +292,20 @@ public:
         createInfo.format = format;
         createInfo.tiling = vk::ImageTiling::eOptimal;
         createInfo.initialLayout = vk::ImageLayout::eUndefined;
-        createInfo.usage = usage | vk::ImageUsageFlagBits::eTransferDst;
+        createInfo.usage = usage;
+        // transient attachments may only be used as attachments
+        if (!(usage & vk::ImageUsageFlagBits::eTransientAttachment))
+            createInfo.usage |= vk::ImageUsageFlagBits::eTransferDst;
         createInfo.sharingMode = share;
-        createInfo.samples = vk::SampleCountFlagBits::e1;
+        createInfo.samples = samples;
         image = device.createImageUnique(createInfo);
 
         auto memReq = device.getImageMemoryRequirements(image.get());
 
+        // lazily allocated memory is optional (mostly tile-based GPUs), fall back to plain device local memory
+        if ((memProps & vk::MemoryPropertyFlagBits::eLazilyAllocated) && !allocator.supports(memReq, memProps))
+            memProps &= ~vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eLazilyAllocated);
+
         mem = allocator.allocate(memReq, memProps);
         device.bindImageMemory(image.get(), mem.get(), 0);
     }
@@ -289,8 +393,8 @@ class TextureImage {
             }
             });
     }
-    void CreateImage(const vk::Device device, const Allocator& allocator, const vk::Extent3D extent) {
-        image.emplace(device, allocator, extent, vk::Format::eR8G8B8A8Srgb, vk::ImageUsageFlagBits::eSampled);
+    void CreateImage(const vk::Device device, const Allocator& allocator, const vk::Extent3D extent, vk::Format format = vk::Format::eR8G8B8A8Srgb) {
+        image.emplace(device, allocator, extent, format, vk::ImageUsageFlagBits::eSampled);
     }
     void CreateImageView(const vk::Device device) {
         imageView = image->CreateImageView(device);
@@ -317,13 +421,14 @@ public:
         CopyFromBuffer(device, cmdBuf, queue, staging, extent);
         CreateImageView(device);
     }
-    TextureImage(vk::Device device, const Allocator& allocator, CommandBuffer& cmdBuf, vk::Queue queue, vk::Extent3D extent, const std::vector<std::byte>& imgData, vk::SharingMode share = vk::SharingMode::eExclusive)
+    TextureImage(vk::Device device, const Allocator& allocator, CommandBuffer& cmdBuf, vk::Queue queue, vk::Extent3D extent, const std::vector<std::byte>& imgData, vk::SharingMode share = vk::SharingMode::eExclusive,
+        vk::Format format = vk::Format::eR8G8B8A8Srgb)
     {
         vk::DeviceSize size = imgData.size();
         Buffer staging{ device, allocator, size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible };
         staging.paste(imgData.data(), size);
 
-        CreateImage(device, allocator, extent);
+        CreateImage(device, allocator, extent, format);
         CopyFromBuffer(device, cmdBuf, queue, staging, extent);
         CreateImageView(device);
     }
@@ -338,34 +443,180 @@ public:
     }
 };
 
+// Samplers shared by everything created with the same parameters, looked up by a hash of the create info.
+// Create infos with a pNext chain are not supported.
+class SamplerCache {
+    vk::Device device;
+    std::unordered_map<size_t, std::vector<std::pair<vk::SamplerCreateInfo, vk::UniqueSampler>>> samplers;
+    size_t count = 0;
+
+    static size_t hash(const vk::SamplerCreateInfo& info) {
+        size_t seed = 0;
+        auto combine = [&](auto value) {
+            seed ^= std::hash<decltype(value)>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        };
+        combine(static_cast<uint32_t>(info.flags));
+        combine(uint32_t(info.magFilter));
+        combine(uint32_t(info.minFilter));
+        combine(uint32_t(info.mipmapMode));
+        combine(uint32_t(info.addressModeU));
+        combine(uint32_t(info.addressModeV));
+        combine(uint32_t(info.addressModeW));
+        combine(info.mipLodBias);
+        combine(uint32_t(info.anisotropyEnable));
+        combine(info.maxAnisotropy);
+        combine(uint32_t(info.compareEnable));
+        combine(uint32_t(info.compareOp));
+        combine(info.minLod);
+        combine(info.maxLod);
+        combine(uint32_t(info.borderColor));
+        combine(uint32_t(info.unnormalizedCoordinates));
+        return seed;
+    }
+
+public:
+    explicit SamplerCache(vk::Device _device) : device(_device) {}
+
+    vk::Sampler get(const vk::SamplerCreateInfo& createInfo) {
+        auto& bucket = samplers[hash(createInfo)];
+        for (const auto& [info, sampler] : bucket) {
+            if (info == createInfo)
+                return sampler.get();
+        }
+        bucket.emplace_back(createInfo, device.createSamplerUnique(createInfo));
+        count++;
+        return bucket.back().second.get();
+    }
+
+    size_t size() const {
+        return count;
+    }
+};
+
+// Descriptor sets that all need the same descriptors (sizesPerSet), allocated from shared pools.
+// A full pool is followed by one twice its size, so the pool count grows with the log of the set count.
+// Freed sets are returned to their pool, but their space is only reused by the driver, not counted here.
+class DescriptorAllocator {
+    vk::Device device;
+    std::vector<vk::DescriptorPoolSize> sizesPerSet;
+    std::vector<vk::UniqueDescriptorPool> pools;
+    uint32_t nextCapacity;
+    uint32_t setsLeft = 0;      // in pools.back()
+
+    void grow(uint32_t minSets) {
+        uint32_t capacity = std::max(nextCapacity, minSets);
+        nextCapacity = capacity * 2;
+
+        auto poolSizes = sizesPerSet;
+        for (auto& size : poolSizes)
+            size.descriptorCount *= capacity;
+
+        vk::DescriptorPoolCreateInfo poolCreateInfo;
+        poolCreateInfo.poolSizeCount = poolSizes.size();
+        poolCreateInfo.pPoolSizes = poolSizes.data();
+        poolCreateInfo.maxSets = capacity;
+        poolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        pools.push_back(device.createDescriptorPoolUnique(poolCreateInfo));
+        setsLeft = capacity;
+    }
+
+public:
+    DescriptorAllocator(vk::Device _device, std::vector<vk::DescriptorPoolSize> _sizesPerSet, uint32_t initialCapacity = 16)
+        : device(_device), sizesPerSet(std::move(_sizesPerSet)), nextCapacity(initialCapacity) {}
+
+    std::vector<vk::UniqueDescriptorSet> allocate(vk::DescriptorSetLayout layout, uint32_t count) {
+        if (count == 0)
+            return {};
+        if (count > setsLeft)
+            grow(count);
+
+        std::vector<vk::DescriptorSetLayout> layouts(count, layout);
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.descriptorPool = pools.back().get();
+        allocInfo.descriptorSetCount = layouts.size();
+        allocInfo.pSetLayouts = layouts.data();
+        setsLeft -= count;
+        return device.allocateDescriptorSetsUnique(allocInfo);
+    }
+
+    size_t getPoolCount() const {
+        return pools.size();
+    }
+};
+
+// VK_KHR_dynamic_rendering commands; they are not exported by the loader
+struct DynamicRenderingCommands {
+    PFN_vkCmdBeginRenderingKHR beginRendering;
+    PFN_vkCmdEndRenderingKHR endRendering;
+
+    explicit DynamicRenderingCommands(vk::Device device) {
+        beginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(device.getProcAddr("vkCmdBeginRenderingKHR"));
+        endRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(device.getProcAddr("vkCmdEndRenderingKHR"));
+        if (!beginRendering || !endRendering)
+            throw std::runtime_error("VK_KHR_dynamic_rendering commands are not available");
+    }
+};
+
+enum class PipelineVariant {
+    Opaque,         // depth test + write
+    DepthOnly,      // depth prepass, no color output
+    AfterPrepass,   // color pass over a depth buffer filled by DepthOnly
+    Particles,      // instanced particles, per-instance data from storage buffers (set 1)
+    Panel,          // textured quad of an offscreen panel, alpha tested
+    Text,           // instanced SDF glyph quads, alpha blended
+};
+
 class RenderProc {
     const vk::Device device;
     const vk::Format format;
+    const vk::SampleCountFlagBits samples;
 
     ShaderModule vertShader, fragShader;
-
-    vk::UniqueRenderPass renderpass;
+    // vertex pulling: positions / normals / uvs are fetched from storage buffers (set 1)
+    std::optional<ShaderModule> pullVertShader;
+    std::optional<ShaderModule> poseVertShader;
+    std::optional<ShaderModule> particleVertShader;
+    std::optional<ShaderModule> panelVertShader, panelFragShader;
+    std::optional<ShaderModule> textVertShader, textFragShader;
+
+    vk::UniqueRenderPass renderpass;    // null with dynamic rendering
+    std::optional<DynamicRenderingCommands> dynamicRendering;
     vk::UniqueDescriptorSetLayout descSetLayout;
+    vk::UniqueDescriptorSetLayout geometrySetLayout;
     vk::UniquePipelineLayout pipelineLayout;
+    vk::UniqueDescriptorSetLayout particleSetLayout;
+    vk::UniquePipelineLayout particlePipelineLayout;
 
     void CreateRenderpass() {
-        vk::AttachmentDescription attachments[2];
+        const bool multisampled = samples != vk::SampleCountFlagBits::e1;
+
+        // 0: color, 1: depth, 2: resolve target (multisampled only)
+        // color / depth are never stored when multisampled, so they can live in tile memory
+        vk::AttachmentDescription attachments[3];
         attachments[0].format = format;
-        attachments[0].samples = vk::SampleCountFlagBits::e1;
+        attachments[0].samples = samples;
         attachments[0].loadOp = vk::AttachmentLoadOp::eClear;
-        attachments[0].storeOp = vk::AttachmentStoreOp::eStore;
+        attachments[0].storeOp = multisampled ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
         attachments[0].stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
         attachments[0].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-        attachments[0].initialLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        attachments[0].initialLayout = multisampled ? vk::ImageLayout::eUndefined : vk::ImageLayout::eColorAttachmentOptimal;
         attachments[0].finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
         attachments[1].format = vk::Format::eD32Sfloat;
-        attachments[1].samples = vk::SampleCountFlagBits::e1;
+        attachments[1].samples = samples;
         attachments[1].loadOp = vk::AttachmentLoadOp::eClear;
         attachments[1].storeOp = vk::AttachmentStoreOp::eDontCare;
         attachments[1].stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
         attachments[1].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-        attachments[1].initialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+        attachments[1].initialLayout = vk::ImageLayout::eUndefined;
         attachments[1].finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+        attachments[2].format = format;
+        attachments[2].samples = vk::SampleCountFlagBits::e1;
+        attachments[2].loadOp = vk::AttachmentLoadOp::eDontCare;
+        attachments[2].storeOp = vk::AttachmentStoreOp::eStore;
+        attachments[2].stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+        attachments[2].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        attachments[2].initialLayout = vk::ImageLayout::eUndefined;
+        attachments[2].finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
 
         vk::AttachmentReference subpass0_colorAttachmentRefs[1];
         subpass0_colorAttachmentRefs[0].attachment = 0;
@@ -375,10 +626,15 @@ class RenderProc {
         subpass0_depthAttachmentRef.attachment = 1;
         subpass0_depthAttachmentRef.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 
+        vk::AttachmentReference subpass0_resolveAttachmentRefs[1];
+        subpass0_resolveAttachmentRefs[0].attachment = 2;
+        subpass0_resolveAttachmentRefs[0].layout = vk::ImageLayout::eColorAttachmentOptimal;
+
         vk::SubpassDescription subpasses[1];
         subpasses[0].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
         subpasses[0].colorAttachmentCount = std::size(subpass0_colorAttachmentRefs);
         subpasses[0].pColorAttachments = subpass0_colorAttachmentRefs;
+        subpasses[0].pResolveAttachments = multisampled ? subpass0_resolveAttachmentRefs : nullptr;
         subpasses[0].pDepthStencilAttachment = &subpass0_depthAttachmentRef;
 
         vk::SubpassDependency dependency[1];
@@ -390,7 +646,7 @@ class RenderProc {
         dependency[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
 
         vk::RenderPassCreateInfo createInfo;
-        createInfo.attachmentCount = std::size(attachments);
+        createInfo.attachmentCount = multisampled ? 3 : 2;
         createInfo.pAttachments = attachments;
         createInfo.subpassCount = std::size(subpasses);
         createInfo.pSubpasses = subpasses;
@@ -419,6 +675,52 @@ class RenderProc {
         descSetLayout = device.createDescriptorSetLayoutUnique(createInfo);
     }
 
+    void CreateGeometrySetLayout() {
+        vk::DescriptorSetLayoutBinding bindings[3];
+        for (uint32_t i = 0; i < std::size(bindings); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorCount = 1;
+            bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+            bindings[i].stageFlags = vk::ShaderStageFlagBits::eVertex;
+        }
+
+        vk::DescriptorSetLayoutCreateInfo createInfo;
+        createInfo.bindingCount = std::size(bindings);
+        createInfo.pBindings = bindings;
+
+        geometrySetLayout = device.createDescriptorSetLayoutUnique(createInfo);
+    }
+
+    void CreateParticleLayouts() {
+        // 0: particles, 1: alive particle indices
+        vk::DescriptorSetLayoutBinding bindings[2];
+        for (uint32_t i = 0; i < std::size(bindings); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorCount = 1;
+            bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+            bindings[i].stageFlags = vk::ShaderStageFlagBits::eVertex;
+        }
+
+        vk::DescriptorSetLayoutCreateInfo createInfo;
+        createInfo.bindingCount = std::size(bindings);
+        createInfo.pBindings = bindings;
+        particleSetLayout = device.createDescriptorSetLayoutUnique(createInfo);
+
+        vk::PushConstantRange pcr;
+        pcr.offset = 0;
+        pcr.size = sizeof(PushConstantData);
+        pcr.stageFlags = vk::ShaderStageFlagBits::eVertex;
+
+        vk::DescriptorSetLayout setLayouts[] = { descSetLayout.get(), particleSetLayout.get() };
+
+        vk::PipelineLayoutCreateInfo layoutCreateInfo;
+        layoutCreateInfo.setLayoutCount = std::size(setLayouts);
+        layoutCreateInfo.pSetLayouts = setLayouts;
+        layoutCreateInfo.pushConstantRangeCount = 1;
+        layoutCreateInfo.pPushConstantRanges = &pcr;
+        particlePipelineLayout = device.createPipelineLayoutUnique(layoutCreateInfo);
+    }
+
     void CreatePipelineLayout() {
         vk::PushConstantRange pcr;
         pcr.offset = 0;
@@ -427,9 +729,13 @@ class RenderProc {
 
         auto pcrs = { pcr };
 
+        std::vector<vk::DescriptorSetLayout> setLayouts = { descSetLayout.get() };
+        if (geometrySetLayout)
+            setLayouts.push_back(geometrySetLayout.get());
+
         vk::PipelineLayoutCreateInfo layoutCreateInfo;
-        layoutCreateInfo.setLayoutCount = 1;
-        layoutCreateInfo.pSetLayouts = &descSetLayout.get();
+        layoutCreateInfo.setLayoutCount = setLayouts.size();
+        layoutCreateInfo.pSetLayouts = setLayouts.data();
         layoutCreateInfo.pushConstantRangeCount = pcrs.size();
         layoutCreateInfo.pPushConstantRanges = pcrs.begin();
 
@@ -437,16 +743,45 @@ class RenderProc {
     }
 
 public:
-    RenderProc(const vk::Device _device, const vk::Format _format)
-        : device(_device), format(_format),
+    RenderProc(const vk::Device _device, const vk::Format _format, vk::SampleCountFlagBits _samples = vk::SampleCountFlagBits::e1, bool vertexPulling = false, bool particles = false, bool panels = false,
+        bool poseSubmission = false, bool _dynamicRendering = false, bool text = true)
+        : device(_device), format(_format), samples(_samples),
         vertShader(device, "shader.vert.spv"), fragShader(device, "shader.frag.spv")
     {
-        CreateRenderpass();
+        if (text) {
+            textVertShader.emplace(device, "shaders/text.vert.spv");
+            textFragShader.emplace(device, "shaders/text.frag.spv");
+        }
+        if (vertexPulling)
+            pullVertShader.emplace(device, "shaders/shader_pull.vert.spv");
+        else if (poseSubmission)
+            poseVertShader.emplace(device, "shaders/shader_pose.vert.spv");
+        if (particles)
+            particleVertShader.emplace(device, "shaders/particle.vert.spv");
+        if (panels) {
+            panelVertShader.emplace(device, "shaders/panel.vert.spv");
+            panelFragShader.emplace(device, "shaders/panel.frag.spv");
+        }
+
+        if (_dynamicRendering)
+            dynamicRendering.emplace(device);
+        else
+            CreateRenderpass();
         CreateDescriptorSetLayout();
+        if (vertexPulling)
+            CreateGeometrySetLayout();
         CreatePipelineLayout();
+        if (particles)
+            CreateParticleLayouts();
     }
 
-    auto CreatePipeline(vk::Extent2D extent) const {
+    auto CreatePipeline(vk::Extent2D extent, PipelineVariant variant = PipelineVariant::Opaque) const {
+        return CreatePipeline(extent, variant, renderpass.get(), samples);
+    }
+
+    // for a render pass other than the main one, e.g. offscreen panels.
+    // Without a render pass, the pipeline is for dynamic rendering to the main color / depth formats.
+    auto CreatePipeline(vk::Extent2D extent, PipelineVariant variant, vk::RenderPass targetPass, vk::SampleCountFlagBits targetSamples) const {
         vk::Viewport viewports[1];
         viewports[0].x = 0.0;
         viewports[0].y = 0.0;
@@ -465,7 +800,7 @@ public:
         viewportState.scissorCount = 1;
         viewportState.pScissors = scissors;
 
-        vk::VertexInputAttributeDescription attrDesc[3];
+        vk::VertexInputAttributeDescription attrDesc[6];
         // position
         attrDesc[0].binding = 0;
         attrDesc[0].location = 0;
@@ -481,8 +816,21 @@ public:
         attrDesc[2].location = 2;
         attrDesc[2].format = vk::Format::eR32G32Sfloat;
         attrDesc[2].offset = 0;
-
-        vk::VertexInputBindingDescription bindDesc[3];
+        // instance pose (shader_pose.vert only)
+        attrDesc[3].binding = 3;
+        attrDesc[3].location = 3;
+        attrDesc[3].format = vk::Format::eR32G32B32Sfloat;
+        attrDesc[3].offset = offsetof(InstancePose, pos);
+        attrDesc[4].binding = 3;
+        attrDesc[4].location = 4;
+        attrDesc[4].format = vk::Format::eR32G32B32A32Sfloat;
+        attrDesc[4].offset = offsetof(InstancePose, rot);
+        attrDesc[5].binding = 3;
+        attrDesc[5].location = 5;
+        attrDesc[5].format = vk::Format::eR32G32B32Sfloat;
+        attrDesc[5].offset = offsetof(InstancePose, scale);
+
+        vk::VertexInputBindingDescription bindDesc[4];
         // position
         bindDesc[0].binding = 0;
         bindDesc[0].stride = sizeof(glm::vec3);
@@ -495,12 +843,41 @@ public:
         bindDesc[2].binding = 2;
         bindDesc[2].stride = sizeof(glm::vec2);
         bindDesc[2].inputRate = vk::VertexInputRate::eVertex;
+        // instance pose
+        bindDesc[3].binding = 3;
+        bindDesc[3].stride = sizeof(InstancePose);
+        bindDesc[3].inputRate = vk::VertexInputRate::eInstance;
+        const bool posed = poseVertShader && variant != PipelineVariant::Particles;
+
+        // text: one rect (xy0, xy1) and one uv rect per glyph instance
+        vk::VertexInputAttributeDescription textAttrDesc[2];
+        textAttrDesc[0].binding = 0;
+        textAttrDesc[0].location = 0;
+        textAttrDesc[0].format = vk::Format::eR32G32B32A32Sfloat;
+        textAttrDesc[0].offset = 0;
+        textAttrDesc[1].binding = 0;
+        textAttrDesc[1].location = 1;
+        textAttrDesc[1].format = vk::Format::eR32G32B32A32Sfloat;
+        textAttrDesc[1].offset = sizeof(glm::vec4);
+
+        vk::VertexInputBindingDescription textBindDesc[1];
+        textBindDesc[0].binding = 0;
+        textBindDesc[0].stride = sizeof(glm::vec4) * 2;
+        textBindDesc[0].inputRate = vk::VertexInputRate::eInstance;
 
         vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
-        vertexInputInfo.vertexAttributeDescriptionCount = std::size(attrDesc);
-        vertexInputInfo.pVertexAttributeDescriptions = attrDesc;
-        vertexInputInfo.vertexBindingDescriptionCount = std::size(bindDesc);
-        vertexInputInfo.pVertexBindingDescriptions = bindDesc;
+        if (variant == PipelineVariant::Text) {
+            vertexInputInfo.vertexAttributeDescriptionCount = std::size(textAttrDesc);
+            vertexInputInfo.pVertexAttributeDescriptions = textAttrDesc;
+            vertexInputInfo.vertexBindingDescriptionCount = std::size(textBindDesc);
+            vertexInputInfo.pVertexBindingDescriptions = textBindDesc;
+        }
+        else if ((!pullVertShader || variant == PipelineVariant::Particles) && variant != PipelineVariant::Panel) {
+            vertexInputInfo.vertexAttributeDescriptionCount = posed ? 6 : 3;
+            vertexInputInfo.pVertexAttributeDescriptions = attrDesc;
+            vertexInputInfo.vertexBindingDescriptionCount = posed ? 4 : 3;
+            vertexInputInfo.pVertexBindingDescriptions = bindDesc;
+        }
 
         vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
         inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
@@ -511,13 +888,13 @@ public:
         rasterizer.rasterizerDiscardEnable = false;
         rasterizer.polygonMode = vk::PolygonMode::eFill;
         rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = vk::CullModeFlagBits::eBack;
+        rasterizer.cullMode = variant == PipelineVariant::Panel || variant == PipelineVariant::Text ? vk::CullModeFlagBits::eNone : vk::CullModeFlagBits::eBack;
         rasterizer.frontFace = vk::FrontFace::eCounterClockwise;
         rasterizer.depthBiasEnable = false;
 
         vk::PipelineMultisampleStateCreateInfo multisample;
         multisample.sampleShadingEnable = false;
-        multisample.rasterizationSamples = vk::SampleCountFlagBits::e1;
+        multisample.rasterizationSamples = targetSamples;
 
         vk::PipelineColorBlendAttachmentState blendattachment[1];
         blendattachment[0].colorWriteMask =
@@ -526,11 +903,23 @@ public:
             vk::ColorComponentFlagBits::eG |
             vk::ColorComponentFlagBits::eB;
         blendattachment[0].blendEnable = false;
+        if (variant == PipelineVariant::DepthOnly)
+            blendattachment[0].colorWriteMask = {};
+        // alpha keeps the glyph coverage, so text on a transparent panel stays visible after compositing
+        if (variant == PipelineVariant::Text) {
+            blendattachment[0].blendEnable = true;
+            blendattachment[0].srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+            blendattachment[0].dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+            blendattachment[0].colorBlendOp = vk::BlendOp::eAdd;
+            blendattachment[0].srcAlphaBlendFactor = vk::BlendFactor::eOne;
+            blendattachment[0].dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+            blendattachment[0].alphaBlendOp = vk::BlendOp::eAdd;
+        }
 
         vk::PipelineDepthStencilStateCreateInfo depthStencil;
         depthStencil.depthTestEnable = VK_TRUE;
-        depthStencil.depthWriteEnable = VK_TRUE;
-        depthStencil.depthCompareOp = vk::CompareOp::eLess;
+        depthStencil.depthWriteEnable = variant == PipelineVariant::AfterPrepass || variant == PipelineVariant::Text ? VK_FALSE : VK_TRUE;
+        depthStencil.depthCompareOp = variant == PipelineVariant::AfterPrepass ? vk::CompareOp::eLessOrEqual : vk::CompareOp::eLess;
         depthStencil.depthBoundsTestEnable = VK_FALSE;
         depthStencil.minDepthBounds = 0.0f;
         depthStencil.maxDepthBounds = 1.0f;
@@ -543,9 +932,17 @@ public:
         blend.attachmentCount = 1;
         blend.pAttachments = blendattachment;
 
+        const auto& vert = variant == PipelineVariant::Particles ? particleVertShader.value()
+            : variant == PipelineVariant::Panel ? panelVertShader.value()
+            : variant == PipelineVariant::Text ? textVertShader.value()
+            : pullVertShader ? pullVertShader.value()
+            : poseVertShader ? poseVertShader.value() : vertShader;
+        const auto& frag = variant == PipelineVariant::Panel ? panelFragShader.value()
+            : variant == PipelineVariant::Text ? textFragShader.value() : fragShader;
+
         vk::PipelineShaderStageCreateInfo shaderStage[] = {
-            vertShader.getStageCreateInfo(vk::ShaderStageFlagBits::eVertex),
-            fragShader.getStageCreateInfo(vk::ShaderStageFlagBits::eFragment),
+            vert.getStageCreateInfo(vk::ShaderStageFlagBits::eVertex),
+            frag.getStageCreateInfo(vk::ShaderStageFlagBits::eFragment),
         };
 
         vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
@@ -556,12 +953,21 @@ public:
         pipelineCreateInfo.pMultisampleState = &multisample;
         pipelineCreateInfo.pColorBlendState = &blend;
         pipelineCreateInfo.pDepthStencilState = &depthStencil;
-        pipelineCreateInfo.layout = pipelineLayout.get();
-        pipelineCreateInfo.stageCount = std::size(shaderStage);
+        pipelineCreateInfo.layout = variant == PipelineVariant::Particles ? particlePipelineLayout.get() : pipelineLayout.get();
+        pipelineCreateInfo.stageCount = variant == PipelineVariant::DepthOnly ? 1 : std::size(shaderStage);
         pipelineCreateInfo.pStages = shaderStage;
-        pipelineCreateInfo.renderPass = renderpass.get();
+        pipelineCreateInfo.renderPass = targetPass;
         pipelineCreateInfo.subpass = 0;
 
+        const vk::Format depthFormat = vk::Format::eD32Sfloat;
+        vk::PipelineRenderingCreateInfoKHR renderingInfo;
+        if (!targetPass) {
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachmentFormats = &format;
+            renderingInfo.depthAttachmentFormat = depthFormat;
+            pipelineCreateInfo.pNext = &renderingInfo;
+        }
+
         return device.createGraphicsPipelineUnique(nullptr, pipelineCreateInfo).value;
     }
 
@@ -569,10 +975,47 @@ public:
         return renderpass.get();
     }
 
+    // nullptr when the main pass is a render pass
+    const DynamicRenderingCommands* getDynamicRendering() const {
+        return dynamicRendering ? &dynamicRendering.value() : nullptr;
+    }
+
     auto getDescriptorSetLayout() const {
         return descSetLayout.get();
     }
 
+    auto getGeometrySetLayout() const {
+        return geometrySetLayout.get();
+    }
+
+    bool isVertexPulling() const {
+        return pullVertShader.has_value();
+    }
+
+    bool hasParticles() const {
+        return particleVertShader.has_value();
+    }
+
+    bool hasPoseSubmission() const {
+        return poseVertShader.has_value();
+    }
+
+    bool hasPanels() const {
+        return panelVertShader.has_value();
+    }
+
+    bool hasText() const {
+        return textVertShader.has_value();
+    }
+
+    auto getParticleSetLayout() const {
+        return particleSetLayout.get();
+    }
+
+    auto getParticlePipelineLayout() const {
+        return particlePipelineLayout.get();
+    }
+
     auto getPipelineLayout() const {
         return pipelineLayout.get();
     }
@@ -580,6 +1023,91 @@ public:
     auto getFormat() const {
         return format;
     }
+
+    auto getSamples() const {
+        return samples;
+    }
+};
+
+// Counts fragment shader invocations per view to estimate overdraw.
+// Results are read back a few frames later without stalling.
+class FragmentStatsQuery {
+    vk::UniqueQueryPool queryPool;
+    uint32_t slotCount;
+    uint32_t current = 0;
+    uint32_t written = 0;
+public:
+    FragmentStatsQuery(vk::Device device, uint32_t _slotCount) : slotCount(_slotCount) {
+        vk::QueryPoolCreateInfo createInfo;
+        createInfo.queryType = vk::QueryType::ePipelineStatistics;
+        createInfo.queryCount = slotCount;
+        createInfo.pipelineStatistics = vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+        queryPool = device.createQueryPoolUnique(createInfo);
+    }
+
+    // must be recorded outside of a render pass
+    void reset(const vk::CommandBuffer cmdBuf) {
+        current = (current + 1) % slotCount;
+        written = std::min(written + 1, slotCount);
+        cmdBuf.resetQueryPool(queryPool.get(), current, 1);
+    }
+    void begin(const vk::CommandBuffer cmdBuf) const {
+        cmdBuf.beginQuery(queryPool.get(), current, {});
+    }
+    void end(const vk::CommandBuffer cmdBuf) const {
+        cmdBuf.endQuery(queryPool.get(), current);
+    }
+
+    // oldest slot; nullopt while it has not been written or is still in flight
+    std::optional<uint64_t> getOldest(vk::Device device) const {
+        if (written < slotCount)
+            return std::nullopt;
+        uint64_t invocations = 0;
+        auto result = device.getQueryPoolResults(queryPool.get(), (current + 1) % slotCount, 1,
+            sizeof(invocations), &invocations, sizeof(invocations), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess)
+            return std::nullopt;
+        return invocations;
+    }
+};
+
+// GPU time between two timestamps, in a ring of slots like FragmentStatsQuery
+class GpuTimerQuery {
+    vk::UniqueQueryPool queryPool;
+    uint32_t slotCount;
+    uint32_t current = 0;
+    uint32_t written = 0;
+    double periodNs;
+public:
+    GpuTimerQuery(vk::Device device, uint32_t _slotCount, float timestampPeriod) : slotCount(_slotCount), periodNs(timestampPeriod) {
+        vk::QueryPoolCreateInfo createInfo;
+        createInfo.queryType = vk::QueryType::eTimestamp;
+        createInfo.queryCount = slotCount * 2;
+        queryPool = device.createQueryPoolUnique(createInfo);
+    }
+
+    // must be recorded outside of a render pass
+    void begin(const vk::CommandBuffer cmdBuf) {
+        current = (current + 1) % slotCount;
+        written = std::min(written + 1, slotCount);
+        cmdBuf.resetQueryPool(queryPool.get(), current * 2, 2);
+        cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool.get(), current * 2);
+    }
+    void end(const vk::CommandBuffer cmdBuf) const {
+        cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, queryPool.get(), current * 2 + 1);
+    }
+
+    // oldest slot in milliseconds; nullopt while it has not been written or is still in flight
+    std::optional<double> getOldestMs(vk::Device device) const {
+        if (written < slotCount)
+            return std::nullopt;
+        uint64_t timestamps[2] = {};
+        auto result = device.getQueryPoolResults(queryPool.get(), (current + 1) % slotCount * 2, 2,
+            sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess)
+            return std::nullopt;
+        return (timestamps[1] - timestamps[0]) * periodNs / 1e6;
+    }
 };
 
 class SwapchainRenderTargets {
@@ -588,23 +1116,42 @@ class SwapchainRenderTargets {
     vk::Device device;
 
     vk::RenderPass renderpass;
+    const DynamicRenderingCommands* dynamicRendering;
     vk::UniquePipeline pipeline;
+    vk::UniquePipeline depthOnlyPipeline;
+    vk::UniquePipeline afterPrepassPipeline;
+    vk::UniquePipeline particlePipeline;
+    vk::UniquePipeline panelPipeline;
+    vk::UniquePipeline textPipeline;
     std::vector<vk::Image> swapchainImages;
 
     struct RenderTarget {
         vk::UniqueImageView imgView;
-        vk::UniqueFramebuffer frameBuf;
+        vk::UniqueFramebuffer frameBuf;     // render pass only
     };
     std::vector<RenderTarget> renderTargets;
 
+    vk::SampleCountFlagBits samples;
+
     std::optional<Image> depthImage;
     vk::UniqueImageView depthImageView;
+    std::optional<Image> colorImage;
+    vk::UniqueImageView colorImageView;
 
     void CreateDepthBuffer(const vk::Device device, const vk::Extent2D extent, const Allocator& allocator) {
-        depthImage.emplace(device, allocator, vk::Extent3D{ extent.width, extent.height, 1 }, vk::Format::eD32Sfloat, vk::ImageUsageFlagBits::eDepthStencilAttachment);
+        depthImage.emplace(device, allocator, vk::Extent3D{ extent.width, extent.height, 1 }, vk::Format::eD32Sfloat,
+            vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransientAttachment,
+            vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated, vk::SharingMode::eExclusive, samples);
         depthImageView = depthImage->CreateImageView(device, vk::ImageAspectFlagBits::eDepth);
     };
 
+    void CreateMultisampleColorBuffer(const vk::Device device, const vk::Extent2D extent, const Allocator& allocator) {
+        colorImage.emplace(device, allocator, vk::Extent3D{ extent.width, extent.height, 1 }, format,
+            vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransientAttachment,
+            vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated, vk::SharingMode::eExclusive, samples);
+        colorImageView = colorImage->CreateImageView(device);
+    }
+
     void CreateFrameBuffer(uint32_t index) {
         vk::ImageViewCreateInfo imgViewCreateInfo;
         imgViewCreateInfo.image = swapchainImages[index];
@@ -620,39 +1167,112 @@ class SwapchainRenderTargets {
         imgViewCreateInfo.subresourceRange.baseArrayLayer = 0;
         imgViewCreateInfo.subresourceRange.layerCount = 1;
         auto imgView = device.createImageViewUnique(imgViewCreateInfo);
+        if (dynamicRendering) {
+            this->renderTargets[index].imgView = std::move(imgView);
+            return;
+        }
 
-        vk::ImageView attachments[] = {
-            imgView.get(),
-            this->depthImageView.get()
-        };
+        std::vector<vk::ImageView> attachments;
+        if (colorImage) {
+            attachments = { this->colorImageView.get(), this->depthImageView.get(), imgView.get() };
+        }
+        else {
+            attachments = { imgView.get(), this->depthImageView.get() };
+        }
 
         vk::FramebufferCreateInfo createInfo;
         createInfo.width = extent.width;
         createInfo.height = extent.height;
         createInfo.layers = 1;
         createInfo.renderPass = this->renderpass;
-        createInfo.attachmentCount = std::size(attachments);
-        createInfo.pAttachments = attachments;
+        createInfo.attachmentCount = attachments.size();
+        createInfo.pAttachments = attachments.data();
         auto frameBuf = device.createFramebufferUnique(createInfo);
 
         this->renderTargets[index].imgView = std::move(imgView);
         this->renderTargets[index].frameBuf = std::move(frameBuf);
     }
 
+    // same attachment use as the render pass of RenderProc: the transient depth / MSAA color are discarded
+    // and their layout transitions, done by the render pass there, are recorded here
+    void beginRendering(const vk::CommandBuffer cmdBuf, uint32_t imageIndex, const vk::ClearValue& clearColor, const vk::ClearValue& clearDepth) const {
+        vk::ImageMemoryBarrier barriers[2];
+        barriers[0].srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        barriers[0].dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        barriers[0].oldLayout = vk::ImageLayout::eUndefined;
+        barriers[0].newLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+        barriers[0].image = depthImage->get();
+        barriers[0].subresourceRange = { vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 };
+        barriers[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        barriers[1].dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        barriers[1].oldLayout = vk::ImageLayout::eUndefined;
+        barriers[1].newLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        barriers[1].image = colorImage ? colorImage->get() : vk::Image{};
+        barriers[1].subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+        cmdBuf.pipelineBarrier(
+            vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests,
+            {}, 0, nullptr, 0, nullptr, colorImage ? 2 : 1, barriers);
+
+        // the swapchain image is in color attachment layout already
+        vk::RenderingAttachmentInfoKHR colorAttachment;
+        colorAttachment.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
+        colorAttachment.clearValue = clearColor;
+        if (colorImage) {
+            colorAttachment.imageView = colorImageView.get();
+            colorAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+            colorAttachment.resolveMode = vk::ResolveModeFlagBits::eAverage;
+            colorAttachment.resolveImageView = renderTargets[imageIndex].imgView.get();
+            colorAttachment.resolveImageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        }
+        else {
+            colorAttachment.imageView = renderTargets[imageIndex].imgView.get();
+            colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+        }
+
+        vk::RenderingAttachmentInfoKHR depthAttachment;
+        depthAttachment.imageView = depthImageView.get();
+        depthAttachment.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+        depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
+        depthAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+        depthAttachment.clearValue = clearDepth;
+
+        vk::RenderingInfoKHR renderingInfo;
+        renderingInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+        renderingInfo.renderArea.extent = extent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        dynamicRendering->beginRendering(cmdBuf, reinterpret_cast<const VkRenderingInfoKHR*>(&renderingInfo));
+    }
+
 public:
     SwapchainRenderTargets(const vk::Device _device, const std::vector<vk::Image>& _swapchainImages, const vk::Extent2D _extent, const Allocator& allocator, const RenderProc& renderproc) :
-        device(_device), format(renderproc.getFormat()), extent(_extent),
+        device(_device), format(renderproc.getFormat()), extent(_extent), samples(renderproc.getSamples()),
         swapchainImages(_swapchainImages), renderTargets(_swapchainImages.size())
     {
         renderpass = renderproc.getRenderpass();
+        dynamicRendering = renderproc.getDynamicRendering();
         pipeline = renderproc.CreatePipeline(extent);
+        depthOnlyPipeline = renderproc.CreatePipeline(extent, PipelineVariant::DepthOnly);
+        afterPrepassPipeline = renderproc.CreatePipeline(extent, PipelineVariant::AfterPrepass);
+        if (renderproc.hasParticles())
+            particlePipeline = renderproc.CreatePipeline(extent, PipelineVariant::Particles);
+        if (renderproc.hasPanels())
+            panelPipeline = renderproc.CreatePipeline(extent, PipelineVariant::Panel);
+        if (renderproc.hasText())
+            textPipeline = renderproc.CreatePipeline(extent, PipelineVariant::Text);
         CreateDepthBuffer(device, extent, allocator);
+        if (samples != vk::SampleCountFlagBits::e1)
+            CreateMultisampleColorBuffer(device, extent, allocator);
         for (uint32_t i = 0; i < swapchainImages.size(); i++)
             CreateFrameBuffer(i);
     }
 
     void beginRenderPass(const vk::CommandBuffer cmdBuf, uint32_t imageIndex) {
-        vk::ClearValue clearVal[2];
+        vk::ClearValue clearVal[3];
         clearVal[0].color.float32[0] = 0.05f;
         clearVal[0].color.float32[1] = 0.05f;
         clearVal[0].color.float32[2] = 0.1f;
@@ -660,10 +1280,16 @@ public:
         clearVal[1].depthStencil.depth = 1.0f;
         clearVal[1].depthStencil.stencil = 0.0f;
 
+        if (dynamicRendering) {
+            beginRendering(cmdBuf, imageIndex, clearVal[0], clearVal[1]);
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+            return;
+        }
+
         vk::RenderPassBeginInfo renderpassBeginInfo;
         renderpassBeginInfo.renderPass = this->renderpass;
         renderpassBeginInfo.framebuffer = this->renderTargets[imageIndex].frameBuf.get();
-        renderpassBeginInfo.clearValueCount = std::size(clearVal);
+        renderpassBeginInfo.clearValueCount = colorImage ? 3 : 2;
         renderpassBeginInfo.pClearValues = clearVal;
         renderpassBeginInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
         renderpassBeginInfo.renderArea.extent = extent;
@@ -672,8 +1298,48 @@ public:
         cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
     }
 
+    void bindPipeline(const vk::CommandBuffer cmdBuf, PipelineVariant variant) const {
+        switch (variant) {
+        case PipelineVariant::DepthOnly:
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, depthOnlyPipeline.get());
+            break;
+        case PipelineVariant::AfterPrepass:
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, afterPrepassPipeline.get());
+            break;
+        case PipelineVariant::Particles:
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, particlePipeline.get());
+            break;
+        case PipelineVariant::Panel:
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, panelPipeline.get());
+            break;
+        case PipelineVariant::Text:
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, textPipeline.get());
+            break;
+        default:
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+            break;
+        }
+    }
+
     void endRenderPass(const vk::CommandBuffer cmdBuf) const {
-        cmdBuf.endRenderPass();
+        if (dynamicRendering)
+            dynamicRendering->endRendering(cmdBuf);
+        else
+            cmdBuf.endRenderPass();
+    }
+
+    void setDebugNames(const DebugUtils& debug, const std::string& name) const {
+        for (uint32_t i = 0; i < swapchainImages.size(); i++) {
+            debug.setName(device, swapchainImages[i], fmt::format("{} swapchain image {}", name, i));
+            if (renderTargets[i].frameBuf)
+                debug.setName(device, renderTargets[i].frameBuf.get(), fmt::format("{} framebuffer {}", name, i));
+        }
+        debug.setName(device, depthImage->get(), name + " depth");
+        if (colorImage)
+            debug.setName(device, colorImage->get(), name + " MSAA color");
+        debug.setName(device, pipeline.get(), name + " opaque pipeline");
+        if (textPipeline)
+            debug.setName(device, textPipeline.get(), name + " text pipeline");
     }
 
     const auto& getExtent() const {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <limits>
 #include <tiny_gltf.h>
 
 inline auto getVkTexFilterFromGltfTexFilter(int filter) {
@@ -26,12 +27,212 @@ inline auto getVkIndexTypeFromGltfComponent(int component) {
     }
 }
 
+inline void copyGltfAttribute(const tinygltf::Model& model, int accessorIndex, size_t components, float* dst, size_t count) {
+    const auto& accessor = model.accessors[accessorIndex];
+    const auto& bufView = model.bufferViews[accessor.bufferView];
+    assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
+
+    const auto* src = model.buffers[bufView.buffer].data.data() + bufView.byteOffset + accessor.byteOffset;
+    size_t stride = accessor.ByteStride(bufView);
+    for (size_t i = 0; i < std::min<size_t>(count, accessor.count); i++)
+        std::memcpy(dst + i * components, src + i * stride, sizeof(float) * components);
+}
+
+template<typename T>
+inline void appendGltfIndices(const unsigned char* src, size_t count, std::vector<uint32_t>& dst) {
+    for (size_t i = 0; i < count; i++) {
+        T index;
+        std::memcpy(&index, src + i * sizeof(T), sizeof(T));
+        dst.push_back(index);
+    }
+}
+inline void appendGltfIndices(const tinygltf::Model& model, int accessorIndex, std::vector<uint32_t>& dst) {
+    const auto& accessor = model.accessors[accessorIndex];
+    const auto& bufView = model.bufferViews[accessor.bufferView];
+    const auto* src = model.buffers[bufView.buffer].data.data() + bufView.byteOffset + accessor.byteOffset;
+
+    switch (accessor.componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        appendGltfIndices<uint8_t>(src, accessor.count, dst);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        appendGltfIndices<uint16_t>(src, accessor.count, dst);
+        break;
+    default:
+        appendGltfIndices<uint32_t>(src, accessor.count, dst);
+        break;
+    }
+}
+
+// CPU copy of the positions, e.g. for the software occlusion rasterizer
+struct CpuMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    glm::vec3 boundsMin{ std::numeric_limits<float>::max() };
+    glm::vec3 boundsMax{ std::numeric_limits<float>::lowest() };
+};
+
+// Vertex data of all models merged into shared storage buffers, for the vertex pulling pipeline.
+// Primitives are drawn from one index buffer with firstIndex / vertexOffset, so nothing has to be rebound between models.
+class GeometryPool {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<uint32_t> indices;
+
+    std::optional<Buffer> positionBuf, normalBuf, texCoordBuf, indexBuf;
+    vk::UniqueDescriptorPool descPool;
+    std::vector<vk::UniqueDescriptorSet> descSets;
+
+public:
+    struct Range {
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t count;
+    };
+
+    Range append(const tinygltf::Model& model, const tinygltf::Primitive& primitive) {
+        Range range;
+        range.vertexOffset = positions.size() / 3;
+        range.firstIndex = indices.size();
+
+        const auto vertexCount = model.accessors[primitive.attributes.at("POSITION")].count;
+        positions.resize(positions.size() + vertexCount * 3);
+        normals.resize(normals.size() + vertexCount * 3);
+        texCoords.resize(texCoords.size() + vertexCount);
+
+        for (const auto& attr : primitive.attributes) {
+            if (attr.first == "POSITION")
+                copyGltfAttribute(model, attr.second, 3, positions.data() + range.vertexOffset * 3, vertexCount);
+            else if (attr.first == "NORMAL")
+                copyGltfAttribute(model, attr.second, 3, normals.data() + range.vertexOffset * 3, vertexCount);
+            else if (attr.first == "TEXCOORD_0")
+                copyGltfAttribute(model, attr.second, 2, &texCoords[range.vertexOffset].x, vertexCount);
+        }
+
+        appendGltfIndices(model, primitive.indices, indices);
+        range.count = indices.size() - range.firstIndex;
+
+        return range;
+    }
+
+    void upload(vk::Device device, const Allocator& allocator, CommandBuffer& cmdBuf, vk::Queue queue, vk::DescriptorSetLayout layout) {
+        if (indices.empty())
+            return;
+
+        auto createBuffer = [&](std::optional<Buffer>& buf, const auto& data, vk::BufferUsageFlags usage) {
+            vk::DeviceSize size = data.size() * sizeof(data[0]);
+            buf.emplace(device, allocator, size, usage);
+            buf->template pasteViaStaging<true>(cmdBuf, queue, reinterpret_cast<const std::byte*>(data.data()), size);
+        };
+        createBuffer(positionBuf, positions, vk::BufferUsageFlagBits::eStorageBuffer);
+        createBuffer(normalBuf, normals, vk::BufferUsageFlagBits::eStorageBuffer);
+        createBuffer(texCoordBuf, texCoords, vk::BufferUsageFlagBits::eStorageBuffer);
+        createBuffer(indexBuf, indices, vk::BufferUsageFlagBits::eIndexBuffer);
+
+        std::cout << fmt::format("GeometryPool: {} vertices, {} indices", positions.size() / 3, indices.size()) << std::endl;
+
+        vk::DescriptorPoolSize poolSizes[1];
+        poolSizes[0].type = vk::DescriptorType::eStorageBuffer;
+        poolSizes[0].descriptorCount = 3;
+
+        vk::DescriptorPoolCreateInfo poolCreateInfo;
+        poolCreateInfo.poolSizeCount = std::size(poolSizes);
+        poolCreateInfo.pPoolSizes = poolSizes;
+        poolCreateInfo.maxSets = 1;
+        poolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        descPool = device.createDescriptorPoolUnique(poolCreateInfo);
+
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.descriptorPool = descPool.get();
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        descSets = device.allocateDescriptorSetsUnique(allocInfo);
+
+        vk::DescriptorBufferInfo bufferInfos[3];
+        bufferInfos[0].buffer = positionBuf->get();
+        bufferInfos[1].buffer = normalBuf->get();
+        bufferInfos[2].buffer = texCoordBuf->get();
+
+        std::vector<vk::WriteDescriptorSet> writes;
+        for (uint32_t i = 0; i < std::size(bufferInfos); i++) {
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = VK_WHOLE_SIZE;
+
+            vk::WriteDescriptorSet write;
+            write.dstSet = descSets[0].get();
+            write.dstBinding = i;
+            write.dstArrayElement = 0;
+            write.descriptorType = vk::DescriptorType::eStorageBuffer;
+            write.descriptorCount = 1;
+            write.pBufferInfo = &bufferInfos[i];
+            writes.push_back(write);
+        }
+        device.updateDescriptorSets(writes, {});
+
+        positions = {};
+        normals = {};
+        texCoords = {};
+        indices = {};
+    }
+
+    void bind(const vk::CommandBuffer& cmdBuf, vk::PipelineLayout layout) const {
+        if (descSets.empty())
+            return;
+        cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 1, { descSets[0].get() }, {});
+        cmdBuf.bindIndexBuffer(indexBuf->get(), 0, vk::IndexType::eUint32);
+    }
+};
+
+// Instance poses of the draws of one command buffer, for the pose submission pipeline (vertex binding 3).
+// Index 0 is always the identity pose, used by draws that push their full mvp instead.
+class PoseBuffer {
+    static constexpr uint32_t maxPoses = 4096;      // per command buffer
+    static constexpr uint32_t segments = 8;         // more than the command buffers in flight
+    static constexpr vk::DeviceSize segmentSize = sizeof(InstancePose) * maxPoses;
+
+    std::optional<Buffer> buffer;
+    std::vector<InstancePose> poses;
+    uint32_t poseCount = 0;
+    uint32_t segment = 0;
+
+public:
+    PoseBuffer(vk::Device device, const Allocator& allocator) : poses(maxPoses) {
+        buffer.emplace(device, allocator, segmentSize * segments, vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eHostVisible);
+    }
+
+    // call at the start of every command buffer that draws models
+    void begin() {
+        segment = (segment + 1) % segments;
+        poses[0] = InstancePose{ glm::vec3(0.0f), glm::identity<glm::quat>(), glm::vec3(1.0f) };
+        poseCount = 1;
+    }
+
+    // instance index of the pose, 0 if the buffer is full
+    uint32_t push(const glm::vec3& pos, const glm::quat& rot, const glm::vec3& scale) {
+        if (poseCount >= maxPoses)
+            return 0;
+        poses[poseCount] = InstancePose{ pos, rot, scale };
+        return poseCount++;
+    }
+
+    void bind(const vk::CommandBuffer& cmdBuf) const {
+        cmdBuf.bindVertexBuffers(3, { buffer->get() }, { segmentSize * segment });
+    }
+
+    // uploads the poses of this command buffer; call before it is submitted
+    void end() const {
+        // whole 256 byte blocks, so that the flushed range stays aligned to nonCoherentAtomSize
+        vk::DeviceSize size = std::min(segmentSize, (sizeof(InstancePose) * poseCount + 255) / 256 * 256);
+        buffer->paste(reinterpret_cast<const std::byte*>(poses.data()), size, segmentSize * segment);
+    }
+};
+
 class ModelData {
     std::vector<Buffer> buffers;
     std::vector<vk::Buffer> vkBuffers;
     std::vector<TextureImage> textureImages;
-    std::vector<vk::UniqueSampler> textureSamplers;
-    vk::UniqueDescriptorPool descPool;
+    std::vector<vk::Sampler> textureSamplers;     // owned by samplerCache
     std::vector<vk::UniqueDescriptorSet> materialDescSets;
     std::vector<glm::vec3> materialBaseColors;
 
@@ -47,16 +248,51 @@ class ModelData {
         XrMatrix4x4f matrix;
         std::array<vk::Buffer, 3> vertBufs;
         std::array<vk::DeviceSize, 3> vertBufOffsets;
+        std::optional<GeometryPool::Range> pooled;
     };
     std::vector<std::vector<PrimitiveRendering>> primitiveRenderings;
 
+    // shared by all models, so that the sampler and descriptor pool counts do not grow with them
     static std::optional<TextureImage> defaultTexture;
-    static vk::UniqueSampler defaultSampler;
+    static std::optional<SamplerCache> samplerCache;
+    static std::optional<DescriptorAllocator> materialDescAllocator;
+
+    GeometryPool* geometryPool = nullptr;
+    CpuMesh cpuMesh;
+
+    void loadCpuMesh(const tinygltf::Model& model, const tinygltf::Primitive& primitive) {
+        auto it = primitive.attributes.find("POSITION");
+        if (it == primitive.attributes.end() || primitive.indices < 0)
+            return;
+
+        uint32_t base = cpuMesh.positions.size();
+        const auto vertexCount = model.accessors[it->second].count;
+        cpuMesh.positions.resize(base + vertexCount);
+        copyGltfAttribute(model, it->second, 3, &cpuMesh.positions[base].x, vertexCount);
+
+        for (size_t i = base; i < cpuMesh.positions.size(); i++) {
+            cpuMesh.boundsMin = glm::min(cpuMesh.boundsMin, cpuMesh.positions[i]);
+            cpuMesh.boundsMax = glm::max(cpuMesh.boundsMax, cpuMesh.positions[i]);
+        }
+
+        auto firstIndex = cpuMesh.indices.size();
+        appendGltfIndices(model, primitive.indices, cpuMesh.indices);
+        for (size_t i = firstIndex; i < cpuMesh.indices.size(); i++)
+            cpuMesh.indices[i] += base;
+    }
 
     void loadMesh(const tinygltf::Model& model, const tinygltf::Mesh& mesh) {
         for (const auto& primitive : mesh.primitives) {
             PrimitiveRendering renderDat;
 
+            loadCpuMesh(model, primitive);
+
+            if (geometryPool) {
+                renderDat.pooled = geometryPool->append(model, primitive);
+                primitiveRenderings[primitive.material].push_back(renderDat);
+                continue;
+            }
+
             {
                 const auto& accessor = model.accessors[primitive.indices];
                 const auto& bufView = model.bufferViews[accessor.bufferView];
@@ -134,71 +370,40 @@ class ModelData {
             defaultTexture.emplace(device, allocator, cmdBuf, queue, extent, dat);
         }
     }
+    static vk::SamplerCreateInfo getSamplerCreateInfo(vk::Filter magFilter, vk::Filter minFilter) {
+        vk::SamplerCreateInfo createInfo;
+
+        createInfo.magFilter = magFilter;
+        createInfo.minFilter = minFilter;
+        createInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+        createInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+        createInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+        createInfo.anisotropyEnable = VK_FALSE;
+        createInfo.maxAnisotropy = 1.0f;
+        createInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
+        createInfo.unnormalizedCoordinates = VK_FALSE;
+        createInfo.compareEnable = VK_FALSE;
+        createInfo.compareOp = vk::CompareOp::eAlways;
+        createInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
+        createInfo.mipLodBias = 0.0f;
+        createInfo.minLod = 0.0f;
+        createInfo.maxLod = 0.0f;
+        return createInfo;
+    }
     void loadSamplers(const tinygltf::Model& model, vk::Device device) {
-        for (const auto& sampler : model.samplers) {
-            vk::SamplerCreateInfo createInfo;
-
-            createInfo.magFilter = getVkTexFilterFromGltfTexFilter(sampler.magFilter);
-            createInfo.minFilter = getVkTexFilterFromGltfTexFilter(sampler.minFilter);
-            createInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
-            createInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
-            createInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
-            createInfo.anisotropyEnable = VK_FALSE;
-            createInfo.maxAnisotropy = 1.0f;
-            createInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
-            createInfo.unnormalizedCoordinates = VK_FALSE;
-            createInfo.compareEnable = VK_FALSE;
-            createInfo.compareOp = vk::CompareOp::eAlways;
-            createInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
-            createInfo.mipLodBias = 0.0f;
-            createInfo.minLod = 0.0f;
-            createInfo.maxLod = 0.0f;
-
-            textureSamplers.push_back(device.createSamplerUnique(createInfo));
-        }
+        if (!samplerCache)
+            samplerCache.emplace(device);
 
-        if (!defaultSampler) {
-            vk::SamplerCreateInfo createInfo;
-
-            createInfo.magFilter = vk::Filter::eLinear;
-            createInfo.minFilter = vk::Filter::eLinear;
-            createInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
-            createInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
-            createInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
-            createInfo.anisotropyEnable = VK_FALSE;
-            createInfo.maxAnisotropy = 1.0f;
-            createInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
-            createInfo.unnormalizedCoordinates = VK_FALSE;
-            createInfo.compareEnable = VK_FALSE;
-            createInfo.compareOp = vk::CompareOp::eAlways;
-            createInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
-            createInfo.mipLodBias = 0.0f;
-            createInfo.minLod = 0.0f;
-            createInfo.maxLod = 0.0f;
-
-            defaultSampler = device.createSamplerUnique(createInfo);
+        for (const auto& sampler : model.samplers) {
+            textureSamplers.push_back(samplerCache->get(getSamplerCreateInfo(
+                getVkTexFilterFromGltfTexFilter(sampler.magFilter), getVkTexFilterFromGltfTexFilter(sampler.minFilter))));
         }
     }
     void loadMaterialDescs(const tinygltf::Model& model, vk::Device device, vk::DescriptorSetLayout layout) {
-        vk::DescriptorPoolSize poolSizes[1];
-        poolSizes[0].type = vk::DescriptorType::eCombinedImageSampler;
-        poolSizes[0].descriptorCount = model.materials.size();
-
-        vk::DescriptorPoolCreateInfo poolCreateInfo;
-        poolCreateInfo.poolSizeCount = std::size(poolSizes);
-        poolCreateInfo.pPoolSizes = poolSizes;
-        poolCreateInfo.maxSets = model.materials.size();
-        poolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
-
-        descPool = device.createDescriptorPoolUnique(poolCreateInfo);
-
-        std::vector<vk::DescriptorSetLayout> layouts(model.materials.size(), layout);
-
-        vk::DescriptorSetAllocateInfo allocInfo;
-        allocInfo.descriptorPool = descPool.get();
-        allocInfo.descriptorSetCount = layouts.size();
-        allocInfo.pSetLayouts = layouts.data();
-        materialDescSets = device.allocateDescriptorSetsUnique(allocInfo);
+        if (!materialDescAllocator)
+            materialDescAllocator.emplace(device, std::vector{ vk::DescriptorPoolSize{ vk::DescriptorType::eCombinedImageSampler, 1 } });
+        materialDescSets = materialDescAllocator->allocate(layout, model.materials.size());
+        const auto defaultSampler = samplerCache->get(getSamplerCreateInfo(vk::Filter::eLinear, vk::Filter::eLinear));
 
         materialBaseColors.resize(model.materials.size());
 
@@ -209,11 +414,11 @@ class ModelData {
                 const auto& texture = model.textures[material.pbrMetallicRoughness.baseColorTexture.index];
 
                 imageInfo.imageView = textureImages[texture.source].getImageView();
-                imageInfo.sampler = textureSamplers[texture.sampler].get();
+                imageInfo.sampler = texture.sampler >= 0 ? textureSamplers[texture.sampler] : defaultSampler;
             }
             else {
                 imageInfo.imageView = defaultTexture->getImageView();
-                imageInfo.sampler = defaultSampler.get();
+                imageInfo.sampler = defaultSampler;
             }
 
             vk::WriteDescriptorSet samplerWrite;
@@ -249,7 +454,8 @@ class ModelData {
         if (!ret)
             throw std::runtime_error("Failed to load model");
 
-        loadBuffers(model, device, allocator, cmdBuf, queue);
+        if (!geometryPool)
+            loadBuffers(model, device, allocator, cmdBuf, queue);
         loadImages(model, device, allocator, cmdBuf, queue);
         loadSamplers(model, device);
         loadMaterialDescs(model, device, layout);
@@ -263,10 +469,48 @@ class ModelData {
     }
 
 public:
-    ModelData(vk::Device device, const Allocator& allocator, CommandBuffer& cmdBuf, vk::Queue queue, vk::DescriptorSetLayout layout, std::filesystem::path path) {
+    ModelData(vk::Device device, const Allocator& allocator, CommandBuffer& cmdBuf, vk::Queue queue, vk::DescriptorSetLayout layout, std::filesystem::path path,
+        GeometryPool* _geometryPool = nullptr) : geometryPool(_geometryPool) {
         loadModel(device, allocator, cmdBuf, queue, layout, path);
     }
 
+    const auto& getCpuMesh() const {
+        return cpuMesh;
+    }
+
+    // shared objects of all loaded models
+    static size_t getSamplerCount() {
+        return samplerCache ? samplerCache->size() : 0;
+    }
+    static size_t getDescriptorPoolCount() {
+        return materialDescAllocator ? materialDescAllocator->getPoolCount() : 0;
+    }
+
+    // name is the asset path
+    void setDebugNames(vk::Device device, const DebugUtils& debug, const std::string& name) const {
+        for (size_t i = 0; i < vkBuffers.size(); i++)
+            debug.setName(device, vkBuffers[i], fmt::format("{} buffer {}", name, i));
+        for (size_t i = 0; i < textureImages.size(); i++)
+            debug.setName(device, textureImages[i].get(), fmt::format("{} texture {}", name, i));
+        for (size_t i = 0; i < materialDescSets.size(); i++)
+            debug.setName(device, materialDescSets[i].get(), fmt::format("{} material {}", name, i));
+    }
+
+    uint32_t getPrimitiveCount() const {
+        uint32_t count = 0;
+        for (const auto& prims : primitiveRenderings)
+            count += prims.size();
+        return count;
+    }
+
+    uint32_t getTriangleCount() const {
+        size_t indices = 0;
+        for (const auto& prims : primitiveRenderings)
+            for (const auto& prim : prims)
+                indices += prim.pooled ? prim.pooled->count : prim.count;
+        return uint32_t(indices / 3);
+    }
+
     void DrawModel(const vk::CommandBuffer& cmdBuf, vk::PipelineLayout layout, const glm::mat4 &mvp) {
         PushConstantData pcd;
 
@@ -280,6 +524,11 @@ public:
             pcd.baseColor = materialBaseColors[i];
 
             for (const auto& prim : primitiveRenderings[i]) {
+                if (prim.pooled) {
+                    cmdBuf.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(pcd), &pcd);
+                    cmdBuf.drawIndexed(prim.pooled->count, 1, prim.pooled->firstIndex, prim.pooled->vertexOffset, 0);
+                    continue;
+                }
                 cmdBuf.bindVertexBuffers(0, prim.vertBufs, prim.vertBufOffsets);
                 cmdBuf.bindIndexBuffer(prim.indexBuf, prim.indexBufOffset, prim.indexType);
                 cmdBuf.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(pcd), &pcd);
@@ -288,4 +537,58 @@ public:
             i++;
         }
     }
+
+    // Pose submission: the view-projection is already pushed, the transform is instance `instance` of the PoseBuffer.
+    // Only the base color is pushed per material.
+    void DrawModelPosed(const vk::CommandBuffer& cmdBuf, vk::PipelineLayout layout, uint32_t instance) {
+        for (int i = 0; const auto & materialDesc : materialDescSets) {
+            cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, { materialDesc.get() }, {});
+            cmdBuf.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, offsetof(PushConstantData, baseColor), sizeof(glm::vec3), &materialBaseColors[i]);
+
+            for (const auto& prim : primitiveRenderings[i]) {
+                cmdBuf.bindVertexBuffers(0, prim.vertBufs, prim.vertBufOffsets);
+                cmdBuf.bindIndexBuffer(prim.indexBuf, prim.indexBufOffset, prim.indexType);
+                cmdBuf.drawIndexed(prim.count, 1, 0, 0, instance);
+            }
+            i++;
+        }
+    }
+
+    // one VkDrawIndexedIndirectCommand per primitive, in the order used by DrawModelIndirect
+    std::vector<vk::DrawIndexedIndirectCommand> getIndirectCommands() const {
+        std::vector<vk::DrawIndexedIndirectCommand> commands;
+        for (const auto& prims : primitiveRenderings) {
+            for (const auto& prim : prims) {
+                vk::DrawIndexedIndirectCommand command;
+                command.indexCount = prim.pooled ? prim.pooled->count : prim.count;
+                command.instanceCount = 0;
+                command.firstIndex = prim.pooled ? prim.pooled->firstIndex : 0;
+                command.vertexOffset = prim.pooled ? prim.pooled->vertexOffset : 0;
+                command.firstInstance = 0;
+                commands.push_back(command);
+            }
+        }
+        return commands;
+    }
+
+    void DrawModelIndirect(const vk::CommandBuffer& cmdBuf, vk::PipelineLayout layout, const glm::mat4& vp, vk::Buffer indirectBuf) {
+        PushConstantData pcd;
+        pcd.mvp = vp;
+
+        vk::DeviceSize offset = 0;
+        for (int i = 0; const auto & materialDesc : materialDescSets) {
+            cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, { materialDesc.get() }, {});
+
+            pcd.baseColor = materialBaseColors[i];
+
+            for (const auto& prim : primitiveRenderings[i]) {
+                cmdBuf.bindVertexBuffers(0, prim.vertBufs, prim.vertBufOffsets);
+                cmdBuf.bindIndexBuffer(prim.indexBuf, prim.indexBufOffset, prim.indexType);
+                cmdBuf.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(pcd), &pcd);
+                cmdBuf.drawIndexedIndirect(indirectBuf, offset, 1, sizeof(vk::DrawIndexedIndirectCommand));
+                offset += sizeof(vk::DrawIndexedIndirectCommand);
+            }
+            i++;
+        }
+    }
 };
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Offscreen color target for flat, rarely changing content such as the HUD.
+// The content is rendered into it only when it changes. The result is either drawn
+// as one textured quad (PipelineVariant::Panel) in the main pass, or, when the target
+// wraps the images of an OpenXR swapchain, submitted as a quad layer by the app.
+class PanelTarget {
+    const vk::Device device;
+    const vk::Extent2D extent;
+    const glm::vec2 size;
+    const vk::Format format;
+    const bool swapchain;
+
+    vk::UniqueRenderPass renderpass;
+    std::optional<Image> colorImage;
+    std::optional<Image> depthImage;
+    vk::UniqueImageView depthImageView;
+    struct RenderTarget {
+        vk::UniqueImageView imgView;
+        vk::UniqueFramebuffer frameBuf;
+    };
+    std::vector<RenderTarget> renderTargets;
+    vk::UniquePipeline pipeline;
+    vk::UniquePipeline textPipeline;
+
+    vk::UniqueSampler sampler;
+    vk::UniqueDescriptorPool descPool;
+    std::vector<vk::UniqueDescriptorSet> descSets;
+
+    void CreateRenderpass() {
+        vk::AttachmentDescription attachments[2];
+        attachments[0].format = format;
+        attachments[0].samples = vk::SampleCountFlagBits::e1;
+        attachments[0].loadOp = vk::AttachmentLoadOp::eClear;
+        attachments[0].storeOp = vk::AttachmentStoreOp::eStore;
+        attachments[0].stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+        attachments[0].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        attachments[0].initialLayout = vk::ImageLayout::eUndefined;
+        // swapchain images are handed back to the runtime in the color attachment layout
+        attachments[0].finalLayout = swapchain ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::eShaderReadOnlyOptimal;
+        attachments[1].format = vk::Format::eD32Sfloat;
+        attachments[1].samples = vk::SampleCountFlagBits::e1;
+        attachments[1].loadOp = vk::AttachmentLoadOp::eClear;
+        attachments[1].storeOp = vk::AttachmentStoreOp::eDontCare;
+        attachments[1].stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+        attachments[1].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        attachments[1].initialLayout = vk::ImageLayout::eUndefined;
+        attachments[1].finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+        vk::AttachmentReference colorAttachmentRef;
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = vk::ImageLayout::eColorAttachmentOptimal;
+
+        vk::AttachmentReference depthAttachmentRef;
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+        vk::SubpassDescription subpasses[1];
+        subpasses[0].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+        subpasses[0].colorAttachmentCount = 1;
+        subpasses[0].pColorAttachments = &colorAttachmentRef;
+        subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
+
+        // 0: the previous content may still be sampled by an earlier frame
+        // 1: the new content is sampled by the main pass
+        vk::SubpassDependency dependency[2];
+        dependency[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency[0].dstSubpass = 0;
+        dependency[0].srcStageMask = vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+        dependency[0].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+        dependency[0].srcAccessMask = {};
+        dependency[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dependency[1].srcSubpass = 0;
+        dependency[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependency[1].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependency[1].dstStageMask = vk::PipelineStageFlagBits::eFragmentShader;
+        dependency[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        dependency[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+        vk::RenderPassCreateInfo createInfo;
+        createInfo.attachmentCount = std::size(attachments);
+        createInfo.pAttachments = attachments;
+        createInfo.subpassCount = std::size(subpasses);
+        createInfo.pSubpasses = subpasses;
+        createInfo.dependencyCount = std::size(dependency);
+        createInfo.pDependencies = dependency;
+
+        renderpass = device.createRenderPassUnique(createInfo);
+    }
+
+    void CreateImages(const Allocator& allocator, const std::vector<vk::Image>& swapchainImages) {
+        depthImage.emplace(device, allocator, vk::Extent3D{ extent.width, extent.height, 1 }, vk::Format::eD32Sfloat,
+            vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransientAttachment,
+            vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated);
+        depthImageView = depthImage->CreateImageView(device, vk::ImageAspectFlagBits::eDepth);
+
+        std::vector<vk::UniqueImageView> imgViews;
+        if (swapchain) {
+            for (const auto& image : swapchainImages) {
+                vk::ImageViewCreateInfo viewCreateInfo;
+                viewCreateInfo.image = image;
+                viewCreateInfo.viewType = vk::ImageViewType::e2D;
+                viewCreateInfo.format = format;
+                viewCreateInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+                viewCreateInfo.subresourceRange.baseMipLevel = 0;
+                viewCreateInfo.subresourceRange.levelCount = 1;
+                viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+                viewCreateInfo.subresourceRange.layerCount = 1;
+                imgViews.push_back(device.createImageViewUnique(viewCreateInfo));
+            }
+        }
+        else {
+            colorImage.emplace(device, allocator, vk::Extent3D{ extent.width, extent.height, 1 }, format,
+                vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled);
+            imgViews.push_back(colorImage->CreateImageView(device));
+        }
+
+        for (auto& imgView : imgViews) {
+            vk::ImageView attachments[] = { imgView.get(), depthImageView.get() };
+
+            vk::FramebufferCreateInfo createInfo;
+            createInfo.width = extent.width;
+            createInfo.height = extent.height;
+            createInfo.layers = 1;
+            createInfo.renderPass = renderpass.get();
+            createInfo.attachmentCount = std::size(attachments);
+            createInfo.pAttachments = attachments;
+            auto frameBuf = device.createFramebufferUnique(createInfo);
+
+            renderTargets.push_back({ std::move(imgView), std::move(frameBuf) });
+        }
+    }
+
+    void CreateDescriptorSet(vk::DescriptorSetLayout layout) {
+        vk::SamplerCreateInfo samplerCreateInfo;
+        samplerCreateInfo.magFilter = vk::Filter::eLinear;
+        samplerCreateInfo.minFilter = vk::Filter::eLinear;
+        samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+        sampler = device.createSamplerUnique(samplerCreateInfo);
+
+        vk::DescriptorPoolSize poolSizes[1];
+        poolSizes[0].type = vk::DescriptorType::eCombinedImageSampler;
+        poolSizes[0].descriptorCount = 1;
+
+        vk::DescriptorPoolCreateInfo poolCreateInfo;
+        poolCreateInfo.poolSizeCount = std::size(poolSizes);
+        poolCreateInfo.pPoolSizes = poolSizes;
+        poolCreateInfo.maxSets = 1;
+        poolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        descPool = device.createDescriptorPoolUnique(poolCreateInfo);
+
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.descriptorPool = descPool.get();
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        descSets = device.allocateDescriptorSetsUnique(allocInfo);
+
+        vk::DescriptorImageInfo imageInfo;
+        imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        imageInfo.imageView = renderTargets[0].imgView.get();
+        imageInfo.sampler = sampler.get();
+
+        vk::WriteDescriptorSet samplerWrite;
+        samplerWrite.dstSet = descSets[0].get();
+        samplerWrite.dstBinding = 0;
+        samplerWrite.dstArrayElement = 0;
+        samplerWrite.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        samplerWrite.descriptorCount = 1;
+        samplerWrite.pImageInfo = &imageInfo;
+        device.updateDescriptorSets({ samplerWrite }, {});
+    }
+
+public:
+    // extent: texture resolution, size: area covered by the panel in panel space (meters)
+    // Without swapchain images the target owns a sampled texture for PipelineVariant::Panel.
+    PanelTarget(vk::Device _device, const Allocator& allocator, const RenderProc& renderproc, vk::Extent2D _extent, glm::vec2 _size,
+        vk::Format _format = vk::Format::eR8G8B8A8Srgb, const std::vector<vk::Image>& swapchainImages = {})
+        : device(_device), extent(_extent), size(_size), format(_format), swapchain(!swapchainImages.empty())
+    {
+        CreateRenderpass();
+        CreateImages(allocator, swapchainImages);
+        pipeline = renderproc.CreatePipeline(extent, PipelineVariant::Opaque, renderpass.get(), vk::SampleCountFlagBits::e1);
+        if (renderproc.hasText())
+            textPipeline = renderproc.CreatePipeline(extent, PipelineVariant::Text, renderpass.get(), vk::SampleCountFlagBits::e1);
+        if (!swapchain)
+            CreateDescriptorSet(renderproc.getDescriptorSetLayout());
+    }
+
+    // must be recorded outside of a render pass
+    void begin(const vk::CommandBuffer cmdBuf, uint32_t imageIndex = 0) const {
+        vk::ClearValue clearVal[2];
+        clearVal[0].color.float32[0] = 0.0f;
+        clearVal[0].color.float32[1] = 0.0f;
+        clearVal[0].color.float32[2] = 0.0f;
+        clearVal[0].color.float32[3] = 0.0f;
+        clearVal[1].depthStencil.depth = 1.0f;
+        clearVal[1].depthStencil.stencil = 0.0f;
+
+        vk::RenderPassBeginInfo renderpassBeginInfo;
+        renderpassBeginInfo.renderPass = renderpass.get();
+        renderpassBeginInfo.framebuffer = renderTargets[imageIndex].frameBuf.get();
+        renderpassBeginInfo.clearValueCount = std::size(clearVal);
+        renderpassBeginInfo.pClearValues = clearVal;
+        renderpassBeginInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+        renderpassBeginInfo.renderArea.extent = extent;
+
+        cmdBuf.beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
+        cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+    }
+
+    // Opaque (bound by begin()) or Text
+    void bindPipeline(const vk::CommandBuffer cmdBuf, PipelineVariant variant) const {
+        cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, variant == PipelineVariant::Text ? textPipeline.get() : pipeline.get());
+    }
+
+    void end(const vk::CommandBuffer cmdBuf) const {
+        cmdBuf.endRenderPass();
+    }
+
+    // panel space (x right, y up, viewed from +z) to clip space; y is flipped like the eye projections
+    glm::mat4 getProjection() const {
+        float depth = std::max(size.x, size.y);
+        return glm::orthoRH_ZO(-size.x / 2, size.x / 2, size.y / 2, -size.y / 2, -depth, depth);
+    }
+
+    // unit quad of panel.vert to panel space
+    glm::mat4 getQuadMatrix() const {
+        return glm::scale(glm::identity<glm::mat4>(), glm::vec3(size, 1.0f));
+    }
+
+    auto getDescriptorSet() const {
+        return descSets[0].get();
+    }
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <mutex>
+
+// GPU particle system.
+// Bursts are queued on the CPU and expanded by particle_emit.comp into a ring of particles,
+// particle_update.comp integrates / kills them and appends survivors to the alive list,
+// which also produces the instance count of the indirect draw.
+
+struct ParticleData {
+    glm::vec4 posLife;      // xyz: position, w: remaining lifetime
+    glm::vec4 velSize;      // xyz: velocity, w: initial size
+    glm::vec4 params;       // x: lifetime
+};
+
+struct ParticleEmitData {
+    glm::vec4 posSpeed;     // xyz: position, w: speed
+    glm::vec4 axisXLifetime;
+    glm::vec4 axisYSize;
+    glm::uvec4 range;       // x: first new particle, y: count, z: seed
+};
+
+struct ParticlePushConstants {
+    uint32_t capacity;
+    uint32_t ringBase;
+    uint32_t emitBase;
+    uint32_t emitCount;
+    uint32_t newCount;
+    float dt;
+};
+
+class ParticleSystem {
+    static constexpr uint32_t maxEmitsPerFrame = 256;
+    static constexpr uint32_t emitSlots = 4;
+    static constexpr uint32_t localSize = 64;
+
+    const vk::Device device;
+    const uint32_t capacity;
+
+    ModelData model;
+    std::vector<vk::DrawIndexedIndirectCommand> indirectCommands;
+
+    std::optional<Buffer> particleBuf, aliveBuf, indirectBuf, emitBuf;
+
+    ShaderModule emitShader, updateShader;
+    vk::UniqueDescriptorSetLayout computeSetLayout;
+    vk::UniquePipelineLayout computePipelineLayout;
+    vk::UniquePipeline emitPipeline, updatePipeline;
+
+    vk::UniqueDescriptorPool descPool;
+    std::vector<vk::UniqueDescriptorSet> computeDescSets;
+    std::vector<vk::UniqueDescriptorSet> drawDescSets;
+
+    // emit() may come from the simulation thread while update() runs on the render thread
+    std::mutex pendingMutex;
+    std::vector<ParticleBurst> pending, emitting;
+    uint32_t ringHead = 0;
+    uint32_t frame = 0;
+    uint32_t seed = 1;
+
+    void CreateBuffers(const Allocator& allocator, CommandBuffer& cmdBuf, vk::Queue queue) {
+        particleBuf.emplace(device, allocator, sizeof(ParticleData) * capacity, vk::BufferUsageFlagBits::eStorageBuffer);
+        aliveBuf.emplace(device, allocator, sizeof(uint32_t) * capacity, vk::BufferUsageFlagBits::eStorageBuffer);
+
+        vk::DeviceSize indirectSize = sizeof(vk::DrawIndexedIndirectCommand) * indirectCommands.size();
+        indirectBuf.emplace(device, allocator, indirectSize,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferSrc);
+        indirectBuf->pasteViaStaging<true>(cmdBuf, queue, reinterpret_cast<const std::byte*>(indirectCommands.data()), indirectSize);
+
+        emitBuf.emplace(device, allocator, sizeof(ParticleEmitData) * maxEmitsPerFrame * emitSlots,
+            vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+        // every particle starts dead
+        cmdBuf.execSync(device, queue, [&](const vk::CommandBuffer& cmdBuf) {
+            cmdBuf.fillBuffer(particleBuf->get(), 0, VK_WHOLE_SIZE, 0);
+        });
+    }
+
+    void CreateComputePipelines() {
+        // 0: particles, 1: alive indices, 2: indirect commands, 3: emits
+        vk::DescriptorSetLayoutBinding bindings[4];
+        for (uint32_t i = 0; i < std::size(bindings); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorCount = 1;
+            bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+            bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+        }
+
+        vk::DescriptorSetLayoutCreateInfo setLayoutCreateInfo;
+        setLayoutCreateInfo.bindingCount = std::size(bindings);
+        setLayoutCreateInfo.pBindings = bindings;
+        computeSetLayout = device.createDescriptorSetLayoutUnique(setLayoutCreateInfo);
+
+        vk::PushConstantRange pcr;
+        pcr.offset = 0;
+        pcr.size = sizeof(ParticlePushConstants);
+        pcr.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+        vk::PipelineLayoutCreateInfo layoutCreateInfo;
+        layoutCreateInfo.setLayoutCount = 1;
+        layoutCreateInfo.pSetLayouts = &computeSetLayout.get();
+        layoutCreateInfo.pushConstantRangeCount = 1;
+        layoutCreateInfo.pPushConstantRanges = &pcr;
+        computePipelineLayout = device.createPipelineLayoutUnique(layoutCreateInfo);
+
+        vk::ComputePipelineCreateInfo createInfo;
+        createInfo.layout = computePipelineLayout.get();
+
+        createInfo.stage = emitShader.getStageCreateInfo(vk::ShaderStageFlagBits::eCompute);
+        emitPipeline = device.createComputePipelineUnique(nullptr, createInfo).value;
+
+        createInfo.stage = updateShader.getStageCreateInfo(vk::ShaderStageFlagBits::eCompute);
+        updatePipeline = device.createComputePipelineUnique(nullptr, createInfo).value;
+    }
+
+    void CreateDescriptorSets(vk::DescriptorSetLayout drawSetLayout) {
+        vk::DescriptorPoolSize poolSizes[1];
+        poolSizes[0].type = vk::DescriptorType::eStorageBuffer;
+        poolSizes[0].descriptorCount = 6;
+
+        vk::DescriptorPoolCreateInfo poolCreateInfo;
+        poolCreateInfo.poolSizeCount = std::size(poolSizes);
+        poolCreateInfo.pPoolSizes = poolSizes;
+        poolCreateInfo.maxSets = 2;
+        poolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        descPool = device.createDescriptorPoolUnique(poolCreateInfo);
+
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.descriptorPool = descPool.get();
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &computeSetLayout.get();
+        computeDescSets = device.allocateDescriptorSetsUnique(allocInfo);
+        allocInfo.pSetLayouts = &drawSetLayout;
+        drawDescSets = device.allocateDescriptorSetsUnique(allocInfo);
+
+        vk::DescriptorBufferInfo bufferInfos[4];
+        bufferInfos[0].buffer = particleBuf->get();
+        bufferInfos[1].buffer = aliveBuf->get();
+        bufferInfos[2].buffer = indirectBuf->get();
+        bufferInfos[3].buffer = emitBuf->get();
+
+        std::vector<vk::WriteDescriptorSet> writes;
+        for (uint32_t i = 0; i < std::size(bufferInfos); i++) {
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = VK_WHOLE_SIZE;
+
+            vk::WriteDescriptorSet write;
+            write.dstSet = computeDescSets[0].get();
+            write.dstBinding = i;
+            write.dstArrayElement = 0;
+            write.descriptorType = vk::DescriptorType::eStorageBuffer;
+            write.descriptorCount = 1;
+            write.pBufferInfo = &bufferInfos[i];
+            writes.push_back(write);
+
+            if (i < 2) {
+                write.dstSet = drawDescSets[0].get();
+                writes.push_back(write);
+            }
+        }
+        device.updateDescriptorSets(writes, {});
+    }
+
+public:
+    ParticleSystem(vk::Device _device, const Allocator& allocator, CommandBuffer& cmdBuf, vk::Queue queue,
+        vk::DescriptorSetLayout materialSetLayout, vk::DescriptorSetLayout drawSetLayout, const char* modelPath, uint32_t _capacity)
+        : device(_device), capacity(_capacity),
+        model(device, allocator, cmdBuf, queue, materialSetLayout, modelPath),
+        emitShader(device, "shaders/particle_emit.comp.spv"), updateShader(device, "shaders/particle_update.comp.spv")
+    {
+        indirectCommands = model.getIndirectCommands();
+        CreateBuffers(allocator, cmdBuf, queue);
+        CreateComputePipelines();
+        CreateDescriptorSets(drawSetLayout);
+    }
+
+    void emit(const ParticleBurst& burst) {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending.push_back(burst);
+    }
+
+    void update(const vk::CommandBuffer& cmdBuf, double dt) {
+        ParticlePushConstants pc{};
+        pc.capacity = capacity;
+        pc.ringBase = ringHead;
+        pc.emitBase = (frame % emitSlots) * maxEmitsPerFrame;
+        pc.dt = float(dt);
+
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            std::swap(pending, emitting);
+        }
+        std::array<ParticleEmitData, maxEmitsPerFrame> emits;
+        for (const auto& burst : emitting) {
+            if (pc.emitCount >= maxEmitsPerFrame)
+                break;
+            auto count = std::min(burst.count, capacity - pc.newCount);
+
+            auto& emitData = emits[pc.emitCount++];
+            emitData.posSpeed = glm::vec4(burst.pos, burst.speed);
+            emitData.axisXLifetime = glm::vec4(burst.axisX, burst.lifetime);
+            emitData.axisYSize = glm::vec4(burst.axisY, burst.size);
+            emitData.range = glm::uvec4(pc.newCount, count, seed++, 0);
+            pc.newCount += count;
+        }
+        emitting.clear();
+
+        if (pc.emitCount > 0)
+            emitBuf->paste(reinterpret_cast<const std::byte*>(emits.data()), sizeof(ParticleEmitData) * pc.emitCount, sizeof(ParticleEmitData) * pc.emitBase);
+        ringHead = (ringHead + pc.newCount) % capacity;
+        frame++;
+
+        // previous frames may still be drawing from the buffers
+        {
+            vk::MemoryBarrier barrier;
+            barrier.srcAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eIndirectCommandRead;
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+            cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eDrawIndirect,
+                vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, {}, { barrier }, {}, {});
+        }
+
+        // instanceCount of the first command is the alive counter
+        cmdBuf.fillBuffer(indirectBuf->get(), offsetof(VkDrawIndexedIndirectCommand, instanceCount), sizeof(uint32_t), 0);
+
+        cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, computePipelineLayout.get(), 0, { computeDescSets[0].get() }, {});
+        cmdBuf.pushConstants(computePipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pc), &pc);
+
+        if (pc.newCount > 0) {
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, emitPipeline.get());
+            cmdBuf.dispatch((pc.newCount + localSize - 1) / localSize, 1, 1);
+        }
+
+        {
+            vk::MemoryBarrier barrier;
+            barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+            cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+                vk::PipelineStageFlagBits::eComputeShader, {}, { barrier }, {}, {});
+        }
+
+        cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, updatePipeline.get());
+        cmdBuf.dispatch((capacity + localSize - 1) / localSize, 1, 1);
+
+        // models with several primitives share the alive counter of the first command
+        if (indirectCommands.size() > 1) {
+            vk::MemoryBarrier barrier;
+            barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+            cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, { barrier }, {}, {});
+
+            std::vector<vk::BufferCopy> regions;
+            for (size_t i = 1; i < indirectCommands.size(); i++) {
+                vk::BufferCopy region;
+                region.srcOffset = offsetof(VkDrawIndexedIndirectCommand, instanceCount);
+                region.dstOffset = sizeof(vk::DrawIndexedIndirectCommand) * i + offsetof(VkDrawIndexedIndirectCommand, instanceCount);
+                region.size = sizeof(uint32_t);
+                regions.push_back(region);
+            }
+            cmdBuf.copyBuffer(indirectBuf->get(), indirectBuf->get(), regions);
+        }
+
+        {
+            vk::MemoryBarrier barrier;
+            barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eIndirectCommandRead;
+            cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+                vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eDrawIndirect, {}, { barrier }, {}, {});
+        }
+    }
+
+    void draw(const vk::CommandBuffer& cmdBuf, vk::PipelineLayout layout, const glm::mat4& vp) {
+        cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 1, { drawDescSets[0].get() }, {});
+        model.DrawModelIndirect(cmdBuf, layout, vp, indirectBuf->get());
+    }
+};
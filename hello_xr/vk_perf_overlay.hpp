@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+
+// Head-locked performance overlay: CPU sim / record time, GPU time, draw and triangle counts,
+// and a graph of the recent frame times. Nothing is measured or drawn while it is hidden.
+class PerfOverlay {
+    static constexpr uint32_t historySize = 64;
+    // view space of the left eye at the first view of the frame, meters
+    static inline const glm::vec3 origin{ -0.16f, -0.02f, -0.6f };
+    static constexpr float lineHeight = 0.008f;
+    static constexpr float lineSpacing = 0.013f;
+    static inline const glm::vec2 graphSize{ 0.12f, 0.04f };
+
+    struct FrameStats {
+        double simMs = 0.0;
+        double recordMs = 0.0;
+        double gpuMs = 0.0;
+        uint32_t draws = 0;
+        uint32_t triangles = 0;
+    };
+    FrameStats current, shown;      // being measured / last complete frame
+    double reportedSimMs = 0.0;
+    double displayPeriodMs = 0.0;
+
+    std::array<float, historySize> frameMs{};
+    uint32_t historyHead = 0;
+    std::optional<std::chrono::steady_clock::time_point> lastFrame;
+
+    std::vector<GpuTimerQuery> gpuTimers;   // per view
+    glm::mat4 world;
+
+public:
+    PerfOverlay(vk::Device device, uint32_t viewCount, float timestampPeriod) {
+        for (uint32_t i = 0; i < viewCount; i++)
+            gpuTimers.emplace_back(device, 8, timestampPeriod);
+    }
+
+    // the history would otherwise contain the time it was hidden
+    void show() {
+        frameMs.fill(0.0f);
+        lastFrame.reset();
+    }
+
+    // at the first view of every frame; the overlay is placed relative to that eye for both views
+    void beginFrame(const glm::mat4& eyeWorld) {
+        auto now = std::chrono::steady_clock::now();
+        if (lastFrame) {
+            frameMs[historyHead] = float(std::chrono::duration<double, std::milli>(now - lastFrame.value()).count());
+            historyHead = (historyHead + 1) % historySize;
+        }
+        lastFrame = now;
+
+        shown = current;
+        current = {};
+        current.simMs = reportedSimMs;      // reported before the views are rendered
+        world = eyeWorld * glm::translate(glm::identity<glm::mat4>(), origin);
+    }
+
+    void reportSimTime(double ms, double periodMs) {
+        reportedSimMs = ms;
+        displayPeriodMs = periodMs;
+    }
+    void addRecordTime(double ms) {
+        current.recordMs += ms;
+    }
+    void addDraws(uint32_t draws, uint32_t triangles) {
+        current.draws += draws;
+        current.triangles += triangles;
+    }
+
+    // must be recorded outside of a render pass
+    void beginView(const vk::CommandBuffer cmdBuf, int viewIndex) {
+        gpuTimers[viewIndex].begin(cmdBuf);
+    }
+    void endView(const vk::CommandBuffer cmdBuf, int viewIndex) const {
+        gpuTimers[viewIndex].end(cmdBuf);
+    }
+    // results are a few frames old, as the timers are read without waiting
+    void collectGpuTime(vk::Device device, int viewIndex) {
+        if (auto ms = gpuTimers[viewIndex].getOldestMs(device))
+            current.gpuMs += ms.value();
+    }
+
+    // Text pipeline must be bound
+    void draw(const vk::CommandBuffer& cmdBuf, TextRenderer& text, vk::PipelineLayout layout, const glm::mat4& vp) const {
+        const glm::vec3 textColor{ 1.0f, 1.0f, 1.0f };
+        const auto mvp = vp * world;
+
+        // left aligned: TextRenderer centers each string
+        auto drawLine = [&](int row, const std::string& str) {
+            float width = (str.size() * GlyphAtlas::advance - (GlyphAtlas::advance - GlyphAtlas::glyphWidth)) / GlyphAtlas::capHeight * lineHeight;
+            auto mat = glm::translate(glm::identity<glm::mat4>(), glm::vec3(width / 2, -row * lineSpacing, 0.0f))
+                * glm::scale(glm::identity<glm::mat4>(), glm::vec3(lineHeight));
+            text.draw(cmdBuf, layout, mvp * mat, str, textColor);
+        };
+        drawLine(0, fmt::format("SIM {:6.2f} MS", shown.simMs));
+        drawLine(1, fmt::format("REC {:6.2f} MS", shown.recordMs));
+        drawLine(2, fmt::format("GPU {:6.2f} MS", shown.gpuMs));
+        drawLine(3, fmt::format("DRAWS {}", shown.draws));
+        drawLine(4, fmt::format("TRIS {}", shown.triangles));
+
+        // frame times, oldest on the left; full height is two display periods
+        const float scaleMs = displayPeriodMs > 0.0 ? float(displayPeriodMs * 2.0) : 28.0f;
+        const float barWidth = graphSize.x / historySize;
+        const float bottom = -5 * lineSpacing - graphSize.y;
+        std::array<glm::vec4, historySize> onTime, late;
+        uint32_t onTimeCount = 0, lateCount = 0;
+        for (uint32_t i = 0; i < historySize; i++) {
+            float ms = frameMs[(historyHead + i) % historySize];
+            float height = std::min(ms / scaleMs, 1.0f) * graphSize.y;
+            glm::vec4 rect(i * barWidth, bottom, (i + 0.8f) * barWidth, bottom + height);
+            if (displayPeriodMs > 0.0 && ms > displayPeriodMs * 1.2)
+                late[lateCount++] = rect;
+            else
+                onTime[onTimeCount++] = rect;
+        }
+        // the display period
+        glm::vec4 target(0.0f, bottom + graphSize.y / 2, graphSize.x, bottom + graphSize.y / 2 + 0.0005f);
+
+        text.drawRects(cmdBuf, layout, mvp, onTime.data(), onTimeCount, glm::vec3(0.2f, 0.9f, 0.3f));
+        text.drawRects(cmdBuf, layout, mvp, late.data(), lateCount, glm::vec3(1.0f, 0.25f, 0.2f));
+        text.drawRects(cmdBuf, layout, mvp, &target, 1, textColor);
+    }
+};
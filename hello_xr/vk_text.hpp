@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Stroke font the SDF glyph atlas is built from at startup.
+// Each glyph is a set of polylines ('|' separated) of "x,y" points on a 4 x 6 grid (baseline 0, cap height 6).
+struct StrokeGlyph {
+    char c;
+    const char* strokes;
+};
+
+inline constexpr StrokeGlyph strokeFont[] = {
+    { ' ', "" },
+    { '0', "0,1 0,5 1,6 3,6 4,5 4,1 3,0 1,0 0,1|1,1 3,5" },
+    { '1', "1,5 2,6 2,0|1,0 3,0" },
+    { '2', "0,5 1,6 3,6 4,5 4,4 0,0 4,0" },
+    { '3', "0,5 1,6 3,6 4,5 4,4 3,3 4,2 4,1 3,0 1,0 0,1|1,3 3,3" },
+    { '4', "3,0 3,6 0,2 4,2" },
+    { '5', "4,6 0,6 0,3 3,3 4,2 4,1 3,0 0,0" },
+    { '6', "4,5 3,6 1,6 0,5 0,1 1,0 3,0 4,1 4,2 3,3 0,3" },
+    { '7', "0,6 4,6 1,0" },
+    { '8', "1,3 0,4 0,5 1,6 3,6 4,5 4,4 3,3 1,3 0,2 0,1 1,0 3,0 4,1 4,2 3,3" },
+    { '9', "0,1 1,0 3,0 4,1 4,5 3,6 1,6 0,5 0,4 1,3 4,3" },
+    { 'A', "0,0 0,4 2,6 4,4 4,0|0,3 4,3" },
+    { 'B', "0,0 0,6 3,6 4,5 4,4 3,3 0,3|3,3 4,2 4,1 3,0 0,0" },
+    { 'C', "4,5 3,6 1,6 0,5 0,1 1,0 3,0 4,1" },
+    { 'D', "0,0 0,6 2,6 4,4 4,2 2,0 0,0" },
+    { 'E', "4,6 0,6 0,0 4,0|0,3 3,3" },
+    { 'F', "4,6 0,6 0,0|0,3 3,3" },
+    { 'G', "4,5 3,6 1,6 0,5 0,1 1,0 3,0 4,1 4,3 2,3" },
+    { 'H', "0,0 0,6|4,0 4,6|0,3 4,3" },
+    { 'I', "1,6 3,6|2,6 2,0|1,0 3,0" },
+    { 'J', "4,6 4,1 3,0 1,0 0,1" },
+    { 'K', "0,0 0,6|4,6 0,2|1,3 4,0" },
+    { 'L', "0,6 0,0 4,0" },
+    { 'M', "0,0 0,6 2,3 4,6 4,0" },
+    { 'N', "0,0 0,6 4,0 4,6" },
+    { 'O', "0,1 0,5 1,6 3,6 4,5 4,1 3,0 1,0 0,1" },
+    { 'P', "0,0 0,6 3,6 4,5 4,4 3,3 0,3" },
+    { 'Q', "0,1 0,5 1,6 3,6 4,5 4,1 3,0 1,0 0,1|2,2 4,0" },
+    { 'R', "0,0 0,6 3,6 4,5 4,4 3,3 0,3|2,3 4,0" },
+    { 'S', "4,5 3,6 1,6 0,5 0,4 1,3 3,3 4,2 4,1 3,0 1,0 0,1" },
+    { 'T', "0,6 4,6|2,6 2,0" },
+    { 'U', "0,6 0,1 1,0 3,0 4,1 4,6" },
+    { 'V', "0,6 2,0 4,6" },
+    { 'W', "0,6 1,0 2,3 3,0 4,6" },
+    { 'X', "0,6 4,0|0,0 4,6" },
+    { 'Y', "0,6 2,3 4,6|2,3 2,0" },
+    { 'Z', "0,6 4,6 0,0 4,0" },
+    { '+', "2,1 2,5|0,3 4,3" },
+    { '-', "0,3 4,3" },
+    { ':', "2,1 2,1|2,4 2,4" },
+    { '.', "2,0 2,0" },
+    { '!', "2,6 2,2|2,0 2,0" },
+    { '/', "0,0 4,6" },
+};
+
+// Single channel signed distance field atlas of strokeFont.
+// 0.5 is the stroke outline; values grow towards the stroke center.
+struct GlyphAtlas {
+    static constexpr float texelsPerUnit = 8.0f;
+    static constexpr float padding = 1.5f;          // grid units around the 4 x 6 glyph box
+    static constexpr float strokeHalfWidth = 0.5f;
+    static constexpr float spread = 1.5f;           // distance mapped to [0.5, 1] / [0, 0.5]
+    static constexpr float glyphWidth = 4.0f;
+    static constexpr float capHeight = 6.0f;
+    static constexpr float advance = 6.0f;
+    static constexpr uint32_t cellWidth = uint32_t((glyphWidth + 2 * padding) * texelsPerUnit);
+    static constexpr uint32_t cellHeight = uint32_t((capHeight + 2 * padding) * texelsPerUnit);
+    static constexpr uint32_t columns = 8;
+
+    uint32_t width, height;
+    std::vector<std::byte> texels;
+    std::array<int, 128> cells;     // index into strokeFont, -1 if there is no glyph
+
+    GlyphAtlas() {
+        constexpr uint32_t glyphCount = std::size(strokeFont);
+        width = columns * cellWidth;
+        height = (glyphCount + columns - 1) / columns * cellHeight;
+        texels.resize(size_t(width) * height);
+        cells.fill(-1);
+
+        for (uint32_t i = 0; i < glyphCount; i++) {
+            cells[uint8_t(strokeFont[i].c)] = i;
+            rasterize(parse(strokeFont[i].strokes), (i % columns) * cellWidth, (i / columns) * cellHeight);
+        }
+    }
+
+private:
+    struct Segment {
+        float x0, y0, x1, y1;
+    };
+
+    static std::vector<Segment> parse(std::string_view strokes) {
+        std::vector<Segment> segments;
+        while (!strokes.empty()) {
+            auto end = strokes.find('|');
+            auto polyline = strokes.substr(0, end);
+            strokes = end == std::string_view::npos ? std::string_view{} : strokes.substr(end + 1);
+
+            float px = 0, py = 0;
+            bool first = true;
+            while (!polyline.empty()) {
+                auto space = polyline.find(' ');
+                auto point = polyline.substr(0, space);
+                polyline = space == std::string_view::npos ? std::string_view{} : polyline.substr(space + 1);
+
+                auto comma = point.find(',');
+                float x = std::stof(std::string(point.substr(0, comma)));
+                float y = std::stof(std::string(point.substr(comma + 1)));
+                // a single point is a dot
+                if (!first || polyline.empty())
+                    segments.push_back({ first ? x : px, first ? y : py, x, y });
+                px = x;
+                py = y;
+                first = false;
+            }
+        }
+        return segments;
+    }
+
+    static float distance(const Segment& s, float x, float y) {
+        float dx = s.x1 - s.x0, dy = s.y1 - s.y0;
+        float len2 = dx * dx + dy * dy;
+        float t = len2 > 0 ? std::clamp(((x - s.x0) * dx + (y - s.y0) * dy) / len2, 0.0f, 1.0f) : 0.0f;
+        float ex = s.x0 + t * dx - x, ey = s.y0 + t * dy - y;
+        return std::sqrt(ex * ex + ey * ey);
+    }
+
+    void rasterize(const std::vector<Segment>& segments, uint32_t cellX, uint32_t cellY) {
+        for (uint32_t py = 0; py < cellHeight; py++) {
+            for (uint32_t px = 0; px < cellWidth; px++) {
+                // row 0 is the top of the cell
+                float x = -padding + (px + 0.5f) / texelsPerUnit;
+                float y = capHeight + padding - (py + 0.5f) / texelsPerUnit;
+
+                float d = spread + strokeHalfWidth;
+                for (const auto& s : segments)
+                    d = std::min(d, distance(s, x, y));
+
+                float value = std::clamp(0.5f + (strokeHalfWidth - d) / (2 * spread), 0.0f, 1.0f);
+                texels[size_t(cellY + py) * width + cellX + px] = std::byte(uint8_t(value * 255.0f + 0.5f));
+            }
+        }
+    }
+};
+
+struct GlyphInstance {
+    glm::vec4 rect;     // xy: bottom left, zw: top right
+    glm::vec4 uvRect;   // xy: top left, zw: bottom right
+};
+
+// Draws single lines of text from the glyph atlas, one instanced draw per string.
+// Glyph instances are collected while recording and uploaded once per command buffer (end()).
+class TextRenderer {
+    static constexpr uint32_t maxGlyphs = 2048;     // per command buffer
+    static constexpr uint32_t segments = 8;         // more than the command buffers in flight
+    static constexpr vk::DeviceSize segmentSize = sizeof(GlyphInstance) * maxGlyphs;
+
+    const vk::Device device;
+    std::array<int, 128> cells;
+    glm::vec2 cellUv;
+    glm::vec2 solidUv;      // well inside a stroke, for filled rectangles
+
+    std::optional<TextureImage> atlasImage;
+    vk::UniqueSampler sampler;
+    vk::UniqueDescriptorPool descPool;
+    std::vector<vk::UniqueDescriptorSet> descSets;
+
+    std::optional<Buffer> instanceBuf;
+    std::vector<GlyphInstance> instances;
+    uint32_t instanceCount = 0;
+    uint32_t segment = 0;
+
+    void CreateDescriptorSet(vk::DescriptorSetLayout layout) {
+        vk::SamplerCreateInfo samplerCreateInfo;
+        samplerCreateInfo.magFilter = vk::Filter::eLinear;
+        samplerCreateInfo.minFilter = vk::Filter::eLinear;
+        samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+        sampler = device.createSamplerUnique(samplerCreateInfo);
+
+        vk::DescriptorPoolSize poolSizes[1];
+        poolSizes[0].type = vk::DescriptorType::eCombinedImageSampler;
+        poolSizes[0].descriptorCount = 1;
+
+        vk::DescriptorPoolCreateInfo poolCreateInfo;
+        poolCreateInfo.poolSizeCount = std::size(poolSizes);
+        poolCreateInfo.pPoolSizes = poolSizes;
+        poolCreateInfo.maxSets = 1;
+        poolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        descPool = device.createDescriptorPoolUnique(poolCreateInfo);
+
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.descriptorPool = descPool.get();
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        descSets = device.allocateDescriptorSetsUnique(allocInfo);
+
+        vk::DescriptorImageInfo imageInfo;
+        imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        imageInfo.imageView = atlasImage->getImageView();
+        imageInfo.sampler = sampler.get();
+
+        vk::WriteDescriptorSet samplerWrite;
+        samplerWrite.dstSet = descSets[0].get();
+        samplerWrite.dstBinding = 0;
+        samplerWrite.dstArrayElement = 0;
+        samplerWrite.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        samplerWrite.descriptorCount = 1;
+        samplerWrite.pImageInfo = &imageInfo;
+        device.updateDescriptorSets({ samplerWrite }, {});
+    }
+
+public:
+    TextRenderer(vk::Device _device, const Allocator& allocator, CommandBuffer& cmdBuf, vk::Queue queue, vk::DescriptorSetLayout layout)
+        : device(_device), instances(maxGlyphs)
+    {
+        GlyphAtlas atlas;
+        cells = atlas.cells;
+        cellUv = glm::vec2(float(atlas.cellWidth) / atlas.width, float(atlas.cellHeight) / atlas.height);
+        // center of the dot of '.' at (2, 0)
+        int dot = cells['.'];
+        solidUv = glm::vec2(dot % GlyphAtlas::columns, dot / GlyphAtlas::columns) * cellUv
+            + glm::vec2(2.0f + GlyphAtlas::padding, GlyphAtlas::capHeight + GlyphAtlas::padding) * GlyphAtlas::texelsPerUnit / glm::vec2(atlas.width, atlas.height);
+        atlasImage.emplace(device, allocator, cmdBuf, queue, vk::Extent3D{ atlas.width, atlas.height, 1 }, atlas.texels,
+            vk::SharingMode::eExclusive, vk::Format::eR8Unorm);
+        std::cout << fmt::format("Glyph atlas: {}x{}", atlas.width, atlas.height) << std::endl;
+
+        CreateDescriptorSet(layout);
+        instanceBuf.emplace(device, allocator, segmentSize * segments, vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eHostVisible);
+    }
+
+    // call at the start of every command buffer that draws text
+    void begin() {
+        segment = (segment + 1) % segments;
+        instanceCount = 0;
+    }
+
+    // text is centered on the origin, with a cap height of 1; lower case is drawn as upper case
+    void draw(const vk::CommandBuffer& cmdBuf, vk::PipelineLayout layout, const glm::mat4& mvp, std::string_view text, const glm::vec3& color) {
+        const uint32_t first = instanceCount;
+        float pen = 0.0f;
+        for (char c : text) {
+            int cell = cells[uint8_t(std::toupper(uint8_t(c))) & 0x7f];
+            if (cell >= 0 && instanceCount < maxGlyphs) {
+                auto uv = glm::vec2(cell % GlyphAtlas::columns, cell / GlyphAtlas::columns) * cellUv;
+                auto& instance = instances[instanceCount++];
+                instance.rect = glm::vec4(pen - GlyphAtlas::padding, -GlyphAtlas::padding,
+                    pen + GlyphAtlas::glyphWidth + GlyphAtlas::padding, GlyphAtlas::capHeight + GlyphAtlas::padding);
+                instance.uvRect = glm::vec4(uv, uv + cellUv);
+            }
+            pen += GlyphAtlas::advance;
+        }
+        if (instanceCount == first)
+            return;
+
+        const float textWidth = pen - (GlyphAtlas::advance - GlyphAtlas::glyphWidth);
+        auto toCenter = glm::scale(glm::identity<glm::mat4>(), glm::vec3(1.0f / GlyphAtlas::capHeight))
+            * glm::translate(glm::identity<glm::mat4>(), glm::vec3(-textWidth / 2, -GlyphAtlas::capHeight / 2, 0.0f));
+
+        PushConstantData pcd;
+        pcd.mvp = mvp * toCenter;
+        pcd.baseColor = color;
+
+        cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, { descSets[0].get() }, {});
+        cmdBuf.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(pcd), &pcd);
+        cmdBuf.bindVertexBuffers(0, { instanceBuf->get() }, { segmentSize * segment });
+        cmdBuf.draw(6, instanceCount - first, 0, first);
+    }
+
+    // filled rectangles (xy: bottom left, zw: top right) with the same pipeline, e.g. for small graphs
+    void drawRects(const vk::CommandBuffer& cmdBuf, vk::PipelineLayout layout, const glm::mat4& mvp, const glm::vec4* rects, uint32_t count, const glm::vec3& color) {
+        const uint32_t first = instanceCount;
+        for (uint32_t i = 0; i < count && instanceCount < maxGlyphs; i++)
+            instances[instanceCount++] = GlyphInstance{ rects[i], glm::vec4(solidUv, solidUv) };
+        if (instanceCount == first)
+            return;
+
+        PushConstantData pcd;
+        pcd.mvp = mvp;
+        pcd.baseColor = color;
+
+        cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, { descSets[0].get() }, {});
+        cmdBuf.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(pcd), &pcd);
+        cmdBuf.bindVertexBuffers(0, { instanceBuf->get() }, { segmentSize * segment });
+        cmdBuf.draw(6, instanceCount - first, 0, first);
+    }
+
+    // uploads the glyphs of this command buffer; call before it is submitted
+    void end() const {
+        if (instanceCount == 0)
+            return;
+        // whole 256 byte blocks, so that the flushed range stays aligned to nonCoherentAtomSize
+        vk::DeviceSize size = std::min(segmentSize, (sizeof(GlyphInstance) * instanceCount + 255) / 256 * 256);
+        instanceBuf->paste(reinterpret_cast<const std::byte*>(instances.data()), size, segmentSize * segment);
+    }
+};
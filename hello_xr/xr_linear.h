@@ -147,6 +147,12 @@ inline auto toG(const xr::Vector3f& v) {
 inline auto toG(const xr::Vector4f& v) {
     return glm::vec4(v.x, v.y, v.z, v.w);
 }
+inline auto toXr(const glm::quat& q) {
+    return xr::Quaternionf(q.x, q.y, q.z, q.w);
+}
+inline auto toXr(const glm::vec3& v) {
+    return xr::Vector3f(v.x, v.y, v.z);
+}
 inline auto toG(const XrMatrix4x4f& mat) {
     glm::mat4x4 gmat;
     for (int i = 0; i < 4; i++)
@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+#pragma fragment
+
+layout(binding = 0) uniform sampler2D texSampler;
+
+layout(location = 0) in vec2 texCoord;
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	vec4 sampledColor = texture(texSampler, texCoord);
+	// the panel is cleared to transparent; only the rendered content is kept
+	if (sampledColor.a < 0.5)
+		discard;
+	outFragColor = vec4(sampledColor.rgb, 1.0);
+}
@@ -0,0 +1,32 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+#pragma vertex
+
+// Unit quad of an offscreen panel, generated from gl_VertexIndex (6 vertices, no vertex buffers).
+// The panel size is part of mvp.
+
+layout (std140, push_constant) uniform buf
+{
+    mat4 mvp;
+	vec3 baseColor;
+} ubuf;
+
+layout (location = 0) out vec2 outTexCoord;
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+const vec2 corners[6] = vec2[](
+    vec2(0, 0), vec2(0, 1), vec2(1, 1),
+    vec2(0, 0), vec2(1, 1), vec2(1, 0)
+);
+
+void main()
+{
+    vec2 uv = corners[gl_VertexIndex];
+    gl_Position = ubuf.mvp * vec4(uv.x - 0.5, 0.5 - uv.y, 0, 1);
+    outTexCoord = uv;
+}
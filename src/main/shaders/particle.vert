@@ -0,0 +1,45 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+#pragma vertex
+
+// Instanced particle mesh. Each instance is one alive particle, see vk_particles.hpp.
+
+layout (std140, push_constant) uniform buf
+{
+    mat4 vp;
+	vec3 baseColor;
+} ubuf;
+
+struct Particle {
+    vec4 posLife;
+    vec4 velSize;
+    vec4 params;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer Particles { Particle particles[]; };
+layout (std430, set = 1, binding = 1) readonly buffer Alive { uint alive[]; };
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoord;
+
+layout (location = 0) out vec2 outTexCoord;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outColor;
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+void main()
+{
+    Particle p = particles[alive[gl_InstanceIndex]];
+    float size = p.velSize.w * p.posLife.w / p.params.x;
+
+    gl_Position = ubuf.vp * vec4(p.posLife.xyz + position * size, 1);
+    outTexCoord = texCoord;
+    outNormal = normal;
+    outColor = ubuf.baseColor;
+}
@@ -0,0 +1,46 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+#pragma vertex
+
+// Same as shader.vert, but the model transform comes from a per-instance pose
+// (position, rotation quaternion, scale; 40 bytes). mvp is then the view-projection
+// of the whole view. Draws that are not a plain pose push their full mvp and use
+// the identity pose.
+
+layout (std140, push_constant) uniform buf
+{
+    mat4 mvp;
+	vec3 baseColor;
+} ubuf;
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoord;
+layout (location = 3) in vec3 instancePos;
+layout (location = 4) in vec4 instanceRot;     // xyz: vector part, w: scalar part
+layout (location = 5) in vec3 instanceScale;
+
+layout (location = 0) out vec2 outTexCoord;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outColor;
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+void main()
+{
+    vec3 world = rotate(instanceRot, position * instanceScale) + instancePos;
+    gl_Position = ubuf.mvp * vec4(world, 1);
+    outTexCoord = texCoord;
+    outNormal = normal;
+    outColor = ubuf.baseColor;
+}
@@ -0,0 +1,38 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+#pragma vertex
+
+// Same as shader.vert, but the vertex attributes are fetched from the shared
+// geometry buffers. gl_VertexIndex already contains the per-draw vertexOffset.
+
+layout (std140, push_constant) uniform buf
+{
+    mat4 mvp;
+	vec3 baseColor;
+} ubuf;
+
+layout (std430, set = 1, binding = 0) readonly buffer Positions { float positions[]; };
+layout (std430, set = 1, binding = 1) readonly buffer Normals { float normals[]; };
+layout (std430, set = 1, binding = 2) readonly buffer TexCoords { vec2 texCoords[]; };
+
+layout (location = 0) out vec2 outTexCoord;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outColor;
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+void main()
+{
+    uint i = gl_VertexIndex;
+    vec3 position = vec3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+    vec3 normal = vec3(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+
+    gl_Position = ubuf.mvp * vec4(position, 1);
+    outTexCoord = texCoords[i];
+    outNormal = normal;
+    outColor = ubuf.baseColor;
+}
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+#pragma fragment
+
+// Signed distance field glyphs: 0.5 is the outline, larger values are inside.
+
+layout(binding = 0) uniform sampler2D sdfAtlas;
+
+layout(location = 0) in vec2 texCoord;
+layout(location = 1) in vec3 color;
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	float dist = texture(sdfAtlas, texCoord).r;
+	float width = max(fwidth(dist), 1e-4);
+	float alpha = smoothstep(0.5 - width, 0.5 + width, dist);
+	if (alpha <= 0.0)
+		discard;
+	outFragColor = vec4(color, alpha);
+}
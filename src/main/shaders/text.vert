@@ -0,0 +1,36 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+#pragma vertex
+
+// One instance per glyph. The quad corners are generated from gl_VertexIndex (6 vertices).
+
+layout (std140, push_constant) uniform buf
+{
+    mat4 mvp;
+	vec3 baseColor;
+} ubuf;
+
+layout (location = 0) in vec4 rect;     // xy: bottom left, zw: top right
+layout (location = 1) in vec4 uvRect;   // xy: top left, zw: bottom right
+
+layout (location = 0) out vec2 outTexCoord;
+layout (location = 1) out vec3 outColor;
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+const vec2 corners[6] = vec2[](
+    vec2(0, 0), vec2(1, 0), vec2(1, 1),
+    vec2(0, 0), vec2(1, 1), vec2(0, 1)
+);
+
+void main()
+{
+    vec2 c = corners[gl_VertexIndex];
+    gl_Position = ubuf.mvp * vec4(mix(rect.xy, rect.zw, c), 0, 1);
+    outTexCoord = vec2(mix(uvRect.x, uvRect.z, c.x), mix(uvRect.w, uvRect.y, c.y));
+    outColor = ubuf.baseColor;
+}